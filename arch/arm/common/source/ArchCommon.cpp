@@ -7,6 +7,7 @@
 #include "FrameBufferConsole.h"
 #include "backtrace.h"
 #include "Stabs2DebugInfo.h"
+#include "Scheduler.h"
 
 #define PHYSICAL_MEMORY_AVAILABLE 8*1024*1024
 
@@ -115,6 +116,17 @@ void ArchCommon::idle()
   halt();
 }
 
+uint64 ArchCommon::getTimestamp()
+{
+  // not all supported boards have a cycle counter, the scheduler ticks are available everywhere
+  return Scheduler::instance()->getTicks();
+}
+
+size_t ArchCommon::getNumCpus()
+{
+  return 1;
+}
+
 
 extern "C" void __aeabi_atexit()
 {
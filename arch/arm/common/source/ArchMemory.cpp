@@ -133,7 +133,7 @@ void ArchMemory::insertPT(uint32 pde_vpn)
   page_directory[pde_vpn].pt.size = PDE_SIZE_PT;
 }
 
-bool ArchMemory::mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_access)
+bool ArchMemory::mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_access, uint32 writeable)
 {
   PageDirEntry *page_directory = (PageDirEntry *) getIdentAddressOfPPN(page_dir_page_);
   uint32 pde_vpn = virtual_page / PAGE_TABLE_ENTRIES;
@@ -149,10 +149,16 @@ bool ArchMemory::mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_
   {
     pte_base[pte_vpn].bufferable = 0;
     pte_base[pte_vpn].cachable = 0;
-    pte_base[pte_vpn].permissions = user_access ? PAGE_PERMISSION_WRITE : PAGE_PERMISSION_KERNEL;
+    // the kernel can always write, there is no read-only permission for it
+    if (!user_access)
+      pte_base[pte_vpn].permissions = PAGE_PERMISSION_KERNEL;
+    else
+      pte_base[pte_vpn].permissions = writeable ? PAGE_PERMISSION_WRITE : PAGE_PERMISSION_READ;
     pte_base[pte_vpn].reserved = 0;
     pte_base[pte_vpn].page_ppn = physical_page + PHYS_OFFSET_4K;
     pte_base[pte_vpn].size = PTE_SIZE_SMALL;
+    PageManager::instance()->addMapping(physical_page, page_directory[pde_vpn].pt.pt_ppn - PHYS_OFFSET_4K,
+                                        (pointer) &pte_base[pte_vpn], user_access);
     return true;
   }
 
@@ -275,3 +281,34 @@ uint32 ArchMemory::getRootOfPagingStructure()
 {
   return page_dir_page_;
 }
+
+bool ArchMemory::forkInto(ArchMemory&)
+{
+  debug(A_MEMORY, "forkInto: copy-on-write is not implemented on this architecture\n");
+  return false;
+}
+
+bool ArchMemory::copyOnWrite(uint32)
+{
+  return false;
+}
+
+bool ArchMemory::ageEntry(pointer, uint32, bool&)
+{
+  return false;
+}
+
+void ArchMemory::evictEntry(pointer, size_t)
+{
+  assert(false && "ArchMemory::evictEntry: there are no swap entries on this architecture");
+}
+
+size_t ArchMemory::getSwapSlot(uint32)
+{
+  return 0;
+}
+
+bool ArchMemory::mapSwappedPage(uint32, uint32, size_t)
+{
+  return false;
+}
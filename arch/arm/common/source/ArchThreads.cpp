@@ -1,4 +1,5 @@
 #include "ArchThreads.h"
+#include "ArchInterrupts.h"
 #include "ArchMemory.h"
 #include "kprintf.h"
 #include "paging-definitions.h"
@@ -71,11 +72,24 @@ void ArchThreads::createUserRegisters(ArchThreadRegisters *&info, void* start_fu
   assert(((pageDirectory) & 0x3FFF) == 0);
 }
 
+void ArchThreads::forkUserRegisters(ArchThreadRegisters *&info, ArchThreadRegisters *parent, void* kernel_stack)
+{
+  info = (ArchThreadRegisters*)new uint8[sizeof(ArchThreadRegisters)];
+  memcpy((void*)info, (void*)parent, sizeof(ArchThreadRegisters));
+  info->r[0] = 0;
+  info->sp0 = (pointer)kernel_stack & ~0xF;
+}
+
 void ArchThreads::yield()
 {
   asm("swi #0xffff");
 }
 
+void ArchThreads::pause()
+{
+  __asm__ __volatile__("nop");
+}
+
 extern "C" void memory_barrier();
 extern "C" uint32 arch_TestAndSet(uint32, uint32, uint32 new_value, uint32 *lock);
 uint32 ArchThreads::testSetLock(uint32 &lock, uint32 new_value)
@@ -87,6 +101,20 @@ uint32 ArchThreads::testSetLock(uint32 &lock, uint32 new_value)
   return result;
 }
 
+bool ArchThreads::compareAndSwap(size_t &value, size_t expected, size_t desired)
+{
+  // there is no compare and swap instruction before ARMv6, a single cpu only has to keep interrupts out
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  memory_barrier();
+  bool swapped = (value == expected);
+  if (swapped)
+    value = desired;
+  memory_barrier();
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return swapped;
+}
+
 extern "C" uint32 arch_atomic_add(uint32, uint32, uint32 increment, uint32 *value);
 uint32 ArchThreads::atomic_add(uint32 &value, int32 increment)
 {
@@ -117,6 +117,7 @@ void KeyboardManager::serviceIRQ(void)
   if (main_console)
   {
     keyboard_buffer_.put(scancode); // put it inside the buffer
+    key_waiters_.wakeAll();
   }
 
 }
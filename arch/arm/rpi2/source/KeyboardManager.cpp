@@ -89,6 +89,7 @@ void KeyboardManager::serviceIRQ( void )
     if(main_console)
     {
       keyboard_buffer_.put( key ); // put it inside the buffer
+      key_waiters_.wakeAll();
     }
   }
 
@@ -77,6 +77,15 @@ public:
  */
   static void createUserRegisters(ArchThreadRegisters *&info, void* start_function, void* user_stack, void* kernel_stack);
 
+/**
+ * creates the ArchThreadRegisters of a forked user thread: a copy of the registers the parent
+ * saved on entering the fork syscall, with the return value of the syscall set to 0
+ * @param info where the ArchThreadRegisters is saved
+ * @param parent the user registers of the parent
+ * @param kernel_stack pointer to the kernel stack
+ */
+  static void forkUserRegisters(ArchThreadRegisters *&info, ArchThreadRegisters *parent, void* kernel_stack);
+
 /**
  *
  * on x86: invokes int65, whose handler facilitates a task switch
@@ -84,6 +93,11 @@ public:
  */
   static void yield();
 
+/**
+ * hint to the cpu that the current thread is busy waiting, e.g. spinning on a lock
+ */
+  static void pause();
+
 /**
  * sets a threads CR3 register to the given page dir / etc. defining its address space
  *
@@ -102,6 +116,17 @@ public:
  */
   static size_t testSetLock(size_t &lock, size_t new_value);
 
+/**
+ * uninterruptable locked operation
+ * sets value to desired if it still equals expected, a full memory barrier
+ *
+ * @param &value Reference to the variable
+ * @param expected the value the variable has to have
+ * @param desired the new value of the variable
+ * @returns true if the variable has been set
+ */
+  static bool compareAndSwap(size_t &value, size_t expected, size_t desired);
+
 /**
  * atomically increments or decrements value by increment
  *
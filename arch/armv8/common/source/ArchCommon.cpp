@@ -135,3 +135,15 @@ void ArchCommon::idle()
   halt();
 }
 
+uint64 ArchCommon::getTimestamp()
+{
+  uint64 counter;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(counter));
+  return counter;
+}
+
+size_t ArchCommon::getNumCpus()
+{
+  return 1;
+}
+
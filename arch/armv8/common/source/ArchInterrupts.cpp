@@ -57,6 +57,17 @@ void ArchInterrupts::setTimerFrequency(uint32 freq)
   ArchBoardSpecific::setTimerFrequency(freq);
 }
 
+uint64 ArchInterrupts::setTimerOneShot(uint64 ns __attribute__((unused)))
+{
+  // the board timers are only driven periodically
+  return 0;
+}
+
+uint64 ArchInterrupts::getTimerElapsed()
+{
+  return 0;
+}
+
 void ArchInterrupts::disableTimer()
 {
   ArchBoardSpecific::disableTimer();
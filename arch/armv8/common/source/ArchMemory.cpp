@@ -48,9 +48,9 @@ bool ArchMemory::unmapPage(size_t virtual_page)
     return true;
 }
 
-bool ArchMemory::mapPage(size_t virtual_page, size_t physical_page, size_t user_access)
+bool ArchMemory::mapPage(size_t virtual_page, size_t physical_page, size_t user_access, size_t writeable)
 {
-    debug(A_MEMORY, "%zx %zx %zx %zx\n", paging_root_page_, virtual_page, physical_page, user_access);
+    debug(A_MEMORY, "%zx %zx %zx %zx %zx\n", paging_root_page_, virtual_page, physical_page, user_access, writeable);
     ArchMemoryMapping m = resolveMapping(paging_root_page_, virtual_page);
     assert((m.page_size == 0) || (m.page_size == PAGE_SIZE));
 
@@ -74,11 +74,14 @@ bool ArchMemory::mapPage(size_t virtual_page, size_t physical_page, size_t user_
     {
         m.level3_entry[m.level3_index].not_global = 1;
         m.level3_entry[m.level3_index].shareability_field = SHARE_ISH;
-        m.level3_entry[m.level3_index].access_permissions = user_access;
+        // AP[1] grants access to EL0, AP[2] makes the page read-only
+        m.level3_entry[m.level3_index].access_permissions = (user_access ? 1 : 0) | (writeable ? 0 : 2);
         m.level3_entry[m.level3_index].memory_attributes_index = MEMORY_ATTR_STD;
         m.level3_entry[m.level3_index].page_address = physical_page;
         m.level3_entry[m.level3_index].access_flag = ACCESS_FLAG;
         m.level3_entry[m.level3_index].entry_descriptor_type = ENTRY_DESCRIPTOR_PAGE;
+        PageManager::instance()->addMapping(physical_page, m.level3_ppn, (pointer) &m.level3_entry[m.level3_index],
+                                            user_access);
         return true;
     }
 
@@ -279,3 +282,34 @@ size_t ArchMemory::getRootOfPagingStructure()
 {
   return paging_root_page_;
 }
+
+bool ArchMemory::forkInto(ArchMemory&)
+{
+  debug(A_MEMORY, "forkInto: copy-on-write is not implemented on this architecture\n");
+  return false;
+}
+
+bool ArchMemory::copyOnWrite(size_t)
+{
+  return false;
+}
+
+bool ArchMemory::ageEntry(pointer, size_t, bool&)
+{
+  return false;
+}
+
+void ArchMemory::evictEntry(pointer, size_t)
+{
+  assert(false && "ArchMemory::evictEntry: there are no swap entries on this architecture");
+}
+
+size_t ArchMemory::getSwapSlot(size_t)
+{
+  return 0;
+}
+
+bool ArchMemory::mapSwappedPage(size_t, size_t, size_t)
+{
+  return false;
+}
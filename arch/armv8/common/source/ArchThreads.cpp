@@ -63,11 +63,24 @@ void ArchThreads::createUserRegisters(ArchThreadRegisters *&info, void* start_fu
   info->TTBR0 = 0;
 }
 
+void ArchThreads::forkUserRegisters(ArchThreadRegisters *&info, ArchThreadRegisters *parent, void* kernel_stack)
+{
+  info = (ArchThreadRegisters*)new uint8[sizeof(ArchThreadRegisters)];
+  memcpy((void*)info, (void*)parent, sizeof(ArchThreadRegisters));
+  info->X[0] = 0;
+  info->SP_SM = (pointer) kernel_stack & ~0xF;
+}
+
 void ArchThreads::yield()
 {
   asm("SVC #0xffff");
 }
 
+void ArchThreads::pause()
+{
+  __asm__ __volatile__("yield");
+}
+
 size_t ArchThreads::testSetLock(size_t &lock, size_t new_value)
 {
 
@@ -94,6 +107,22 @@ size_t ArchThreads::testSetLock(size_t &lock, size_t new_value)
     return ret;
 }
 
+bool ArchThreads::compareAndSwap(size_t &value, size_t expected, size_t desired)
+{
+#ifdef VIRTUALIZED_QEMU
+  return __atomic_compare_exchange_n(&value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
+  // the exclusive instructions do not work without cache on the raspi3, see testSetLock
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  bool swapped = (value == expected);
+  if (swapped)
+    value = desired;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return swapped;
+#endif
+}
+
 
 uint32 ArchThreads::atomic_add(uint32 &value, int32 increment)
 {
@@ -77,6 +77,7 @@ void KeyboardManager::serviceIRQ( void )
                 data = '\b';
 
             keyboard_buffer_.put(data);
+            key_waiters_.wakeAll();
         }
     }
 }
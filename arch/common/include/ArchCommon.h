@@ -82,10 +82,22 @@ class ArchCommon
     static void initDebug();
 
     /**
-     * let the CPU idle, f.e. with the halt statement
+     * let the CPU idle until the next interrupt, f.e. with the halt statement
+     * has to be called with interrupts disabled, an interrupt which is already pending ends it right away
      */
     static void idle();
 
+    /**
+     * a fast, monotonically increasing timestamp for measuring short durations,
+     * in architecture specific units (cpu cycles on x86, scheduler ticks on arm)
+     */
+    static uint64 getTimestamp();
+
+    /**
+     * @return the number of cpus running the kernel, only the boot cpu is started on every architecture
+     */
+    static size_t getNumCpus();
+
     /**
      * draw a heartbeat character
      */
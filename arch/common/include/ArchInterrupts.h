@@ -12,6 +12,20 @@ public:
 
   static void enableTimer();
   static void setTimerFrequency(uint32 freq);
+
+  /**
+   * Switches the timer to a single interrupt after the given time, until it is programmed again.
+   * @param ns the time until the interrupt in nanoseconds
+   * @return the time actually programmed, which may be shorter as it is limited by the hardware,
+   *         0 if the timer only supports periodic interrupts (it keeps running periodically then)
+   */
+  static uint64 setTimerOneShot(uint64 ns);
+
+  /**
+   * @return the nanoseconds since the timer has been programmed by setTimerOneShot, even if it has run out already
+   */
+  static uint64 getTimerElapsed();
+
   static void disableTimer();
 
   static void enableKBD();
@@ -2,6 +2,7 @@
 
 #include "types.h"
 class BDRequest;
+class IOScheduler;
 
 class BDDriver
 {
@@ -23,6 +24,21 @@ class BDDriver
 
     virtual void serviceIRQ() = 0;
 
+    /**
+     * the bottom half of serviceIRQ, called with interrupts enabled, see SoftIrq
+     */
+    virtual void serviceDeferredIRQ()
+    {
+    }
+
+    /**
+     * @return the scheduler of the pending requests, 0 if the driver completes requests right away
+     */
+    virtual IOScheduler *getIOScheduler()
+    {
+      return 0;
+    }
+
     uint16 irq;
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "WaitQueue.h"
 
 class Thread;
 
@@ -13,6 +14,7 @@ class BDRequest
     friend class ATADriver;
     friend class MMCDriver;
     friend class BDManager;
+    friend class IOScheduler;
 
     typedef enum BD_CMD_ 
     {
@@ -64,6 +66,12 @@ class BDRequest
       requesting_thread_ = currentThread;
       blocks_done_ = 0;
       next_request_ = 0;
+      sched_next_ = 0;
+      sched_prev_ = 0;
+      merge_next_ = 0;
+      merge_tail_ = this;
+      merged_blocks_ = num_block;
+      queued_at_ = 0;
     };
 
     uint32 getDevID(){ return dev_id_; };
@@ -75,14 +83,17 @@ class BDRequest
     uint32 getBlocksDone(){ return blocks_done_; };
     void *getBuffer(){ return buffer_; };
     Thread *getThread(){ return requesting_thread_; };
+    WaitQueue *getWaitQueue(){ return &wait_queue_; };
     BDRequest *getNextRequest(){ return next_request_; };
+    BDRequest *getMergeNext(){ return merge_next_; };
+    uint32 getMergedBlocks(){ return merged_blocks_; };
 
     void setStartBlock( uint32 start_blk ){ start_block_=start_blk; };
     void setResult( uint32 result ){ result_=result; };
     void setStatus( BD_RESULT status ){ status_=status; };
     void setBlocksDone( uint32 bdone ){ blocks_done_=bdone; };
     void setNextRequest( BDRequest *next ){ next_request_=next; };
-    void setNumBlocks(uint32 num_block){ num_block_ = num_block; };
+    void setNumBlocks(uint32 num_block){ num_block_ = num_block; merged_blocks_ = num_block; };
 
   private:
     BDRequest();
@@ -96,6 +107,24 @@ class BDRequest
     uint32 blocks_done_;
     void *buffer_;
     Thread *requesting_thread_;
+    /**
+     * the threads sleeping until the request is done
+     */
+    WaitQueue wait_queue_;
     BDRequest *next_request_;
+
+    // links in the pending requests of the IOScheduler
+    BDRequest *sched_next_;
+    BDRequest *sched_prev_;
+    /**
+     * the following request of a merge chain, its blocks directly follow the blocks of this one
+     */
+    BDRequest *merge_next_;
+    /**
+     * the last request and the number of blocks of the merge chain this request is the head of
+     */
+    BDRequest *merge_tail_;
+    uint32 merged_blocks_;
+    uint32 queued_at_;
 };
 
@@ -85,6 +85,11 @@ class Elf
     static const Elf32_Word PT_HIPROC    = 8;
     static const Elf32_Word PT_GNU_STACK = 9;
 
+// PHDR SEGMENT PERMISSION FLAGS
+    static const Elf32_Word PF_X         = 1;
+    static const Elf32_Word PF_W         = 2;
+    static const Elf32_Word PF_R         = 4;
+
     struct sELF32_Ehdr
     {
         uint8 e_ident[EI_NIDENT];
@@ -11,6 +11,8 @@ extern "C"
 #endif
 
 #include "RingBuffer.h"
+#include "WaitQueue.h"
+#include "ArchInterrupts.h"
 #include "atkbd.h"
 
 #define STANDARD_KEYMAP_DEF { 0, 0x1B, '1', '2', '3', '4', '5' , '6', \
@@ -138,8 +140,24 @@ class KeyboardManager
         return false;
     }
 
+    /**
+     * puts the current thread to sleep until the keyboard buffer is not empty
+     */
+    void waitForKey()
+    {
+      ArchInterrupts::disableInterrupts();
+      while (keyboard_buffer_.isEmpty())
+        key_waiters_.sleep();
+      ArchInterrupts::enableInterrupts();
+    }
+
     void serviceIRQ(void);
 
+    /**
+     * decodes the scancodes read by serviceIRQ, the bottom half of the keyboard interrupt (x86 only)
+     */
+    void serviceDeferredIRQ();
+
     bool isShift()
     {
       return keyboard_status_ & KBD_META_SHIFT;
@@ -193,6 +211,16 @@ class KeyboardManager
 
     RingBuffer<uint8> keyboard_buffer_;
 
+    /**
+     * raw scancodes, read by the interrupt handler and not decoded yet
+     */
+    RingBuffer<uint8> scancode_buffer_;
+
+    /**
+     * threads waiting for a key, woken up when a key is put into keyboard_buffer_
+     */
+    WaitQueue key_waiters_;
+
     static uint32 const STANDARD_KEYMAP[];
     static uint32 const E0_KEYS[];
     static uint8 const SET1_SCANCODES[];
@@ -208,6 +236,8 @@ class KeyboardManager
      */
     void modifyKeyboardStatus(uint8 sc);
 
+    void processScancode(uint8 scancode);
+
     void setLEDs(void);
 
     uint32 extended_scancode;
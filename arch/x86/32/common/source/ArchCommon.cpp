@@ -217,7 +217,21 @@ void ArchCommon::initDebug()
 
 void ArchCommon::idle()
 {
-  asm volatile("hlt");
+  // interrupts are only enabled after the next instruction, so none can slip in before the hlt
+  asm volatile("sti\n"
+               "hlt");
+}
+
+uint64 ArchCommon::getTimestamp()
+{
+  uint32 low, high;
+  asm volatile("rdtsc" : "=a"(low), "=d"(high));
+  return ((uint64) high << 32) | low;
+}
+
+size_t ArchCommon::getNumCpus()
+{
+  return 1;
 }
 
 #define STATS_OFFSET 22
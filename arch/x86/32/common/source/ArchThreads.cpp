@@ -69,6 +69,13 @@ void ArchThreads::createUserRegisters(ArchThreadRegisters *&info, void* start_fu
   info->esp0    = (size_t)kernel_stack;
 }
 
+void ArchThreads::forkUserRegisters(ArchThreadRegisters *&info, ArchThreadRegisters *parent, void* kernel_stack)
+{
+  info = new ArchThreadRegisters(*parent);
+  info->eax     = 0;
+  info->esp0    = (size_t)kernel_stack;
+}
+
 void ArchThreads::changeInstructionPointer(ArchThreadRegisters *info, void* function)
 {
   info->eip = (size_t)function;
@@ -79,11 +86,21 @@ void ArchThreads::yield()
   __asm__ __volatile__("int $65");
 }
 
+void ArchThreads::pause()
+{
+  __asm__ __volatile__("pause");
+}
+
 uint32 ArchThreads::testSetLock(uint32 &lock, uint32 new_value)
 {
   return __sync_lock_test_and_set(&lock,new_value);
 }
 
+bool ArchThreads::compareAndSwap(size_t &value, size_t expected, size_t desired)
+{
+  return __sync_bool_compare_and_swap(&value, expected, desired);
+}
+
 uint32 ArchThreads::atomic_add(uint32 &value, int32 increment)
 {
   return __sync_fetch_and_add(&value,increment);
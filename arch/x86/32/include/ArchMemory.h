@@ -24,8 +24,9 @@ public:
  * @param physical_page
  * @param user_access PTE User/Supervisor Flag, governing the binary Paging
  * Privilege Mechanism
+ * @param writeable 0 maps the page read-only, e.g. to share it between processes
  */
-  __attribute__((warn_unused_result)) bool mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_access);
+  __attribute__((warn_unused_result)) bool mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_access, uint32 writeable);
 
 /**
  * removes the mapping to a virtual_page by marking its PTE Entry as non valid
@@ -34,6 +35,42 @@ public:
  */
   void unmapPage(uint32 virtual_page);
 
+/**
+ * shares the user space with the empty address space of a forked process copy-on-write
+ * @param child the address space of the new process
+ * @return false if forking is not supported
+ */
+  bool forkInto(ArchMemory& child);
+
+/**
+ * resolves a write fault on a mapped page which is copy-on-write
+ * @param virtual_page the page written to
+ * @return false if the page is not mapped or read-only
+ */
+  bool copyOnWrite(uint32 virtual_page);
+
+/**
+ * checks whether the page reclaim may evict a page, it has to be called with interrupts disabled
+ * @return false if the page must stay, evicting user pages is not implemented on this architecture
+ */
+  static bool ageEntry(pointer pte, uint32 ppn, bool& dirty);
+
+/**
+ * replaces an entry checked by ageEntry by a swap entry, or clears it if slot is 0
+ */
+  static void evictEntry(pointer pte, size_t slot);
+
+/**
+ * @return the swap slot of the page if it has been evicted to the swap partition, 0 otherwise
+ */
+  size_t getSwapSlot(uint32 virtual_page);
+
+/**
+ * maps the page read back from the swap partition in place of the swap entry
+ * @return false if the entry does not refer to the slot any more
+ */
+  bool mapSwappedPage(uint32 virtual_page, uint32 physical_page, size_t slot);
+
   ~ArchMemory();
 
 /**
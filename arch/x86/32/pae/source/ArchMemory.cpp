@@ -71,7 +71,7 @@ void ArchMemory::insertPT(PageDirEntry* page_directory, uint32 pde_vpn, uint32 p
   page_directory[pde_vpn].pt.present = 1;
 }
 
-bool ArchMemory::mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_access)
+bool ArchMemory::mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_access, uint32 writeable)
 {
   RESOLVEMAPPING(page_dir_pointer_table_,virtual_page);
 
@@ -91,10 +91,12 @@ bool ArchMemory::mapPage(uint32 virtual_page, uint32 physical_page, uint32 user_
   PageTableEntry *pte_base = (PageTableEntry *) getIdentAddressOfPPN(page_directory[pde_vpn].pt.page_table_ppn);
   if(pte_base[pte_vpn].present == 0)
   {
-    pte_base[pte_vpn].writeable = 1;
+    pte_base[pte_vpn].writeable = writeable;
     pte_base[pte_vpn].user_access = user_access;
     pte_base[pte_vpn].page_ppn = physical_page;
     pte_base[pte_vpn].present = 1;
+    PageManager::instance()->addMapping(physical_page, page_directory[pde_vpn].pt.page_table_ppn,
+                                        (pointer) &pte_base[pte_vpn], user_access);
     return true;
   }
 
@@ -244,3 +246,34 @@ pointer ArchMemory::getIdentAddressOfPPN(uint32 ppn, uint32 page_size /* optiona
 {
   return (3U*1024U*1024U*1024U) + (ppn * page_size);
 }
+
+bool ArchMemory::forkInto(ArchMemory&)
+{
+  debug(A_MEMORY, "forkInto: copy-on-write is not implemented on this architecture\n");
+  return false;
+}
+
+bool ArchMemory::copyOnWrite(uint32)
+{
+  return false;
+}
+
+bool ArchMemory::ageEntry(pointer, uint32, bool&)
+{
+  return false;
+}
+
+void ArchMemory::evictEntry(pointer, size_t)
+{
+  assert(false && "ArchMemory::evictEntry: there are no swap entries on this architecture");
+}
+
+size_t ArchMemory::getSwapSlot(uint32)
+{
+  return 0;
+}
+
+bool ArchMemory::mapSwappedPage(uint32, uint32, size_t)
+{
+  return false;
+}
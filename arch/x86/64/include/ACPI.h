@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.h"
+
+/**
+ * Finds the ACPI tables set up by the firmware and reads the interrupt controllers and processors
+ * from the MADT (Multiple APIC Description Table).
+ * Only tables in the identity mapped first GiB of physical memory can be read.
+ * For now the results are only reported at boot: the application processors are not started
+ * and the interrupts stay on the 8259s.
+ */
+class ACPI
+{
+  public:
+    static const size_t MAX_CPUS = 16;
+    static const size_t MAX_IO_APICS = 4;
+    static const size_t NUM_ISA_IRQS = 16;
+
+    struct IOApic
+    {
+      uint8 id_;
+      uint32 address_;
+      uint32 gsi_base_;
+    };
+
+    /**
+     * searches the RSDP and parses the MADT, without ACPI a single cpu is assumed
+     */
+    static void initialise();
+
+    /**
+     * @return the number of enabled processors, at least 1
+     */
+    static size_t getNumCpus();
+
+    /**
+     * @return the local APIC id of the given processor, the boot processor is not necessarily the first one
+     */
+    static uint8 getLocalApicID(size_t cpu);
+
+    /**
+     * @return the physical address of the local APICs, 0 if there is no MADT
+     */
+    static uint64 getLocalApicAddress();
+
+    static size_t getNumIOApics();
+    static const IOApic& getIOApic(size_t index);
+
+    /**
+     * @return the global system interrupt an ISA irq is connected to, taking the source overrides into account
+     */
+    static uint32 getGSIOfISAIrq(uint8 irq);
+
+  private:
+    struct RSDP;
+    struct SDTHeader;
+
+    static RSDP* findRSDP();
+    static RSDP* scanForRSDP(pointer start, size_t length);
+    static SDTHeader* findTable(RSDP* rsdp, const char* signature);
+    static void parseMADT(SDTHeader* madt);
+
+    /**
+     * @return a pointer to the given physical address through the identity mapping, 0 if it is not mapped
+     */
+    static void* physicalToVirtual(uint64 address, size_t size);
+    static bool checksumOK(const void* data, size_t length);
+
+    static size_t num_cpus_;
+    static uint8 local_apic_ids_[MAX_CPUS];
+    static uint64 local_apic_address_;
+    static size_t num_io_apics_;
+    static IOApic io_apics_[MAX_IO_APICS];
+    static uint32 isa_irq_gsi_[NUM_ISA_IRQS];
+};
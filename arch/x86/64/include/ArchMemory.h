@@ -41,8 +41,9 @@ public:
  * @param physical_page
  * @param user_access PTE User/Supervisor Flag, governing the binary Paging
  * Privilege Mechanism
+ * @param writeable 0 maps the page read-only, e.g. to share it between processes
  */
-  __attribute__((warn_unused_result)) bool mapPage(uint64 virtual_page, uint64 physical_page, uint64 user_access);
+  __attribute__((warn_unused_result)) bool mapPage(uint64 virtual_page, uint64 physical_page, uint64 user_access, uint64 writeable);
 
 /**
  * removes the mapping to a virtual_page by marking its PTE Entry as non valid
@@ -52,6 +53,51 @@ public:
  */
   bool unmapPage(uint64 virtual_page);
 
+/**
+ * shares the user space with the empty address space of a forked process copy-on-write.
+ * The page tables are shared read-only, so the cost depends on the number of page tables,
+ * not on the number of pages. The first write through a shared page table copies it, the
+ * first write to a page shared by two page tables copies the page.
+ * @param child the address space of the new process
+ * @return false if forking is not supported
+ */
+  bool forkInto(ArchMemory& child);
+
+/**
+ * resolves a write fault on a mapped page which is copy-on-write
+ * @param virtual_page the page written to
+ * @return false if the page is not mapped or read-only
+ */
+  bool copyOnWrite(uint64 virtual_page);
+
+/**
+ * checks whether the page reclaim may evict a page, it has to be called with interrupts disabled.
+ * The accessed bit of the entry is cleared, so a page in use survives at least one more scan.
+ * @param pte the entry mapping the page, see PageManager::getMapping
+ * @param ppn the page the entry has to map
+ * @param dirty set if the page has been written through the entry
+ * @return false if the entry does not map the page or the page has been accessed since the last scan
+ */
+  static bool ageEntry(pointer pte, uint64 ppn, bool& dirty);
+
+/**
+ * replaces an entry checked by ageEntry, the reference of the entry to the page is handed to the caller.
+ * It has to be called with interrupts disabled.
+ * @param slot the swap slot the page is written to, 0 clears the entry, so the page is loaded again on the next fault
+ */
+  static void evictEntry(pointer pte, size_t slot);
+
+/**
+ * @return the swap slot of the page if it has been evicted to the swap partition, 0 otherwise
+ */
+  size_t getSwapSlot(uint64 virtual_page);
+
+/**
+ * maps the page read back from the swap partition in place of the swap entry
+ * @return false if the entry does not refer to the slot any more
+ */
+  bool mapSwappedPage(uint64 virtual_page, uint64 physical_page, size_t slot);
+
   ~ArchMemory();
 
 /**
@@ -139,6 +185,19 @@ private:
  */
   template<typename T> static bool checkAndRemove(pointer map_ptr, uint64 index);
 
+/**
+ * gives the page directory entry a page table of its own, a copy if the page table is still shared
+ */
+  static void unsharePageTable(PageDirEntry* pd, uint64 pdi);
+
+/**
+ * drops the reference to a page table which is shared with another address space
+ * @return false if the page table is not shared any more, the reference is kept then
+ */
+  static bool dropSharedPageTable(uint64 pt_ppn);
+
+  static void flushTLB();
+
   ArchMemory(ArchMemory const &src);
   ArchMemory &operator=(ArchMemory const &src);
 
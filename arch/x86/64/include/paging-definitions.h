@@ -94,7 +94,8 @@ struct PageDirPageTableEntry
   uint64 accessed                  :1;
   uint64 ignored_3                 :1;
   uint64 size                      :1; // 0 means page table mapped
-  uint64 ignored_2                 :4;
+  uint64 cow                       :1; // ignored by the cpu: the page table is shared copy-on-write
+  uint64 ignored_2                 :3;
   uint64 page_ppn                  :28;
   uint64 reserved_1                :12; // must be 0
   uint64 ignored_1                 :11;
@@ -142,7 +143,9 @@ typedef struct
   uint64 dirty                     :1;
   uint64 size                      :1;
   uint64 global                    :1;
-  uint64 ignored_2                 :3;
+  uint64 cow                       :1; // ignored by the cpu: the page is write protected for copy-on-write
+  uint64 swapped                   :1; // ignored by the cpu: not present, page_ppn is the swap slot of the page
+  uint64 ignored_2                 :1;
   uint64 page_ppn                  :28;
   uint64 reserved_1                :12; // must be 0
   uint64 ignored_1                 :11;
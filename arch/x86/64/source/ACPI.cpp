@@ -0,0 +1,282 @@
+#include "ACPI.h"
+#include "ArchMemory.h"
+#include "kstring.h"
+#include "assert.h"
+#include "debug.h"
+
+struct ACPI::RSDP
+{
+  char signature_[8];
+  uint8 checksum_;
+  char oem_id_[6];
+  uint8 revision_;
+  uint32 rsdt_address_;
+  // the following fields exist from revision 2 on
+  uint32 length_;
+  uint64 xsdt_address_;
+  uint8 extended_checksum_;
+  uint8 reserved_[3];
+} __attribute__((packed));
+
+struct ACPI::SDTHeader
+{
+  char signature_[4];
+  uint32 length_;
+  uint8 revision_;
+  uint8 checksum_;
+  char oem_id_[6];
+  char oem_table_id_[8];
+  uint32 oem_revision_;
+  uint32 creator_id_;
+  uint32 creator_revision_;
+} __attribute__((packed));
+
+struct MADTHeader
+{
+  uint32 local_apic_address_;
+  uint32 flags_;
+} __attribute__((packed));
+
+struct MADTEntry
+{
+  uint8 type_;
+  uint8 length_;
+} __attribute__((packed));
+
+enum MADTEntryType
+{
+  MADT_LOCAL_APIC = 0, MADT_IO_APIC = 1, MADT_INTERRUPT_SOURCE_OVERRIDE = 2, MADT_LOCAL_APIC_ADDRESS_OVERRIDE = 5
+};
+
+struct MADTLocalApic
+{
+  MADTEntry header_;
+  uint8 processor_id_;
+  uint8 apic_id_;
+  uint32 flags_;
+} __attribute__((packed));
+
+struct MADTIOApic
+{
+  MADTEntry header_;
+  uint8 id_;
+  uint8 reserved_;
+  uint32 address_;
+  uint32 gsi_base_;
+} __attribute__((packed));
+
+struct MADTInterruptSourceOverride
+{
+  MADTEntry header_;
+  uint8 bus_;
+  uint8 source_;
+  uint32 gsi_;
+  uint16 flags_;
+} __attribute__((packed));
+
+struct MADTLocalApicAddressOverride
+{
+  MADTEntry header_;
+  uint16 reserved_;
+  uint64 address_;
+} __attribute__((packed));
+
+static const uint32 MADT_LOCAL_APIC_ENABLED = 1;
+
+// only the first GiB of physical memory is identity mapped, see init_boottime_pagetables.cpp
+static const uint64 IDENT_MAPPED_SIZE = 1024ULL * 1024 * 1024;
+
+size_t ACPI::num_cpus_ = 1;
+uint8 ACPI::local_apic_ids_[ACPI::MAX_CPUS];
+uint64 ACPI::local_apic_address_ = 0;
+size_t ACPI::num_io_apics_ = 0;
+ACPI::IOApic ACPI::io_apics_[ACPI::MAX_IO_APICS];
+uint32 ACPI::isa_irq_gsi_[ACPI::NUM_ISA_IRQS];
+
+void ACPI::initialise()
+{
+  for (size_t i = 0; i < NUM_ISA_IRQS; ++i)
+    isa_irq_gsi_[i] = i;
+
+  RSDP* rsdp = findRSDP();
+  if (!rsdp)
+  {
+    debug(A_BOOT, "ACPI: no RSDP found, assuming a single cpu\n");
+    return;
+  }
+  debug(A_BOOT, "ACPI: RSDP revision %u at %p\n", rsdp->revision_, rsdp);
+  SDTHeader* madt = findTable(rsdp, "APIC");
+  if (!madt)
+  {
+    debug(A_BOOT, "ACPI: no MADT found, assuming a single cpu\n");
+    return;
+  }
+  parseMADT(madt);
+  debug(A_BOOT, "ACPI: %zu cpus, %zu IO APICs, local APICs at %llx\n", num_cpus_, num_io_apics_,
+        (unsigned long long) local_apic_address_);
+}
+
+ACPI::RSDP* ACPI::findRSDP()
+{
+  // the first KiB of the extended bios data area, its segment is stored at 0x40E
+  uint16* ebda_segment = (uint16*) physicalToVirtual(0x40E, sizeof(uint16));
+  RSDP* rsdp = scanForRSDP(((pointer) *ebda_segment) << 4, 1024);
+  if (!rsdp)
+    rsdp = scanForRSDP(0xE0000, 0x20000);
+  return rsdp;
+}
+
+ACPI::RSDP* ACPI::scanForRSDP(pointer start, size_t length)
+{
+  if (!start)
+    return 0;
+  // the RSDP is aligned to 16 bytes
+  for (pointer address = start; address + sizeof(RSDP) <= start + length; address += 16)
+  {
+    RSDP* rsdp = (RSDP*) physicalToVirtual(address, sizeof(RSDP));
+    if (memcmp(rsdp->signature_, "RSD PTR ", 8) == 0 && checksumOK(rsdp, __builtin_offsetof(RSDP, length_)))
+      return rsdp;
+  }
+  return 0;
+}
+
+ACPI::SDTHeader* ACPI::findTable(RSDP* rsdp, const char* signature)
+{
+  // the XSDT holds 64 bit pointers, the RSDT of revision 1 only 32 bit ones
+  bool extended = rsdp->revision_ >= 2 && rsdp->xsdt_address_;
+  uint64 root_address = extended ? rsdp->xsdt_address_ : rsdp->rsdt_address_;
+  SDTHeader* root = (SDTHeader*) physicalToVirtual(root_address, sizeof(SDTHeader));
+  if (!root || !physicalToVirtual(root_address, root->length_) || !checksumOK(root, root->length_))
+  {
+    debug(A_BOOT, "ACPI: root table at %llx is not usable\n", (unsigned long long) root_address);
+    return 0;
+  }
+  size_t entry_size = extended ? sizeof(uint64) : sizeof(uint32);
+  size_t num_entries = (root->length_ - sizeof(SDTHeader)) / entry_size;
+  uint8* entries = (uint8*) (root + 1);
+  for (size_t i = 0; i < num_entries; ++i)
+  {
+    uint64 address = extended ? *(uint64*) (entries + i * entry_size) : *(uint32*) (entries + i * entry_size);
+    SDTHeader* table = (SDTHeader*) physicalToVirtual(address, sizeof(SDTHeader));
+    if (!table || memcmp(table->signature_, signature, 4) != 0)
+      continue;
+    if (!physicalToVirtual(address, table->length_) || !checksumOK(table, table->length_))
+    {
+      debug(A_BOOT, "ACPI: table %.4s at %llx is not usable\n", signature, (unsigned long long) address);
+      continue;
+    }
+    return table;
+  }
+  return 0;
+}
+
+void ACPI::parseMADT(SDTHeader* madt)
+{
+  MADTHeader* header = (MADTHeader*) (madt + 1);
+  local_apic_address_ = header->local_apic_address_;
+  num_cpus_ = 0;
+  uint8* position = (uint8*) (header + 1);
+  uint8* end = (uint8*) madt + madt->length_;
+  while (position + sizeof(MADTEntry) <= end)
+  {
+    MADTEntry* entry = (MADTEntry*) position;
+    if (entry->length_ < sizeof(MADTEntry) || position + entry->length_ > end)
+      break;
+    switch (entry->type_)
+    {
+      case MADT_LOCAL_APIC:
+      {
+        MADTLocalApic* local_apic = (MADTLocalApic*) entry;
+        if (!(local_apic->flags_ & MADT_LOCAL_APIC_ENABLED))
+          break;
+        if (num_cpus_ < MAX_CPUS)
+          local_apic_ids_[num_cpus_++] = local_apic->apic_id_;
+        else
+          debug(A_BOOT, "ACPI: ignoring cpu with APIC id %u, at most %zu are supported\n", local_apic->apic_id_,
+                MAX_CPUS);
+        break;
+      }
+      case MADT_IO_APIC:
+      {
+        MADTIOApic* io_apic = (MADTIOApic*) entry;
+        if (num_io_apics_ < MAX_IO_APICS)
+        {
+          io_apics_[num_io_apics_].id_ = io_apic->id_;
+          io_apics_[num_io_apics_].address_ = io_apic->address_;
+          io_apics_[num_io_apics_].gsi_base_ = io_apic->gsi_base_;
+          ++num_io_apics_;
+        }
+        break;
+      }
+      case MADT_INTERRUPT_SOURCE_OVERRIDE:
+      {
+        MADTInterruptSourceOverride* override = (MADTInterruptSourceOverride*) entry;
+        if (override->bus_ == 0 && override->source_ < NUM_ISA_IRQS)
+        {
+          debug(A_BOOT, "ACPI: ISA irq %u is connected to GSI %u\n", override->source_, override->gsi_);
+          isa_irq_gsi_[override->source_] = override->gsi_;
+        }
+        break;
+      }
+      case MADT_LOCAL_APIC_ADDRESS_OVERRIDE:
+        local_apic_address_ = ((MADTLocalApicAddressOverride*) entry)->address_;
+        break;
+      default:
+        break;
+    }
+    position += entry->length_;
+  }
+  if (num_cpus_ == 0)
+  {
+    debug(A_BOOT, "ACPI: the MADT lists no enabled cpu, assuming a single one\n");
+    num_cpus_ = 1;
+  }
+}
+
+void* ACPI::physicalToVirtual(uint64 address, size_t size)
+{
+  if (address + size > IDENT_MAPPED_SIZE || address + size < address)
+    return 0;
+  return (void*) (ArchMemory::getIdentAddressOfPPN(address / PAGE_SIZE) + address % PAGE_SIZE);
+}
+
+bool ACPI::checksumOK(const void* data, size_t length)
+{
+  uint8 sum = 0;
+  for (size_t i = 0; i < length; ++i)
+    sum += ((const uint8*) data)[i];
+  return sum == 0;
+}
+
+size_t ACPI::getNumCpus()
+{
+  return num_cpus_;
+}
+
+uint8 ACPI::getLocalApicID(size_t cpu)
+{
+  assert(cpu < num_cpus_);
+  return local_apic_ids_[cpu];
+}
+
+uint64 ACPI::getLocalApicAddress()
+{
+  return local_apic_address_;
+}
+
+size_t ACPI::getNumIOApics()
+{
+  return num_io_apics_;
+}
+
+const ACPI::IOApic& ACPI::getIOApic(size_t index)
+{
+  assert(index < num_io_apics_);
+  return io_apics_[index];
+}
+
+uint32 ACPI::getGSIOfISAIrq(uint8 irq)
+{
+  assert(irq < NUM_ISA_IRQS);
+  return isa_irq_gsi_[irq];
+}
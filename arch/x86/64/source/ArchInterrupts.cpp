@@ -5,11 +5,14 @@
 #include "ArchThreads.h"
 #include "assert.h"
 #include "Thread.h"
+#include "ACPI.h"
 
 void ArchInterrupts::initialise()
 {
   uint16 i;
   disableInterrupts();
+  ACPI::initialise();
+  // the interrupts are still delivered through the 8259s, the IO APICs from the MADT are left masked
   initialise8259s();
   InterruptUtils::initialise();
   for (i=0;i<16;++i)
@@ -21,6 +24,11 @@ void ArchInterrupts::enableTimer()
   enableIRQ(0);
 }
 
+// the frequency the PIT counters are clocked with
+static const uint64 PIT_FREQUENCY = 1193182;
+// the count programmed by setTimerOneShot, 0 if the PIT runs periodically
+static uint32 pit_one_shot_count = 0;
+
 void ArchInterrupts::setTimerFrequency(uint32 freq) {
   uint16_t divisor;
   if(freq < (uint32)(1193180. / (1 << 16) + 1)) {
@@ -31,6 +39,42 @@ void ArchInterrupts::setTimerFrequency(uint32 freq) {
   outportb(0x43, 0x36);
   outportb(0x40, divisor & 0xFF);
   outportb(0x40, divisor >> 8);
+  pit_one_shot_count = 0;
+}
+
+uint64 ArchInterrupts::setTimerOneShot(uint64 ns)
+{
+  // limit the time first, so the multiplication cannot overflow
+  if (ns > 1000000000ULL)
+    ns = 1000000000ULL;
+  uint64 count = ns * PIT_FREQUENCY / 1000000000ULL;
+  if (count < 1)
+    count = 1;
+  if (count > 0xFFFF)
+    count = 0xFFFF;
+  outportb(0x43, 0x30); // channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count)
+  outportb(0x40, count & 0xFF);
+  outportb(0x40, count >> 8);
+  pit_one_shot_count = count;
+  return count * 1000000000ULL / PIT_FREQUENCY;
+}
+
+uint64 ArchInterrupts::getTimerElapsed()
+{
+  if (!pit_one_shot_count)
+    return 0;
+  outportb(0x43, 0xC2); // read-back command: latch status and count of channel 0
+  uint8 status = inportb(0x40);
+  uint32 count = inportb(0x40);
+  count |= inportb(0x40) << 8;
+  if (status & 0x40) // the new count has not been loaded yet
+    return 0;
+  uint32 elapsed;
+  if (status & 0x80) // the output is high, so the counter has run out and wrapped around
+    elapsed = pit_one_shot_count + ((0x10000 - count) & 0xFFFF);
+  else
+    elapsed = pit_one_shot_count - count;
+  return elapsed * 1000000000ULL / PIT_FREQUENCY;
 }
 
 void ArchInterrupts::disableTimer()
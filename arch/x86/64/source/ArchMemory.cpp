@@ -3,6 +3,7 @@
 #include "kprintf.h"
 #include "assert.h"
 #include "PageManager.h"
+#include "PageReclaim.h"
 #include "kstring.h"
 #include "ArchThreads.h"
 #include "Thread.h"
@@ -38,6 +39,11 @@ bool ArchMemory::checkAndRemove(pointer map_ptr, uint64 index)
 bool ArchMemory::unmapPage(uint64 virtual_page)
 {
   ArchMemoryMapping m = resolveMapping(virtual_page);
+  if (m.pt_ppn != 0 && m.pd[m.pdi].pt.cow)
+  {
+    unsharePageTable(m.pd, m.pdi);
+    m = resolveMapping(virtual_page);
+  }
 
   assert(m.page_ppn != 0 && m.page_size == PAGE_SIZE && m.pt[m.pti].present);
   m.pt[m.pti].present = 0;
@@ -83,9 +89,9 @@ bool ArchMemory::insert(pointer map_ptr, uint64 index, uint64 ppn, uint64 bzero,
   return true;
 }
 
-bool ArchMemory::mapPage(uint64 virtual_page, uint64 physical_page, uint64 user_access)
+bool ArchMemory::mapPage(uint64 virtual_page, uint64 physical_page, uint64 user_access, uint64 writeable)
 {
-  debug(A_MEMORY, "%zx %zx %zx %zx\n", page_map_level_4_, virtual_page, physical_page, user_access);
+  debug(A_MEMORY, "%zx %zx %zx %zx %zx\n", page_map_level_4_, virtual_page, physical_page, user_access, writeable);
   ArchMemoryMapping m = resolveMapping(page_map_level_4_, virtual_page);
   assert((m.page_size == 0) || (m.page_size == PAGE_SIZE));
 
@@ -106,10 +112,20 @@ bool ArchMemory::mapPage(uint64 virtual_page, uint64 physical_page, uint64 user_
     m.pt_ppn = PageManager::instance()->allocPPN();
     insert<PageDirPageTableEntry>(getIdentAddressOfPPN(m.pd_ppn), m.pdi, m.pt_ppn, 1, 0, 1, 1);
   }
+  else if (m.pd[m.pdi].pt.cow)
+  {
+    // the entry must not appear in the address space the page table is shared with
+    unsharePageTable(m.pd, m.pdi);
+    m = resolveMapping(page_map_level_4_, virtual_page);
+  }
 
-  if (m.page_ppn == 0)
+  PageTableEntry* pt = (PageTableEntry*) getIdentAddressOfPPN(m.pt_ppn);
+  // an evicted page is read back from the swap partition on its next fault
+  if (m.page_ppn == 0 && !pt[m.pti].swapped)
   {
-    return insert<PageTableEntry>(getIdentAddressOfPPN(m.pt_ppn), m.pti, physical_page, 0, 0, user_access, 1);
+    insert<PageTableEntry>((pointer) pt, m.pti, physical_page, 0, 0, user_access, writeable);
+    PageManager::instance()->addMapping(physical_page, m.pt_ppn, (pointer) &pt[m.pti], user_access);
+    return true;
   }
 
   return false;
@@ -133,7 +149,12 @@ ArchMemory::~ArchMemory()
           PageDirEntry* pd = (PageDirEntry*) getIdentAddressOfPPN(pdpt[pdpti].pd.page_ppn);
           for (uint64 pdi = 0; pdi < PAGE_DIR_ENTRIES; pdi++)
           {
-            if (pd[pdi].pt.present)
+            if (pd[pdi].pt.present && pd[pdi].pt.cow && dropSharedPageTable(pd[pdi].pt.page_ppn))
+            {
+              // the pages belong to the address space which still uses the page table
+              pd[pdi].pt.present = 0;
+            }
+            else if (pd[pdi].pt.present)
             {
               assert(pd[pdi].pt.size == 0);
               PageTableEntry* pt = (PageTableEntry*) getIdentAddressOfPPN(pd[pdi].pt.page_ppn);
@@ -144,6 +165,11 @@ ArchMemory::~ArchMemory()
                   pt[pti].present = 0;
                   PageManager::instance()->freePPN(pt[pti].page_ppn);
                 }
+                else if (pt[pti].swapped)
+                {
+                  pt[pti].swapped = 0;
+                  PageReclaim::instance()->freeSlot(pt[pti].page_ppn);
+                }
               }
               pd[pdi].pt.present = 0;
               PageManager::instance()->freePPN(pd[pdi].pt.page_ppn);
@@ -160,6 +186,227 @@ ArchMemory::~ArchMemory()
   PageManager::instance()->freePPN(page_map_level_4_);
 }
 
+bool ArchMemory::forkInto(ArchMemory& child)
+{
+  size_t num_copied = 0, num_shared = 0;
+  PageMapLevel4Entry* pml4 = (PageMapLevel4Entry*) getIdentAddressOfPPN(page_map_level_4_);
+  PageMapLevel4Entry* child_pml4 = (PageMapLevel4Entry*) getIdentAddressOfPPN(child.page_map_level_4_);
+  for (uint64 pml4i = 0; pml4i < PAGE_MAP_LEVEL_4_ENTRIES / 2; pml4i++) // user space only
+  {
+    if (!pml4[pml4i].present)
+      continue;
+    assert(!child_pml4[pml4i].present && "the address space to fork into is not empty");
+    uint64 child_pdpt_ppn = PageManager::instance()->allocPPN();
+    ++num_copied;
+    child_pml4[pml4i] = pml4[pml4i];
+    child_pml4[pml4i].page_ppn = child_pdpt_ppn;
+    PageDirPointerTableEntry* pdpt = (PageDirPointerTableEntry*) getIdentAddressOfPPN(pml4[pml4i].page_ppn);
+    PageDirPointerTableEntry* child_pdpt = (PageDirPointerTableEntry*) getIdentAddressOfPPN(child_pdpt_ppn);
+    for (uint64 pdpti = 0; pdpti < PAGE_DIR_POINTER_TABLE_ENTRIES; pdpti++)
+    {
+      if (!pdpt[pdpti].pd.present)
+        continue;
+      assert(pdpt[pdpti].pd.size == 0);
+      uint64 child_pd_ppn = PageManager::instance()->allocPPN();
+      ++num_copied;
+      child_pdpt[pdpti] = pdpt[pdpti];
+      child_pdpt[pdpti].pd.page_ppn = child_pd_ppn;
+      PageDirEntry* pd = (PageDirEntry*) getIdentAddressOfPPN(pdpt[pdpti].pd.page_ppn);
+      PageDirEntry* child_pd = (PageDirEntry*) getIdentAddressOfPPN(child_pd_ppn);
+      for (uint64 pdi = 0; pdi < PAGE_DIR_ENTRIES; pdi++)
+      {
+        if (!pd[pdi].pt.present)
+          continue;
+        assert(pd[pdi].pt.size == 0);
+        // both address spaces use the page table read-only until one of them writes through it
+        pd[pdi].pt.writeable = 0;
+        pd[pdi].pt.cow = 1;
+        child_pd[pdi] = pd[pdi];
+        PageManager::instance()->addReference(pd[pdi].pt.page_ppn);
+        ++num_shared;
+      }
+    }
+  }
+  flushTLB();
+  debug(A_MEMORY, "forkInto: %zx -> %zx, copied %zu paging structure pages, shared %zu page tables\n",
+        page_map_level_4_, child.page_map_level_4_, num_copied, num_shared);
+  return true;
+}
+
+bool ArchMemory::copyOnWrite(uint64 virtual_page)
+{
+  ArchMemoryMapping m = resolveMapping(virtual_page);
+  if (m.pt_ppn == 0)
+    return false;
+  if (m.pd[m.pdi].pt.cow)
+  {
+    unsharePageTable(m.pd, m.pdi);
+    m = resolveMapping(virtual_page);
+  }
+  if (!m.pt[m.pti].present)
+    return false;
+  if (m.pt[m.pti].writeable)
+    return true; // only the page table was write protected
+  if (!m.pt[m.pti].cow)
+    return false; // a read-only page
+
+  // the copy is allocated first, allocPPN may sleep
+  uint64 new_ppn = PageManager::instance()->allocPPN();
+  bool copied = false;
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  uint64 old_ppn = m.pt[m.pti].page_ppn;
+  if (PageManager::instance()->getReferenceCount(old_ppn) > 1)
+  {
+    memcpy((void*) getIdentAddressOfPPN(new_ppn), (void*) getIdentAddressOfPPN(old_ppn), PAGE_SIZE);
+    m.pt[m.pti].page_ppn = new_ppn;
+    // there is another reference left, so this only drops ours
+    PageManager::instance()->freePPN(old_ppn);
+    copied = true;
+  }
+  m.pt[m.pti].writeable = 1;
+  m.pt[m.pti].cow = 0;
+  // the page is written right after the fault, its last other reference may be gone since it was shared
+  PageManager::instance()->addMapping(m.pt[m.pti].page_ppn, m.pt_ppn, (pointer) &m.pt[m.pti], true);
+  PageManager::instance()->setFlags(m.pt[m.pti].page_ppn, PageFrame::DIRTY);
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  if (!copied)
+    PageManager::instance()->freePPN(new_ppn);
+  flushTLB();
+  debug(A_MEMORY, "copyOnWrite: page %zx %s\n", virtual_page, copied ? "copied" : "was not shared any more");
+  return true;
+}
+
+bool ArchMemory::ageEntry(pointer pte, uint64 ppn, bool& dirty)
+{
+  assert(!ArchInterrupts::testIFSet());
+  PageTableEntry* entry = (PageTableEntry*) pte;
+  if (!entry->present || entry->page_ppn != ppn || !entry->user_access)
+    return false;
+  dirty = entry->dirty;
+  if (entry->accessed)
+  {
+    // no TLB flush, at worst the cpu does not set the bit again and the page is evicted a scan too early
+    entry->accessed = 0;
+    return false;
+  }
+  return true;
+}
+
+void ArchMemory::evictEntry(pointer pte, size_t slot)
+{
+  assert(!ArchInterrupts::testIFSet());
+  PageTableEntry* entry = (PageTableEntry*) pte;
+  assert(entry->present);
+  if (slot)
+  {
+    // the permissions are kept for the swap in
+    entry->present = 0;
+    entry->accessed = 0;
+    entry->dirty = 0;
+    entry->swapped = 1;
+    entry->page_ppn = slot;
+  }
+  else
+  {
+    *(uint64*) entry = 0;
+  }
+  flushTLB();
+}
+
+size_t ArchMemory::getSwapSlot(uint64 virtual_page)
+{
+  size_t slot = 0;
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  ArchMemoryMapping m = resolveMapping(virtual_page);
+  if (m.pt_ppn != 0 && !m.pt[m.pti].present && m.pt[m.pti].swapped)
+    slot = m.pt[m.pti].page_ppn;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return slot;
+}
+
+bool ArchMemory::mapSwappedPage(uint64 virtual_page, uint64 physical_page, size_t slot)
+{
+  ArchMemoryMapping m = resolveMapping(virtual_page);
+  if (m.pt_ppn != 0 && m.pd[m.pdi].pt.cow)
+  {
+    // the slot stays with the address space the page table is shared with
+    unsharePageTable(m.pd, m.pdi);
+    m = resolveMapping(virtual_page);
+  }
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  PageTableEntry* entry = m.pt ? &m.pt[m.pti] : 0;
+  bool mapped = entry && !entry->present && entry->swapped && entry->page_ppn == slot;
+  if (mapped)
+  {
+    // the page is private now, even if the slot was shared copy-on-write
+    entry->writeable = entry->writeable | entry->cow;
+    entry->cow = 0;
+    entry->swapped = 0;
+    entry->page_ppn = physical_page;
+    entry->present = 1;
+    PageManager::instance()->addMapping(physical_page, m.pt_ppn, (pointer) entry, entry->user_access);
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return mapped;
+}
+
+void ArchMemory::unsharePageTable(PageDirEntry* pd, uint64 pdi)
+{
+  uint64 new_pt_ppn = PageManager::instance()->allocPPN();
+  bool copied = false;
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  uint64 old_pt_ppn = pd[pdi].pt.page_ppn;
+  if (PageManager::instance()->getReferenceCount(old_pt_ppn) > 1)
+  {
+    // the pages are shared from now on, writeable ones become copy-on-write in both page tables
+    PageTableEntry* pt = (PageTableEntry*) getIdentAddressOfPPN(old_pt_ppn);
+    for (uint64 pti = 0; pti < PAGE_TABLE_ENTRIES; pti++)
+    {
+      if (!pt[pti].present && !pt[pti].swapped)
+        continue;
+      if (pt[pti].writeable)
+      {
+        pt[pti].writeable = 0;
+        pt[pti].cow = 1;
+      }
+      if (pt[pti].swapped)
+        PageReclaim::instance()->addSlotReference(pt[pti].page_ppn);
+      else
+        PageManager::instance()->addReference(pt[pti].page_ppn);
+    }
+    memcpy((void*) getIdentAddressOfPPN(new_pt_ppn), (void*) pt, PAGE_SIZE);
+    pd[pdi].pt.page_ppn = new_pt_ppn;
+    PageManager::instance()->freePPN(old_pt_ppn);
+    copied = true;
+  }
+  pd[pdi].pt.writeable = 1;
+  pd[pdi].pt.cow = 0;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  if (!copied)
+    PageManager::instance()->freePPN(new_pt_ppn);
+  flushTLB();
+}
+
+bool ArchMemory::dropSharedPageTable(uint64 pt_ppn)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  bool shared = PageManager::instance()->getReferenceCount(pt_ppn) > 1;
+  if (shared)
+    PageManager::instance()->freePPN(pt_ppn);
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return shared;
+}
+
+void ArchMemory::flushTLB()
+{
+  asm volatile ("movq %%cr3, %%rax; movq %%rax, %%cr3;" ::: "%rax");
+}
+
 pointer ArchMemory::checkAddressValid(uint64 vaddress_to_check)
 {
   ArchMemoryMapping m = resolveMapping(page_map_level_4_, vaddress_to_check / PAGE_SIZE);
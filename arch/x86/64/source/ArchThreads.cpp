@@ -80,6 +80,13 @@ void ArchThreads::createUserRegisters(ArchThreadRegisters *&info, void* start_fu
   assert(info->cr3);
 }
 
+void ArchThreads::forkUserRegisters(ArchThreadRegisters *&info, ArchThreadRegisters *parent, void* kernel_stack)
+{
+  info = new ArchThreadRegisters(*parent);
+  info->rax     = 0;
+  info->rsp0    = (size_t)kernel_stack;
+}
+
 void ArchThreads::changeInstructionPointer(ArchThreadRegisters *info, void* function)
 {
   info->rip = (size_t)function;
@@ -90,11 +97,21 @@ void ArchThreads::yield()
   __asm__ __volatile__("int $65");
 }
 
+void ArchThreads::pause()
+{
+  __asm__ __volatile__("pause");
+}
+
 size_t ArchThreads::testSetLock(size_t &lock, size_t new_value)
 {
   return __sync_lock_test_and_set(&lock,new_value);
 }
 
+bool ArchThreads::compareAndSwap(size_t &value, size_t expected, size_t desired)
+{
+  return __sync_bool_compare_and_swap(&value, expected, desired);
+}
+
 uint64 ArchThreads::atomic_add(uint64 &value, int64 increment)
 {
   int64 ret=increment;
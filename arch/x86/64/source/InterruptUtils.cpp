@@ -30,6 +30,7 @@
 #include "PageFaultHandler.h"
 
 #include "8259.h"
+#include "SoftIrq.h"
 
 #define LO_WORD(x) (((uint32)(x)) & 0x0000FFFFULL)
 #define HI_WORD(x) ((((uint32)(x)) >> 16) & 0x0000FFFFULL)
@@ -182,6 +183,15 @@ extern "C" void irqHandler_65()
   arch_contextSwitch();
 }
 
+// lets the bottom half raised by a device interrupt run right away instead of at the end of the time slice
+static void scheduleDeferredIRQs()
+{
+  if (!SoftIrq::shouldPreempt())
+    return;
+  Scheduler::instance()->schedule();
+  arch_contextSwitch();
+}
+
 extern "C" void errorHandler(size_t num, size_t eip, size_t cs, size_t spurious);
 extern "C" void arch_pageFaultHandler();
 extern "C" void pageFaultHandler(uint64 address, uint64 error)
@@ -209,26 +219,25 @@ extern "C" void irqHandler_1()
   ++outstanding_EOIs;
   KeyboardManager::instance()->serviceIRQ( );
   ArchInterrupts::EndOfInterrupt(1);
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_irqHandler_3();
 extern "C" void irqHandler_3()
 {
-  kprintfd( "IRQ 3 called\n" );
   ++outstanding_EOIs;
   SerialManager::getInstance()->service_irq( 3 );
   ArchInterrupts::EndOfInterrupt(3);
-  kprintfd( "IRQ 3 ended\n" );
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_irqHandler_4();
 extern "C" void irqHandler_4()
 {
-  kprintfd( "IRQ 4 called\n" );
   ++outstanding_EOIs;
   SerialManager::getInstance()->service_irq( 4 );
   ArchInterrupts::EndOfInterrupt(4);
-  kprintfd( "IRQ 4 ended\n" );
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_irqHandler_6();
@@ -241,19 +250,19 @@ extern "C" void irqHandler_6()
 extern "C" void arch_irqHandler_9();
 extern "C" void irqHandler_9()
 {
-  kprintfd( "IRQ 9 called\n" );
   ++outstanding_EOIs;
   BDManager::getInstance()->serviceIRQ( 9 );
   ArchInterrupts::EndOfInterrupt(9);
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_irqHandler_11();
 extern "C" void irqHandler_11()
 {
-  kprintfd( "IRQ 11 called\n" );
   ++outstanding_EOIs;
   BDManager::getInstance()->serviceIRQ( 11 );
   ArchInterrupts::EndOfInterrupt(11);
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_irqHandler_14();
@@ -263,6 +272,7 @@ extern "C" void irqHandler_14()
   ++outstanding_EOIs;
   BDManager::getInstance()->serviceIRQ( 14 );
   ArchInterrupts::EndOfInterrupt(14);
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_irqHandler_15();
@@ -272,6 +282,7 @@ extern "C" void irqHandler_15()
   ++outstanding_EOIs;
   BDManager::getInstance()->serviceIRQ( 15 );
   ArchInterrupts::EndOfInterrupt(15);
+  scheduleDeferredIRQs();
 }
 
 extern "C" void arch_syscallHandler();
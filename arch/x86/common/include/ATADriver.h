@@ -1,10 +1,10 @@
 #pragma once
 
 #include "BDDriver.h"
+#include "BDRequest.h"
+#include "IOScheduler.h"
 #include "Mutex.h"
 
-class BDRequest;
-
 class ATADriver : public BDDriver
 {
   public:
@@ -14,14 +14,23 @@ class ATADriver : public BDDriver
       BD_PIO_NO_IRQ, BD_PIO, BD_DMA, BD_UDMA
     } BD_ATA_MODES;
 
+    typedef enum BD_ATA_ADDRESSING_
+    {
+      BD_CHS, BD_LBA28, BD_LBA48
+    } BD_ATA_ADDRESSING;
+
+    /**
+     * the largest number of sectors moved per interrupt by READ/WRITE MULTIPLE
+     */
+    static const uint32 MAX_MULTIPLE_SECTORS = 16;
+
     /**
-     * adds the given request to a list and checkes the type of the
-     * request. If it is a read or write request, it is beeing executed,
-     * or the function returns otherwise.
+     * queues the given request. Without interrupts it is executed right away,
+     * otherwise it is started as soon as the requests before it are done and
+     * completed by serviceDeferredIRQ, the caller does not wait for it.
      *
      */
     uint32 addRequest(BDRequest* br);
-    void nextRequest(BDRequest* br);
     ATADriver(uint16 baseport, uint16 getdrive, uint16 irqnum);
     virtual ~ATADriver()
     {
@@ -61,8 +70,21 @@ class ATADriver : public BDDriver
       return 512;
     }
     ;
+    /**
+     * acknowledges the interrupt and leaves the data transfer to serviceDeferredIRQ
+     */
     void serviceIRQ();
 
+    /**
+     * moves the data of the interrupt acknowledged by serviceIRQ and advances the active chain
+     */
+    virtual void serviceDeferredIRQ();
+
+    IOScheduler *getIOScheduler()
+    {
+      return &io_scheduler_;
+    }
+
     /**
      * tests if there is an Interrupt Request waiting
      *
@@ -80,10 +102,72 @@ class ATADriver : public BDDriver
 
   private:
 
-    int32 selectSector(uint32 start_sector, uint32 num_sectors);
+    /**
+     * writes the address and sector count of a command to the task file registers
+     * @param lba48 use the 48 bit register layout, only possible if the drive supports BD_LBA48
+     */
+    int32 selectSector(uint32 start_sector, uint32 num_sectors, bool lba48);
+
+    /**
+     * @return true if the transfer has to use a 48 bit command
+     */
+    bool needsLBA48(uint32 start_sector, uint32 num_sectors);
+
+    /**
+     * @return the command code for reading or writing, with multiple sectors per interrupt if the drive allows it
+     */
+    uint8 commandFor(BDRequest::BD_CMD cmd, bool lba48, bool multiple);
+
+    /**
+     * turns on READ/WRITE MULTIPLE with the given number of sectors per interrupt
+     * @return true if the drive accepted it
+     */
+    bool setMultipleMode(uint32 sectors);
+
+    /**
+     * issues the command for the next part of the active chain, for a write also the first block of sectors of it
+     * @return 0 on success, -1 if the controller did not respond
+     */
+    int32 startTransfer();
+
+    /**
+     * starts the next chain of the io scheduler if no chain is active, chains which cannot be started fail right away
+     */
+    void startNextRequest();
+
+    /**
+     * accounts a transferred sector of the active chain and completes the active request if it was its last one
+     */
+    void sectorDone();
+
+    /**
+     * completes all remaining requests of the active chain with an error
+     */
+    void failActiveRequests();
+
+    /**
+     * sets the status of the request and wakes up the thread waiting for it
+     */
+    void finishRequest(BDRequest* br, BDRequest::BD_RESULT status);
+
+    /**
+     * @return the next sector of the chain to move through the data port, in the buffer of the request it belongs to
+     */
+    uint16 *nextSector();
+
+    /**
+     * moves the sectors of one DRQ block of the current command through the data port
+     * @return the number of sectors moved
+     */
+    uint32 transferBlock();
 
     uint32 numsec;
 
+    BD_ATA_ADDRESSING addressing_;
+    uint32 max_sectors_per_command_;
+    // sectors per DRQ block and interrupt, 1 unless READ/WRITE MULTIPLE is enabled
+    uint32 multiple_sectors_;
+
     uint16 port;
     uint16 drive;
 
@@ -91,9 +175,28 @@ class ATADriver : public BDDriver
 
     BD_ATA_MODES mode; // mode see enum BD_ATA_MODES
 
-    BDRequest *request_list_;
-    BDRequest *request_list_tail_;
-
+    // the pending requests, only used with lock_ held
+    IOScheduler io_scheduler_;
+
+    // the merge chain in progress: the first request of it which is not completed yet,
+    // and the request and sector of it which goes through the data port next
+    BDRequest *active_request_;
+    BDRequest *xfer_request_;
+    uint32 xfer_blocks_;
+    BDRequest::BD_CMD chain_cmd_;
+    uint32 chain_start_;
+    uint32 chain_blocks_;
+    uint32 chain_blocks_done_;
+    uint32 chain_blocks_transferred_;
+    // the chain sector at which the current command ends
+    uint32 command_end_;
+
+    // set by serviceIRQ with the status register read to acknowledge the interrupt
+    bool irq_pending_;
+    uint8 irq_status_;
+
+    // serializes the requests which are executed without interrupts, and with interrupts
+    // the requests added and the bottom half which advances them
     Mutex lock_;
 };
 
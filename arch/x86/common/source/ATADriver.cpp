@@ -9,6 +9,7 @@
 #include "kprintf.h"
 
 #include "Thread.h"
+#include "SoftIrq.h"
 
 #define TIMEOUT_WARNING() do { kprintfd("%s:%d: timeout. THIS MIGHT CAUSE SERIOUS TROUBLE!\n", __PRETTY_FUNCTION__, __LINE__); } while (0)
 
@@ -20,7 +21,11 @@
                                          BODY;\
                                        }
 
-ATADriver::ATADriver( uint16 baseport, uint16 getdrive, uint16 irqnum ) : lock_("ATADriver::lock_")
+ATADriver::ATADriver( uint16 baseport, uint16 getdrive, uint16 irqnum ) :
+    numsec(0), addressing_(BD_CHS), max_sectors_per_command_(256), multiple_sectors_(1),
+    io_scheduler_(BDManager::getInstance()->getIOSchedulerPolicy(), 256, lock_), active_request_(0), xfer_request_(0),
+    xfer_blocks_(0), chain_cmd_(BDRequest::BD_READ), chain_start_(0), chain_blocks_(0), chain_blocks_done_(0),
+    chain_blocks_transferred_(0), command_end_(0), irq_pending_(false), irq_status_(0), lock_("ATADriver::lock_")
 {
   debug(ATA_DRIVER, "ctor: Entered with irgnum %d and baseport %d!!\n", irqnum, baseport);
 
@@ -48,6 +53,29 @@ ATADriver::ATADriver( uint16 baseport, uint16 getdrive, uint16 irqnum ) : lock_(
   uint32 CYLS = dd[1];
   numsec = CYLS * HPC * SPT;
 
+  if (dd[49] & (1 << 9)) // LBA supported
+  {
+    addressing_ = BD_LBA28;
+    numsec = dd[60] | ((uint32) dd[61] << 16);
+    if (dd[83] & (1 << 10)) // 48 bit address feature set supported
+    {
+      addressing_ = BD_LBA48;
+      max_sectors_per_command_ = 65536;
+      uint64 lba48_sectors = dd[100] | ((uint64) dd[101] << 16) | ((uint64) dd[102] << 32) | ((uint64) dd[103] << 48);
+      numsec = lba48_sectors > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32) lba48_sectors;
+    }
+  }
+  io_scheduler_.setMaxMergedBlocks(max_sectors_per_command_);
+
+  uint32 max_multiple = dd[47] & 0xFF;
+  if (max_multiple > MAX_MULTIPLE_SECTORS)
+    max_multiple = MAX_MULTIPLE_SECTORS;
+  if (max_multiple > 1 && setMultipleMode(max_multiple))
+    multiple_sectors_ = max_multiple;
+
+  debug(ATA_DRIVER, "ctor: addressing: %d, %u sectors, %u sectors per interrupt\n", addressing_, numsec,
+        multiple_sectors_);
+
   bool interrupt_context = ArchInterrupts::disableInterrupts();
   ArchInterrupts::enableInterrupts();
 
@@ -63,13 +91,20 @@ ATADriver::ATADriver( uint16 baseport, uint16 getdrive, uint16 irqnum ) : lock_(
   irq = irqnum;
   debug(ATA_DRIVER, "ctor: mode: %d !!\n", mode );
 
-  request_list_ = 0;
-  request_list_tail_ = 0;
-
   debug(ATA_DRIVER, "ctor: Driver created !!\n");
   return;
 }
 
+bool ATADriver::setMultipleMode( uint32 sectors )
+{
+  TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return false;);
+  outportbp( port + 6, drive );
+  outportbp( port + 2, sectors );
+  outportbp( port + 7, 0xC6 ); // SET MULTIPLE MODE
+  TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return false;);
+  return (inportbp( port + 7 ) & 0x01) == 0;
+}
+
 void ATADriver::testIRQ( )
 {
   mode = BD_PIO;
@@ -90,35 +125,72 @@ int32 ATADriver::rawReadSector ( uint32 start_sector, uint32 num_sectors, void *
   return result;
 }
 
-int32 ATADriver::selectSector(uint32 start_sector, uint32 num_sectors)
+bool ATADriver::needsLBA48( uint32 start_sector, uint32 num_sectors )
 {
-  /* Wait for drive to clear BUSY */
-  TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return -1;);
-
-  //LBA: linear base address of the block
-  //CYL: value of the cylinder CHS coordinate
-  //HPC: number of heads per cylinder for the disk
-  //HEAD: value of the head CHS coordinate
-  //SPT: number of sectors per track for the disk
-  //SECT: value of the sector CHS coordinate
-  //TEMP: buffer to hold a temporary value
-
-  uint32 LBA = start_sector;
-  uint32 cyls = LBA / (HPC * SPT);
-  uint32 TEMP = LBA % (HPC * SPT);
-  uint32 head = TEMP / SPT;
-  uint32 sect = TEMP % SPT + 1;
+  // the 28 bit commands are preferred, as they need only half of the register writes
+  return addressing_ == BD_LBA48 && (num_sectors > 256 || start_sector + num_sectors > 0x0FFFFFFF);
+}
 
-  uint8 high = cyls >> 8;
-  uint8 lo = cyls & 0x00FF;
+uint8 ATADriver::commandFor( BDRequest::BD_CMD cmd, bool lba48, bool multiple )
+{
+  if( cmd == BDRequest::BD_READ )
+    return lba48 ? (multiple ? 0x29 : 0x24) : (multiple ? 0xC4 : 0x20);
+  return lba48 ? (multiple ? 0x39 : 0x34) : (multiple ? 0xC5 : 0x30);
+}
 
-  //debug(ATA_DRIVER, "readSector:(drive | head): %d, num_sectors: %d, sect: %d, lo: %d, high: %d!!\n",(drive | head),num_sectors,sect,lo,high);
+int32 ATADriver::selectSector(uint32 start_sector, uint32 num_sectors, bool lba48)
+{
+  assert(num_sectors > 0 && num_sectors <= max_sectors_per_command_);
+  /* Wait for drive to clear BUSY */
+  TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return -1;);
 
-  outportbp(port + 6, (drive | head)); // drive and head selection
-  outportbp(port + 2, num_sectors); // number of sectors to read
-  outportbp(port + 3, sect); // starting sector
-  outportbp(port + 4, lo); // cylinder low
-  outportbp(port + 5, high); // cylinder high
+  if (lba48)
+  {
+    // the high bytes of the count and the address go first, a count of 0 means 65536 sectors
+    outportbp(port + 6, drive | 0x40);
+    outportbp(port + 2, num_sectors >> 8);
+    outportbp(port + 3, start_sector >> 24);
+    outportbp(port + 4, 0);
+    outportbp(port + 5, 0);
+    outportbp(port + 2, num_sectors);
+    outportbp(port + 3, start_sector);
+    outportbp(port + 4, start_sector >> 8);
+    outportbp(port + 5, start_sector >> 16);
+  }
+  else if (addressing_ != BD_CHS)
+  {
+    // a count of 0 means 256 sectors
+    outportbp(port + 6, drive | 0x40 | ((start_sector >> 24) & 0x0F));
+    outportbp(port + 2, num_sectors);
+    outportbp(port + 3, start_sector);
+    outportbp(port + 4, start_sector >> 8);
+    outportbp(port + 5, start_sector >> 16);
+  }
+  else
+  {
+    //LBA: linear base address of the block
+    //CYL: value of the cylinder CHS coordinate
+    //HPC: number of heads per cylinder for the disk
+    //HEAD: value of the head CHS coordinate
+    //SPT: number of sectors per track for the disk
+    //SECT: value of the sector CHS coordinate
+    //TEMP: buffer to hold a temporary value
+
+    uint32 LBA = start_sector;
+    uint32 cyls = LBA / (HPC * SPT);
+    uint32 TEMP = LBA % (HPC * SPT);
+    uint32 head = TEMP / SPT;
+    uint32 sect = TEMP % SPT + 1;
+
+    uint8 high = cyls >> 8;
+    uint8 lo = cyls & 0x00FF;
+
+    outportbp(port + 6, (drive | head)); // drive and head selection
+    outportbp(port + 2, num_sectors); // number of sectors to read
+    outportbp(port + 3, sect); // starting sector
+    outportbp(port + 4, lo); // cylinder low
+    outportbp(port + 5, high); // cylinder high
+  }
 
   /* Wait for drive to set DRDY */
   TIMEOUT_CHECK((!inportbp(port + 7)) & 0x40,TIMEOUT_WARNING(); return -1;);
@@ -129,13 +201,14 @@ int32 ATADriver::selectSector(uint32 start_sector, uint32 num_sectors)
 int32 ATADriver::readSector ( uint32 start_sector, uint32 num_sectors, void *buffer )
 {
   assert(buffer || (start_sector == 0 && num_sectors == 1));
-  if (selectSector(start_sector, num_sectors) != 0)
+  bool lba48 = needsLBA48(start_sector, num_sectors);
+  if (selectSector(start_sector, num_sectors, lba48) != 0)
     return -1;
 
   for (int i = 0;; ++i)
   {
     /* Write the command code to the command register */
-    outportbp(port + 7, 0x20); // command
+    outportbp(port + 7, commandFor(BDRequest::BD_READ, lba48, false)); // command
 
     if (mode != BD_PIO_NO_IRQ)
       return 0;
@@ -155,12 +228,21 @@ int32 ATADriver::readSector ( uint32 start_sector, uint32 num_sectors, void *buf
       break;
   }
 
-  if (buffer)
+  uint16 *word_buff = (uint16 *) buffer;
+  for (uint32 sector = 0; sector < num_sectors; ++sector)
   {
-    uint32 counter;
-    uint16 *word_buff = (uint16 *) buffer;
-    for (counter = 0; counter != (256*num_sectors); counter++)  // read sector
-        word_buff [counter] = inportw ( port );
+    /* every sector is a DRQ block of its own */
+    if (sector != 0)
+    {
+      TIMEOUT_CHECK(inportbp(port + 7) != 0x58,TIMEOUT_WARNING(); return -1;);
+    }
+
+    if (buffer)
+    {
+      uint32 counter;
+      for (counter = sector * 256; counter != (sector + 1) * 256; counter++)  // read sector
+          word_buff [counter] = inportw ( port );
+    }
   }
   /* Wait for drive to clear BUSY */
   TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return -1;);
@@ -172,30 +254,30 @@ int32 ATADriver::readSector ( uint32 start_sector, uint32 num_sectors, void *buf
 int32 ATADriver::writeSector ( uint32 start_sector, uint32 num_sectors, void * buffer )
 {
   assert(buffer);
-  if (selectSector(start_sector, num_sectors) != 0)
+  bool lba48 = needsLBA48(start_sector, num_sectors);
+  if (selectSector(start_sector, num_sectors, lba48) != 0)
     return -1;
 
   uint16 *word_buff = (uint16 *) buffer;
 
   /* Write the command code to the command register */
-  outportbp( port + 7, 0x30 );           // command
+  outportbp( port + 7, commandFor(BDRequest::BD_WRITE, lba48, false) );           // command
 
-  TIMEOUT_CHECK(inportbp(port + 7) != 0x58,TIMEOUT_WARNING(); return -1;);
-
-
-  uint32 count2 = (256*num_sectors);
-  if( mode != BD_PIO_NO_IRQ )
-    count2 = 256;
+  for (uint32 sector = 0; sector < num_sectors; ++sector)
+  {
+    /* every sector is a DRQ block of its own */
+    TIMEOUT_CHECK(inportbp(port + 7) != 0x58,TIMEOUT_WARNING(); return -1;);
 
-  uint32 counter;
-  for (counter = 0; counter != count2; counter++) 
-      outportw ( port, word_buff [counter] );
+    uint32 counter;
+    for (counter = sector * 256; counter != (sector + 1) * 256; counter++)
+        outportw ( port, word_buff [counter] );
+  }
  
   /* Wait for drive to clear BUSY */
   TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return -1;);
 
   /* Write flush code to the command register */
-  outportbp (port + 7, 0xE7);
+  outportbp (port + 7, lba48 ? 0xEA : 0xE7);
     
   /* Wait for drive to clear BUSY */
   TIMEOUT_CHECK(inportbp(port + 7) & 0x80,TIMEOUT_WARNING(); return -1;);
@@ -205,75 +287,42 @@ int32 ATADriver::writeSector ( uint32 start_sector, uint32 num_sectors, void * b
 
 uint32 ATADriver::addRequest( BDRequest *br )
 {
-  ScopeLock lock(lock_); // this lock might serialize stuff too much...
-  bool interrupt_context = false;
   debug(ATA_DRIVER, "addRequest %d!\n", br->getCmd() );
-  if( mode != BD_PIO_NO_IRQ )
-  {
-    interrupt_context = ArchInterrupts::disableInterrupts();
-
-    //Add request to the list protected by the cli
-    if( request_list_ == 0 )
-      request_list_ = request_list_tail_ = br;
-    else
-    {
-      request_list_tail_->setNextRequest(br) ;
-      request_list_tail_ = br;
-    }
-  }
-
-  int32 res = -1;
-  
-  switch( br->getCmd() )
-  {
-    case BDRequest::BD_READ:
-      res = readSector( br->getStartBlock(), br->getNumBlocks(), br->getBuffer() );
-      break;
-    case BDRequest::BD_WRITE:
-      res = writeSector( br->getStartBlock(), br->getNumBlocks(), br->getBuffer() );
-      break;
-    default:
-      res = -1;
-      break;
-  }
-  
-  if( res != 0 )
+  if( br->getCmd() != BDRequest::BD_READ && br->getCmd() != BDRequest::BD_WRITE )
   {
     br->setStatus( BDRequest::BD_ERROR );
-    debug(ATA_DRIVER, "Got out on error !!\n");
-      if( interrupt_context )
-        ArchInterrupts::enableInterrupts();
     return 0;
   }
-
-  if( mode == BD_PIO_NO_IRQ )
+  if( br->getNumBlocks() == 0 )
   {
-    debug(ATA_DRIVER, "addRequest:No IRQ operation !!\n");
     br->setStatus( BDRequest::BD_DONE );
     return 0;
   }
 
-  if (currentThread)
+  if( mode == BD_PIO_NO_IRQ )
   {
-    if(interrupt_context)
-      ArchInterrupts::enableInterrupts();
-    jiffies = 0;
-    while (br->getStatus() == BDRequest::BD_QUEUED && jiffies++ < IO_TIMEOUT*10);
-    if (jiffies >= IO_TIMEOUT*10)
-      TIMEOUT_WARNING();
-    if (br->getStatus() == BDRequest::BD_QUEUED)
+    debug(ATA_DRIVER, "addRequest:No IRQ operation !!\n");
+    ScopeLock lock(lock_);
+    int32 res = 0;
+    for( uint32 done = 0; res == 0 && done < br->getNumBlocks(); done += max_sectors_per_command_ )
     {
-      ArchInterrupts::disableInterrupts();
-      if (br->getStatus() == BDRequest::BD_QUEUED)
-      {
-        currentThread->setState(Sleeping);
-        ArchInterrupts::enableInterrupts();
-        Scheduler::instance()->yield(); // this is necessary! setting state to sleep and continuing to run is a BAD idea
-      }
-      ArchInterrupts::enableInterrupts();
+      uint32 num_sectors = br->getNumBlocks() - done;
+      if( num_sectors > max_sectors_per_command_ )
+        num_sectors = max_sectors_per_command_;
+      char* buffer = (char*) br->getBuffer() + done * getSectorSize();
+      if( br->getCmd() == BDRequest::BD_READ )
+        res = readSector( br->getStartBlock() + done, num_sectors, buffer );
+      else
+        res = writeSector( br->getStartBlock() + done, num_sectors, buffer );
     }
+    br->setStatus( res == 0 ? BDRequest::BD_DONE : BDRequest::BD_ERROR );
+    return 0;
   }
 
+  ScopeLock lock(lock_);
+  io_scheduler_.add( br );
+  startNextRequest();
+
   return 0;
 }
 
@@ -297,11 +346,105 @@ bool ATADriver::waitForController( bool resetIfFailed = true )
   return true;
 }
 
-void ATADriver::nextRequest(BDRequest* br)
+uint16 *ATADriver::nextSector()
+{
+  // the cursor moves on right away, so it never points to a request which is already completed
+  uint16* word_buff = (uint16*) xfer_request_->getBuffer() + xfer_blocks_ * 256;
+  if( ++xfer_blocks_ == xfer_request_->getNumBlocks() )
+  {
+    xfer_request_ = xfer_request_->getMergeNext();
+    xfer_blocks_ = 0;
+  }
+  return word_buff;
+}
+
+uint32 ATADriver::transferBlock()
+{
+  uint32 num_sectors = command_end_ - chain_blocks_transferred_;
+  if( num_sectors > multiple_sectors_ )
+    num_sectors = multiple_sectors_;
+  for( uint32 sector = 0; sector < num_sectors; ++sector )
+  {
+    uint16* word_buff = nextSector();
+    if( chain_cmd_ == BDRequest::BD_READ )
+      for( uint32 counter = 0; counter != 256; counter++ )
+        word_buff [counter] = inportw ( port );
+    else
+      for( uint32 counter = 0; counter != 256; counter++ )
+        outportw ( port, word_buff [counter] );
+  }
+  chain_blocks_transferred_ += num_sectors;
+  return num_sectors;
+}
+
+int32 ATADriver::startTransfer()
+{
+  uint32 num_sectors = chain_blocks_ - chain_blocks_done_;
+  if( num_sectors > max_sectors_per_command_ )
+    num_sectors = max_sectors_per_command_;
+  command_end_ = chain_blocks_done_ + num_sectors;
+  bool lba48 = needsLBA48( chain_start_ + chain_blocks_done_, num_sectors );
+  if( selectSector( chain_start_ + chain_blocks_done_, num_sectors, lba48 ) != 0 )
+    return -1;
+
+  outportbp( port + 7, commandFor( chain_cmd_, lba48, multiple_sectors_ > 1 ) );
+  if( chain_cmd_ == BDRequest::BD_READ )
+    return 0;
+
+  // the following blocks are written by serviceIRQ when the drive asks for them
+  TIMEOUT_CHECK(inportbp(port + 7) != 0x58,TIMEOUT_WARNING(); return -1;);
+  transferBlock();
+  return 0;
+}
+
+void ATADriver::startNextRequest()
+{
+  while( active_request_ == 0 && (active_request_ = io_scheduler_.next()) )
+  {
+    chain_cmd_ = active_request_->getCmd();
+    chain_start_ = active_request_->getStartBlock();
+    chain_blocks_ = active_request_->getMergedBlocks();
+    chain_blocks_done_ = 0;
+    chain_blocks_transferred_ = 0;
+    xfer_request_ = active_request_;
+    xfer_blocks_ = 0;
+    if( startTransfer() != 0 )
+      failActiveRequests();
+  }
+}
+
+void ATADriver::sectorDone()
+{
+  assert(chain_blocks_done_ < chain_blocks_transferred_);
+  active_request_->setBlocksDone( active_request_->getBlocksDone() + 1 );
+  ++chain_blocks_done_;
+  if( active_request_->getBlocksDone() == active_request_->getNumBlocks() )
+  {
+    BDRequest* next = active_request_->getMergeNext();
+    finishRequest( active_request_, BDRequest::BD_DONE );
+    active_request_ = next;
+  }
+}
+
+void ATADriver::failActiveRequests()
+{
+  while( active_request_ )
+  {
+    BDRequest* next = active_request_->getMergeNext();
+    finishRequest( active_request_, BDRequest::BD_ERROR );
+    active_request_ = next;
+  }
+  xfer_request_ = 0;
+}
+
+void ATADriver::finishRequest( BDRequest *br, BDRequest::BD_RESULT status )
 {
-  if(br->getThread())
-    br->getThread()->setState(Running);
-  request_list_ = br->getNextRequest();
+  // the request may be gone as soon as its status is set, if the submitter is polling
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  br->getWaitQueue()->wakeAll();
+  br->setStatus( status );
+  if( interrupts_enabled )
+    ArchInterrupts::enableInterrupts();
 }
 
 void ATADriver::serviceIRQ()
@@ -309,7 +452,7 @@ void ATADriver::serviceIRQ()
   if( mode == BD_PIO_NO_IRQ )
     return;
 
-  if( request_list_ == 0 )
+  if( active_request_ == 0 )
   {
     debug(ATA_DRIVER, "serviceIRQ: IRQ without request!!\n");
     outportbp( port + 0x206, 0x04 );
@@ -318,65 +461,70 @@ void ATADriver::serviceIRQ()
     return; // not my interrupt
   }
 
-  BDRequest* br = request_list_;
   debug(ATA_DRIVER, "serviceIRQ: Found active request!!\n");
 
-  uint16* word_buff = (uint16*) br->getBuffer();
-  uint32 counter;
-  uint32 blocks_done = br->getBlocksDone();
+  // reading the status register also acknowledges the interrupt, the drive does not
+  // interrupt again before the bottom half has moved the data
+  irq_status_ = inportbp( port + 7 );
+  irq_pending_ = true;
+  SoftIrq::raise( SoftIrq::BLOCK_DEVICE );
+}
+
+void ATADriver::serviceDeferredIRQ()
+{
+  ScopeLock lock(lock_);
+  if( !irq_pending_ )
+    return;
+  irq_pending_ = false;
+
+  if( irq_status_ & 0x01 )
+  {
+    debug(ATA_DRIVER, "serviceDeferredIRQ: drive reported an error!!\n");
+    failActiveRequests();
+    startNextRequest();
+    return;
+  }
 
-  if( br->getCmd() == BDRequest::BD_READ )
+  if( chain_cmd_ == BDRequest::BD_READ )
   {
     if( !waitForController() )
     {
-      br->setStatus( BDRequest::BD_ERROR );
-      nextRequest(br);
+      failActiveRequests();
+      startNextRequest();
       return;
     }
+    transferBlock();
+  }
 
-    for(counter = blocks_done * 256; counter!=(blocks_done + 1) * 256; counter++ )
-      word_buff [counter] = inportw ( port );
-
-    blocks_done++;
-    br->setBlocksDone( blocks_done );
+  // for a read the block has just been read, for a write the interrupt acknowledges the block written before
+  while( chain_blocks_done_ < chain_blocks_transferred_ )
+    sectorDone();
 
-    if( blocks_done == br->getNumBlocks() )
-    {
-      br->setStatus( BDRequest::BD_DONE );
-      nextRequest(br);
-    }
+  if( chain_blocks_done_ == chain_blocks_ )
+  {
+    debug(ATA_DRIVER, "serviceDeferredIRQ:All done!!\n");
+    assert(active_request_ == 0);
+    startNextRequest();
   }
-  else if( br->getCmd() == BDRequest::BD_WRITE )
+  else if( chain_blocks_done_ == command_end_ )
   {
-    blocks_done++;
-    if( blocks_done == br->getNumBlocks() )
-    {
-      debug(ATA_DRIVER, "serviceIRQ:All done!!\n");
-      br->setStatus( BDRequest::BD_DONE );
-      debug(ATA_DRIVER, "serviceIRQ:Waking up thread!!\n");
-      nextRequest(br);
-    }
-    else
+    // the current command is complete, the rest of the chain needs a new one
+    if( startTransfer() != 0 )
     {
-      if( !waitForController() )
-      {
-        br->setStatus( BDRequest::BD_ERROR );
-        nextRequest(br);
-        return;
-      }
-  
-      for(counter = blocks_done*256; counter != (blocks_done + 1) * 256; counter++ )
-        outportw ( port, word_buff [counter] );
-
-      br->setBlocksDone( blocks_done );
+      failActiveRequests();
+      startNextRequest();
     }
   }
-  else
+  else if( chain_cmd_ == BDRequest::BD_WRITE )
   {
-    blocks_done = br->getNumBlocks();
-    br->setStatus( BDRequest::BD_ERROR );
-    nextRequest(br);
+    if( !waitForController() )
+    {
+      failActiveRequests();
+      startNextRequest();
+      return;
+    }
+    transferBlock();
   }
 
-  debug(ATA_DRIVER, "serviceIRQ:Request handled!!\n");
+  debug(ATA_DRIVER, "serviceDeferredIRQ:Request handled!!\n");
 }
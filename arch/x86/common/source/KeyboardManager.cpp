@@ -2,6 +2,7 @@
 #include "kprintf.h"
 #include "Console.h"
 #include "ports.h"
+#include "SoftIrq.h"
 
 uint32 const KeyboardManager::STANDARD_KEYMAP[KEY_MAPPING_SIZE] = STANDARD_KEYMAP_DEF;
 
@@ -9,10 +10,16 @@ uint32 const KeyboardManager::E0_KEYS[KEY_MAPPING_SIZE] = E0_KEYS_DEF;
 
 KeyboardManager *KeyboardManager::instance_ = 0;
 
+static void keyboardBottomHalf()
+{
+  KeyboardManager::instance()->serviceDeferredIRQ();
+}
+
 KeyboardManager::KeyboardManager() :
-    keyboard_buffer_(256), extended_scancode(0), keyboard_status_(0)
+    keyboard_buffer_(256), scancode_buffer_(256), extended_scancode(0), keyboard_status_(0)
 {
   emptyKbdBuffer();
+  SoftIrq::setHandler(SoftIrq::KEYBOARD, "keyboard", &keyboardBottomHalf);
 }
 
 KeyboardManager::~KeyboardManager()
@@ -42,17 +49,25 @@ void KeyboardManager::send_cmd(uint8 cmd, uint8 port)
 
 void KeyboardManager::serviceIRQ(void)
 {
-  send_cmd(0xAD); // disable the keyboard
-  kb_wait();
+  // reading the scancode acknowledges the interrupt, it is decoded by the bottom half
+  scancode_buffer_.put(inportb(0x60));
+  SoftIrq::raise(SoftIrq::KEYBOARD);
+}
 
-  uint8 scancode = inportb(0x60);
+void KeyboardManager::serviceDeferredIRQ()
+{
+  uint8 scancode;
+  while (scancode_buffer_.get(scancode))
+    processScancode(scancode);
+}
 
+void KeyboardManager::processScancode(uint8 scancode)
+{
   if (extended_scancode == 0xE0)
   {
     if ((scancode == 0x2A || scancode == 0x36 || scancode >= E0_BASE) && !(scancode & KEY_MAPPING_SIZE))
     {
       extended_scancode = 0;
-      send_cmd(0xAE); // enable the keyboard
       return;
     }
 
@@ -64,7 +79,6 @@ void KeyboardManager::serviceIRQ(void)
   else if (extended_scancode == 0xE1 && scancode == 0x1D)
   {
     extended_scancode = 0x100;
-    send_cmd(0xAE); // enable the keyboard
     return;
   }
   else if (extended_scancode == 0x100 && scancode == 0x45)
@@ -75,14 +89,12 @@ void KeyboardManager::serviceIRQ(void)
   if (scancode == 0xFF || scancode == 0xFA || scancode == 0xFE || scancode == 0x00) // non parsable codes, ACK and keyb. buffer errors
   {
     debug(A_KB_MANAGER, "Non-parsable scancode %X \n", scancode);
-    send_cmd(0xAE); // enable the keyboard
     return;
   }
 
   if (scancode == 0xE0 || scancode == 0xE1)
   {
     extended_scancode = scancode;
-    send_cmd(0xAE); // enable the keyboard
     return;
   }
 
@@ -90,17 +102,16 @@ void KeyboardManager::serviceIRQ(void)
   //setLEDs(); // setting the leds
 
   if ((scancode & 0200)) // if a key was released just ignore it
-  {
-    send_cmd(0xAE); // enable the keyboard
     return;
-  }
 
   if (main_console)
   {
     keyboard_buffer_.put(scancode); // put it inside the buffer
+    bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+    key_waiters_.wakeAll();
+    if (interrupts_enabled)
+      ArchInterrupts::enableInterrupts();
   }
-
-  send_cmd(0xAE); // enable the keyboard
 }
 
 void KeyboardManager::modifyKeyboardStatus(uint8 sc)
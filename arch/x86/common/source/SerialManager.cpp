@@ -5,11 +5,18 @@
 #include "debug_bochs.h"
 #include "kprintf.h"
 #include "8259.h"
+#include "SoftIrq.h"
 
 SerialManager * SerialManager::instance_ = 0;
 
+static void serialBottomHalf()
+{
+  SerialManager::getInstance()->serviceDeferredIRQ();
+}
+
 SerialManager::SerialManager() : num_ports( 0 )
 {
+  SoftIrq::setHandler( SoftIrq::SERIAL, "serial", &serialBottomHalf );
 }
 
 SerialManager::~SerialManager()
@@ -55,3 +62,9 @@ void SerialManager::service_irq( uint32 irq_num )
     if( serial_ports[ i ]->get_info().irq_num == irq_num )
       serial_ports[ i ]->irq_handler();
 }
+
+void SerialManager::serviceDeferredIRQ()
+{
+  for(size_t i = 0;i < num_ports; i++)
+    serial_ports[ i ]->serviceDeferredIRQ();
+}
@@ -6,6 +6,7 @@
 #include "ArchThreads.h"
 #include "kprintf.h"
 #include "8259.h"
+#include "SoftIrq.h"
 
 
 SerialPort::SerialPort ( char *name, ArchSerialInfo port_info ) : CharacterDevice( name )
@@ -164,7 +165,8 @@ void SerialPort::irq_handler()
     break;
   case 2: // Data is available
     int_id = read_UART( 0 );
-    in_buffer_.put( int_id );
+    received_.put( int_id );
+    SoftIrq::raise( SoftIrq::SERIAL );
     break;
   case 3: // Line status changed
     break;
@@ -175,6 +177,13 @@ void SerialPort::irq_handler()
   return;
 }
 
+void SerialPort::serviceDeferredIRQ()
+{
+  uint8 data;
+  while( received_.get( data ) )
+    in_buffer_.put( data );
+}
+
 void SerialPort::write_UART( uint32 reg, uint8 what )
 {
    outportb( this->port_info_.base_port + reg, what );
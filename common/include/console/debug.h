@@ -33,6 +33,8 @@ enum AnsiColor
 //group Block Device
 const size_t BD_MANAGER         = Ansi_Yellow;
 const size_t BD_VIRT_DEVICE     = Ansi_Yellow;
+const size_t BLOCK_CACHE        = Ansi_Yellow;
+const size_t IO_SCHEDULER       = Ansi_Yellow;
 
 //group Console
 const size_t KPRINTF            = Ansi_Yellow;
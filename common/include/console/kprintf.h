@@ -25,7 +25,7 @@ void kprintf(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
  */
 void kprintfd(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 /**
- * Initializes the nosleep functionality and starts the flushing thread.
+ * Initializes the nosleep functionality, the buffer is flushed by a job of the system work queue.
  */
 void kprintf_init();
 
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <ulist.h>
+#include "IOScheduler.h"
 
 class BDRequest;
 class BDVirtualDevice;
+class BDDriver;
 
 class BDManager
 {
@@ -61,6 +63,29 @@ class BDManager
      */
     void serviceIRQ(uint32 irq_num);
 
+    /**
+     * calls serviceDeferredIRQ on all devices, the bottom half of the block device interrupts
+     */
+    void serviceDeferredIRQ();
+
+    /**
+     * @return the policy new drivers start their io scheduler with
+     */
+    IOScheduler::POLICY getIOSchedulerPolicy() const
+    {
+      return io_scheduler_policy_;
+    }
+
+    /**
+     * switches the io schedulers of all drivers and of drivers detected later to the policy
+     */
+    void setIOSchedulerPolicy(IOScheduler::POLICY policy);
+
+    /**
+     * prints the statistics of the io scheduler of every driver
+     */
+    void printStatistics();
+
     /**
      * gets false when the irq is serviced
      */
@@ -70,6 +95,13 @@ class BDManager
 
   protected:
     static BDManager *instance_;
+
+    IOScheduler::POLICY io_scheduler_policy_;
+
+    /**
+     * @return the first device of the driver, for the partitions of a disk that is the whole disk
+     */
+    BDVirtualDevice *getFirstDeviceOfDriver(BDDriver *driver);
 };
 
 
@@ -7,9 +7,6 @@
 class BDDriver;
 class BDRequest;
 
-class BDDriver;
-class BDRequest;
-
 class BDVirtualDevice
 {
   public:
@@ -43,6 +40,31 @@ class BDVirtualDevice
       return num_sectors_ / (block_size_ / sector_size_);
     }
 
+    /**
+     * queues a read of whole blocks without waiting for it, so several requests can be in flight at once
+     * @param offset where to start to read
+     * @param size number of bytes that should be read
+     * @param buffer to save the data that has been read, it has to stay valid until the request is done
+     * @return the request, which has to be passed to waitForRequest
+     */
+    BDRequest *submitRead(uint32 offset, uint32 size, char *buffer);
+
+    /**
+     * queues a write of whole blocks without waiting for it, so several requests can be in flight at once
+     * @param offset where to start to write
+     * @param size number of bytes that should be written
+     * @param buffer data that should be written, it has to stay valid until the request is done
+     * @return the request, which has to be passed to waitForRequest
+     */
+    BDRequest *submitWrite(uint32 offset, uint32 size, char *buffer);
+
+    /**
+     * sleeps until the driver has completed the request and releases it
+     * @param request a request returned by submitRead or submitWrite
+     * @return the number of bytes transferred or -1 on error
+     */
+    int32 waitForRequest(BDRequest *request);
+
     /**
      * reads the data from the inode on the current device
      * @param offset where to start to read
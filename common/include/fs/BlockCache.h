@@ -0,0 +1,201 @@
+#pragma once
+
+#include "types.h"
+#include "Mutex.h"
+#include "Condition.h"
+
+class BDVirtualDevice;
+class BDRequest;
+class Thread;
+
+/**
+ * One cached block of a device
+ */
+class BlockCacheEntry
+{
+  public:
+    BDVirtualDevice* device_;
+    uint32 block_;
+    uint32 size_;
+    char* data_;
+    bool valid_;
+    bool dirty_;
+
+    /**
+     * the block is read from or written to the device without the lock of the cache.
+     * An entry which is not valid yet is being filled, it must not be used until that is done.
+     * The data of a valid one is being written back, it can be read and written, but not evicted.
+     */
+    bool busy_;
+
+    /**
+     * the value of BlockCache::write_generation_ when the data was changed last, a write back only
+     * makes the entry clean if it did not change in the meantime
+     */
+    size_t generation_;
+
+    BlockCacheEntry* hash_next_;
+    BlockCacheEntry* lru_prev_;
+    BlockCacheEntry* lru_next_;
+};
+
+/**
+ * Write-back cache for the blocks of all block devices, keyed by (device, block).
+ * Blocks are found through a hash index and evicted in LRU order. Dirty blocks
+ * are written back by a background thread, on eviction, or when flush is called.
+ * The lock is never held while the device is accessed: entries are marked busy
+ * instead, and the block ranges of readBlocks and writeBlocks are pinned, so blocks
+ * are not filled, written back or evicted while such a request is in flight.
+ */
+class BlockCache
+{
+  public:
+    static BlockCache* instance();
+
+    /**
+     * copies bytes of one block into the buffer, reading the block from the device on a miss
+     * @param device the device
+     * @param block the block number in units of the device's block size
+     * @param offset the offset inside the block
+     * @param size the number of bytes, offset + size must not exceed the block size
+     * @param buffer the buffer to copy the bytes to
+     */
+    void read(BDVirtualDevice* device, uint32 block, uint32 offset, uint32 size, char* buffer);
+
+    /**
+     * copies bytes into one cached block and marks it dirty, the device is written later
+     * @param device the device
+     * @param block the block number in units of the device's block size
+     * @param offset the offset inside the block
+     * @param size the number of bytes, offset + size must not exceed the block size
+     * @param buffer the bytes to write
+     */
+    void write(BDVirtualDevice* device, uint32 block, uint32 offset, uint32 size, const char* buffer);
+
+    /**
+     * reads a range of blocks with a single device request, bypassing the cache.
+     * Blocks which are cached are copied from the cache afterwards, as they may be newer than the device.
+     * @param device the device
+     * @param block the first block number in units of the device's block size
+     * @param num_blocks the number of blocks
+     * @param buffer the buffer for the data of all blocks
+     * @return the return value of BDVirtualDevice::readData
+     */
+    int32 readBlocks(BDVirtualDevice* device, uint32 block, uint32 num_blocks, char* buffer);
+
+    /**
+     * writes a range of blocks with a single device request, bypassing the cache.
+     * Cached copies of the blocks are updated, so they stay coherent with the device.
+     * @param device the device
+     * @param block the first block number in units of the device's block size
+     * @param num_blocks the number of blocks
+     * @param buffer the data of all blocks
+     * @return the return value of BDVirtualDevice::writeData
+     */
+    int32 writeBlocks(BDVirtualDevice* device, uint32 block, uint32 num_blocks, const char* buffer);
+
+    /**
+     * writes all dirty blocks of a device back
+     * @param device the device or 0 for all devices
+     */
+    void flush(BDVirtualDevice* device);
+
+    void printStatistics();
+
+    static const size_t NUM_ENTRIES = 128;
+    static const size_t NUM_HASH_BUCKETS = 64;
+
+    /**
+     * ticks between two runs of the writeback thread
+     */
+    static const size_t WRITEBACK_INTERVAL = 20;
+
+    /**
+     * number of write requests flush queues at the driver before it waits for them
+     */
+    static const size_t FLUSH_BATCH_SIZE = 16;
+
+  private:
+    BlockCache();
+
+    size_t hash(BDVirtualDevice* device, uint32 block);
+
+    /**
+     * @return the entry caching the block, filled from the device if fill is set, locked by lock_
+     */
+    BlockCacheEntry* getEntry(BDVirtualDevice* device, uint32 block, bool fill);
+    BlockCacheEntry* lookup(BDVirtualDevice* device, uint32 block);
+
+    /**
+     * @return the least recently used entry which is neither busy nor pinned, 0 if there is none
+     */
+    BlockCacheEntry* findVictim();
+
+    /**
+     * writes the entry back with lock_ dropped
+     * @return false if the device reported an error
+     */
+    bool writeBackEntry(BlockCacheEntry* entry);
+
+    /**
+     * marks the entry clean if the write succeeded and the entry did not change since, and wakes up the waiters
+     */
+    void finishWriteBack(BlockCacheEntry* entry, size_t generation, bool success);
+
+    /**
+     * A range of blocks read or written by readBlocks or writeBlocks without the lock. It lives on the stack
+     * of the caller while it is in the list of pinned ranges.
+     */
+    struct PinnedRange
+    {
+      BDVirtualDevice* device_;
+      uint32 block_;
+      uint32 num_blocks_;
+      bool write_;
+      PinnedRange* next_;
+    };
+
+    /**
+     * @param writes_only only ranges pinned by writeBlocks count
+     * @return true if a pinned range overlaps the blocks
+     */
+    bool isPinned(BDVirtualDevice* device, uint32 block, uint32 num_blocks, bool writes_only);
+
+    /**
+     * @return true if a cached block of the range is busy
+     */
+    bool isBusy(BDVirtualDevice* device, uint32 block, uint32 num_blocks);
+    void pin(PinnedRange* range);
+    void unpin(PinnedRange* range);
+
+    void hashRemove(BlockCacheEntry* entry);
+    void lruRemove(BlockCacheEntry* entry);
+    void lruPushFront(BlockCacheEntry* entry);
+
+    static BlockCache* instance_;
+
+    Mutex lock_;
+
+    /**
+     * signalled whenever a busy entry is done or a range is unpinned
+     */
+    Condition io_done_;
+
+    BlockCacheEntry entries_[NUM_ENTRIES];
+    BlockCacheEntry* hash_buckets_[NUM_HASH_BUCKETS];
+    BlockCacheEntry* lru_head_;
+    BlockCacheEntry* lru_tail_;
+    PinnedRange* pinned_;
+
+    /**
+     * counts the changes of cached data, see BlockCacheEntry::generation_
+     */
+    size_t write_generation_;
+
+    size_t hits_;
+    size_t misses_;
+    size_t writebacks_;
+    size_t evictions_;
+
+    Thread* writeback_thread_;
+};
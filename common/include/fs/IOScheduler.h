@@ -0,0 +1,114 @@
+#pragma once
+
+#include "types.h"
+
+class BDRequest;
+class Mutex;
+
+/**
+ * Holds the read and write requests of a block device driver which have not been started yet.
+ * Requests for adjacent sectors in the same direction are merged into chains, the driver
+ * transfers a whole chain with a single command. The scheduler is protected by the lock of
+ * its driver: add and next have to be called with it held, setPolicy takes it itself.
+ */
+class IOScheduler
+{
+  public:
+    typedef enum POLICY_
+    {
+      /**
+       * requests are started in the order they were added
+       */
+      NOOP,
+      /**
+       * requests are started in ascending sector order, reads are preferred over writes,
+       * but no request waits longer than its deadline
+       */
+      DEADLINE
+    } POLICY;
+
+    /**
+     * @param policy the initial policy
+     * @param max_merged_blocks the maximum number of sectors of a merge chain
+     * @param lock the lock of the driver, which is held while requests are added and started
+     */
+    IOScheduler(POLICY policy, uint32 max_merged_blocks, Mutex& lock);
+
+    POLICY getPolicy() const
+    {
+      return policy_;
+    }
+
+    /**
+     * @param max_merged_blocks the maximum number of sectors of a merge chain created from now on
+     */
+    void setMaxMergedBlocks(uint32 max_merged_blocks)
+    {
+      max_merged_blocks_ = max_merged_blocks;
+    }
+
+    /**
+     * changes the policy, the pending requests are kept
+     */
+    void setPolicy(POLICY policy);
+
+    /**
+     * adds a read or write request, it is merged into a pending chain if it is adjacent to it
+     * @param request the request, its start block has to be an absolute sector number
+     */
+    void add(BDRequest* request);
+
+    /**
+     * removes the chain which should be started next from the pending requests
+     * @return the head of the chain or 0 if there is no pending request
+     */
+    BDRequest* next();
+
+    /**
+     * @param name the name of the device the scheduler belongs to
+     */
+    void printStatistics(const char* name);
+
+    static const char* getPolicyName(POLICY policy);
+
+    /**
+     * ticks a read or write may be overtaken by requests at higher sectors before it is started anyway
+     */
+    static const uint32 READ_EXPIRE = 10;
+    static const uint32 WRITE_EXPIRE = 90;
+
+    /**
+     * number of times pending writes may be passed over in favour of reads
+     */
+    static const uint32 WRITES_STARVED = 2;
+
+  private:
+    enum
+    {
+      READ_LIST, WRITE_LIST, NUM_LISTS
+    };
+
+    size_t listOf(BDRequest* request);
+    bool tryMerge(BDRequest* request);
+    void insert(BDRequest* chain);
+    void remove(BDRequest* chain);
+    BDRequest* oldest(size_t list);
+
+    POLICY policy_;
+    uint32 max_merged_blocks_;
+    Mutex& lock_;
+
+    // with the deadline policy the lists are sorted by sector, the noop policy only uses the first list in FIFO order
+    BDRequest* heads_[NUM_LISTS];
+    BDRequest* tails_[NUM_LISTS];
+
+    uint32 next_sector_;
+    uint32 writes_starved_;
+
+    size_t num_requests_;
+    size_t num_merges_;
+    size_t num_dispatches_;
+    size_t depth_;
+    size_t max_depth_;
+    size_t depth_sum_;
+};
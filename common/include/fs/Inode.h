@@ -79,6 +79,13 @@ class Inode
      * The inodes permission flag
      */
     uint32 i_mode_;
+
+    /**
+     * the number of pages of this inode in the PageCache, protected by its lock
+     */
+    size_t i_cached_pages_;
+
+    friend class PageCache;
   public:
 
     /**
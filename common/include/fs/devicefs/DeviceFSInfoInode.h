@@ -0,0 +1,40 @@
+#pragma once
+
+#include "types.h"
+#include "fs/ramfs/RamFSInode.h"
+#include "Mutex.h"
+
+/**
+ * A read-only file in devicefs which shows kernel statistics.
+ * The content is generated when the file is read from the start, later reads continue on this snapshot.
+ */
+class DeviceFSInfoInode : public RamFSInode
+{
+  public:
+    /**
+     * writes the content of the file to buffer and returns its length, at most size bytes
+     */
+    typedef size_t (*Generator)(char* buffer, size_t size);
+
+    /**
+     * helper for generators, appends formatted text to the buffer and advances it
+     * the text is cut off if the buffer is full
+     */
+    static void append(char*& buffer, size_t& remaining, const char* format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+    /**
+     * @param super_block the devicefs superblock
+     * @param generator the function generating the content
+     * @param max_size the maximum size of the content
+     */
+    DeviceFSInfoInode(Superblock* super_block, Generator generator, size_t max_size);
+
+    virtual int32 readData(uint32 offset, uint32 size, char *buffer);
+    virtual int32 writeData(uint32 offset, uint32 size, const char *buffer);
+
+  private:
+    Generator generator_;
+    size_t max_size_;
+    Mutex lock_;
+};
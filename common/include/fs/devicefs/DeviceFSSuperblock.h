@@ -23,6 +23,13 @@ class DeviceFSSuperBlock : public RamFSSuperblock
      */
     void addDevice(Inode* inode, const char* node_name);
 
+    /**
+     * adds a read-only file showing kernel statistics
+     * @param inode the inode of the file, a DeviceFSInfoInode
+     * @param node_name the file name
+     */
+    void addInfoFile(Inode* inode, const char* node_name);
+
     /**
      * Access method to the singleton instance
      */
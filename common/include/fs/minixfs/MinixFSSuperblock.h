@@ -98,6 +98,7 @@ class MinixFSSuperblock : public Superblock
 
     /**
      * reads the given number of blocks from the file system to the given buffer
+     * a single block is read through the block cache, more blocks are read with one device request
      * @param block the index of the block to start reading
      * @param num_blocks the number of blcoks to read
      * @param buffer the buffer to write in
@@ -113,11 +114,12 @@ class MinixFSSuperblock : public Superblock
 
     /**
      * writes the given number of blcoks to the file system from the given buffer
+     * a single block is written to the block cache, more blocks are written with one device request
      * @param block the index of the first block to write
      * @param num_blocks the number of blocks to write
      * @param buffer the buffer to write
      */
-    void writeBlocks(uint16 block, uint32 num_blocks, char *buffer);
+    void writeBlocks(uint16 block, uint32 num_blocks, const char *buffer);
 
     /**
      * writes the given number of bytes to the filesystem
@@ -1,13 +0,0 @@
-#pragma once
-
-#include "Thread.h"
-
-class CleanupThread : public Thread
-{
-  public:
-    CleanupThread();
-    virtual ~CleanupThread();
-    virtual void kill();
-    virtual void Run();
-};
-
@@ -9,11 +9,21 @@
 #include <uvector.h>
 
 class Stabs2DebugInfo;
+class Inode;
 
 class Loader
 {
   public:
     Loader(ssize_t fd);
+
+    /**
+     * creates the loader of a forked process, it takes over the headers of the parent's binary,
+     * the address space stays empty until the parent's one is forked into it
+     * @param parent the loader of the parent process
+     * @param fd the forked process's own fd of the binary
+     */
+    Loader(const Loader& parent, ssize_t fd);
+
     ~Loader();
 
     /**
@@ -25,11 +35,18 @@ class Loader
     bool loadExecutableAndInitProcess();
 
     /**
-     * loads one page by its virtual address: gets a free page, copies the page, maps it
+     * loads the page of the virtual address: gets a free page, copies the page, maps it.
+     * Up to MAX_FAULT_AROUND_PAGES following pages of the same segment are loaded along (fault-around),
+     * the more the closer the faults follow each other through the binary.
+     * Pages of read-only segments are mapped read-only from the PageCache, so all processes running
+     * the binary share them.
      * @param virtual_address virtual address where to find the page to load
      */
     void loadPage(pointer virtual_address);
 
+    static const size_t MIN_FAULT_AROUND_PAGES = 2;
+    static const size_t MAX_FAULT_AROUND_PAGES = 16;
+
     Stabs2DebugInfo const* getDebugInfos() const;
 
     void* getEntryFunction() const;
@@ -57,6 +74,48 @@ class Loader
 
     bool readFromBinary (char* buffer, l_off_t position, size_t length);
 
+    /**
+     * @return the segment which intersects the page and extends furthest behind it, 0 if none does
+     */
+    const Elf::Phdr* findSegment(pointer page);
+
+    /**
+     * @return true if the page lies within the memory of the segment completely
+     */
+    static bool pageInSegment(pointer page, const Elf::Phdr& segment);
+
+    /**
+     * adapts the fault-around window to the distance from the last one and clips it to the
+     * pages behind the given one which lie within the segment and are not mapped yet
+     * @return the number of pages to load, at least 1
+     */
+    size_t faultAroundPages(pointer page, const Elf::Phdr& segment);
+
+    /**
+     * copies the parts of all segments intersecting the page into the page frame
+     * @return false if the binary could not be read
+     */
+    bool loadMixedPage(pointer page, size_t ppn);
+
+    /**
+     * copies consecutive pages which lie within the segment into consecutive page frames with a single read
+     * @return false if the binary could not be read
+     */
+    bool loadSegmentPages(const Elf::Phdr& segment, pointer first_page, size_t num_pages, size_t first_ppn);
+
+
+    /**
+     * @return true if the page may be mapped from the PageCache: it belongs to a read-only segment only
+     * and holds nothing but the bytes of the file at the same offset in every process
+     */
+    bool pageShareable(pointer page, const Elf::Phdr& segment);
+
+    /**
+     * maps up to max_pages shareable pages of the segment read-only from the PageCache,
+     * reading the pages which are not cached yet from the binary
+     * @return false if the binary could not be read
+     */
+    bool loadSharedPages(const Elf::Phdr& segment, pointer first_page, size_t max_pages);
 
     size_t fd_;
     Elf::Ehdr *hdr_;
@@ -65,5 +124,17 @@ class Loader
 
     Stabs2DebugInfo *userspace_debug_info_;
 
+    /**
+     * the inode of the binary, the key of its pages in the PageCache
+     */
+    Inode* inode_;
+
+    // the fault-around state, protected by program_binary_lock_
+    size_t fault_around_pages_;
+    pointer last_window_end_;
+    size_t num_faults_;
+    size_t num_pages_loaded_;
+    size_t num_pages_shared_;
+
 };
 
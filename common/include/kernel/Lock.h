@@ -1,6 +1,9 @@
 #pragma once
 
 #include "types.h"
+#include "WaitQueue.h"
+#include "LockProfiler.h"
+#include "ArchCommon.h"
 
 class Thread;
 
@@ -38,6 +41,12 @@ public:
    */
   static void printHoldingList(Thread* thread);
 
+  /**
+   * @return the highest effective priority of the threads waiting on the locks held by the thread, 0 if there are none
+   * Interrupts have to be disabled, so the lists cannot change meanwhile.
+   */
+  static size_t highestWaiterPriority(Thread* thread);
+
   Thread* heldBy() const
   {
     return held_by_;
@@ -76,6 +85,39 @@ protected:
    */
   pointer last_accessed_at_;
 
+  /**
+   * The LockProfiler timestamp of the acquire and its call site, 0 if the acquire was not profiled.
+   */
+  uint64 profile_acquired_at_;
+  pointer profile_called_by_;
+
+  /**
+   * @return the timestamp an acquire starts waiting at, if the LockProfiler is enabled
+   */
+  inline uint64 profileWaitStart() const
+  {
+    return unlikely(LockProfiler::isEnabled()) ? ArchCommon::getTimestamp() : 0;
+  }
+
+  /**
+   * Pass the acquire to the LockProfiler, has to be called while holding the lock.
+   * @param wait_start the result of profileWaitStart() before the lock was tried first
+   */
+  inline void profileAcquired(pointer called_by, bool contended, uint64 wait_start)
+  {
+    if(unlikely(LockProfiler::isEnabled()))
+      recordAcquired(called_by, contended, wait_start);
+  }
+
+  /**
+   * Pass the hold time to the LockProfiler, has to be called before the lock is released.
+   */
+  inline void profileRelease()
+  {
+    if(unlikely(profile_acquired_at_ != 0))
+      recordRelease();
+  }
+
   /**
    * Remove the current thread from the holding list.
    */
@@ -83,7 +125,7 @@ protected:
 
   inline bool threadsAreOnWaitersList() const
   {
-    return waiters_list_;
+    return !waiters_.empty();
   }
 
   /**
@@ -129,11 +171,12 @@ protected:
   /**
    * Lock the waiters list, so it may be modified.
    * The lock may not be held in case the list is read out in some special cases.
+   * Interrupts are disabled while the list is locked, so its holder cannot be preempted.
    */
   void lockWaitersList();
 
   /**
-   * unlock the waiters list.
+   * unlock the waiters list and restore the interrupt state of lockWaitersList.
    */
   void unlockWaitersList();
 
@@ -149,16 +192,9 @@ protected:
   }
 
   /**
-   * Pop the longest waiting thread from the waiters list.
-   * @return The thread in case one is waiting
-   * @return 0 in case no thread is waiting for this lock.
+   * Add the current thread to the waiters list of this lock without putting it to sleep.
    */
-  Thread* popBackThreadFromWaitersList();
-
-  /**
-   * Add the current thread to the waiters list of this lock.
-   */
-  void pushFrontCurrentThreadToWaitersList();
+  void pushBackCurrentThreadToWaitersList();
 
   /**
    * Print the lock status.
@@ -166,11 +202,27 @@ protected:
   void printStatus();
 
   /**
-   * Release the lock, and set the thread to sleeping.
+   * Put the current thread to sleep on the waiters list and unlock the list.
+   * The waiters list has to be locked with interrupts enabled before.
    */
   void sleepAndRelease();
 
+  /**
+   * Priority inheritance: passes the priority of the current thread, which is going to wait on this lock,
+   * on to the holder and along the chain of locks the holders are waiting on. Interrupts have to be disabled.
+   */
+  void boostHolders();
+
+  /**
+   * The threads waiting on this lock, in the order they started to wait.
+   * The list can be read out while the lock is not held (for checks and prints).
+   */
+  WaitQueue waiters_;
+
 private:
+  void recordAcquired(pointer called_by, bool contended, uint64 wait_start);
+  void recordRelease();
+
 
   /**
    * The name of the lock is a char pointer instead of a string,
@@ -178,20 +230,17 @@ private:
    */
   const char* name_;
 
-  /**
-   * The single chained list of threads waiting on this lock.
-   * The list can be read out while the lock is not held (for checks and prints).
-   * To be able to read out without locking, all modifying accesses have to be atomic!
-   * If not, the list may become invalid while someone is reading out of it!
-   */
-  Thread* waiters_list_;
-
   /**
    * The lock for the waiters list. The list has to be locked for writing access,
    * but may be used for unlocked access in case no element is going to be removed meanwhile.
    */
   size_t waiters_list_lock_;
 
+  /**
+   * The interrupt state before the waiters list was locked, only accessed by the thread holding the list lock.
+   */
+  bool waiters_list_interrupts_enabled_;
+
   /**
    * Check if a deadlock would happen in combination with other locks.
    * @param thread_waiting The thread which wants to wait on the lock
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "types.h"
+
+class Lock;
+
+/**
+ * Collects contention statistics of Mutexes and SpinLocks, per lock and per call site of acquire.
+ * Profiling is off by default, the locks only read a timestamp while it is enabled.
+ * Wait and hold times are measured with ArchCommon::getTimestamp().
+ * The tables have a fixed size, so recording never allocates memory (which would take the KMM lock).
+ */
+class LockProfiler
+{
+  public:
+    static bool isEnabled()
+    {
+      return enabled_;
+    }
+
+    /**
+     * @return true if profiling has been enabled at least once, so the tables may refer to locks
+     */
+    static bool hasRecords()
+    {
+      return has_records_;
+    }
+
+    /**
+     * resets all counters and starts profiling
+     */
+    static void enable();
+    static void disable();
+
+    /**
+     * called by a lock after it has been acquired
+     * @param lock the lock
+     * @param called_by the call site of acquire
+     * @param contended true if the lock was not free at the first attempt
+     * @param wait the time the thread waited for the lock
+     */
+    static void recordAcquire(Lock* lock, pointer called_by, bool contended, uint64 wait);
+
+    /**
+     * called by a lock before it is released
+     * @param lock the lock
+     * @param called_by the call site of the acquire which took the lock
+     * @param hold the time the lock was held
+     */
+    static void recordRelease(Lock* lock, pointer called_by, uint64 hold);
+
+    /**
+     * removes a lock which is destroyed from the statistics
+     */
+    static void forgetLock(Lock* lock);
+
+    /**
+     * prints the locks and call sites with the longest total wait time, call sites are resolved
+     */
+    static void printReport();
+
+    /**
+     * writes the report as text, call sites are given as addresses and mangled names
+     * @return the length of the text
+     */
+    static size_t writeReport(char* buffer, size_t size);
+
+    static const size_t MAX_LOCKS = 128;
+    static const size_t MAX_CALL_SITES = 256;
+
+    /**
+     * number of locks and call sites in the report
+     */
+    static const size_t REPORT_ENTRIES = 16;
+
+  private:
+    struct Entry
+    {
+      pointer key_;
+      const char* name_;
+      size_t acquisitions_;
+      size_t contended_;
+      uint64 wait_total_;
+      uint64 wait_max_;
+      uint64 hold_total_;
+      uint64 hold_max_;
+    };
+
+    static Entry* find(Entry* table, size_t size, pointer key, bool create);
+    static size_t sortByWait(Entry* table, size_t size, Entry** sorted, size_t max);
+
+    static bool enabled_;
+    static bool has_records_;
+    static size_t dropped_;
+    static Entry locks_[MAX_LOCKS];
+    static Entry call_sites_[MAX_CALL_SITES];
+};
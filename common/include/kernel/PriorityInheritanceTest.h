@@ -0,0 +1,19 @@
+#pragma once
+
+#include "types.h"
+
+/**
+ * Checks that the priority inheritance of Mutex bounds a priority inversion, started with F6 on the console.
+ * A low priority thread takes a mutex and starts a medium priority thread which keeps the cpu busy for a long
+ * time, and a high priority thread which waits for the mutex. Without inheritance the low priority thread
+ * only gets to release the mutex after the medium one is done. With it the high priority thread gets the
+ * mutex while the medium one still runs.
+ */
+class PriorityInheritanceTest
+{
+  public:
+    /**
+     * starts the low priority thread, the result is printed by the high priority thread
+     */
+    static void start();
+};
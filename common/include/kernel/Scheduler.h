@@ -3,7 +3,7 @@
 #include "types.h"
 #include <ulist.h>
 #include "IdleThread.h"
-#include "CleanupThread.h"
+#include "WorkQueue.h"
 
 class Thread;
 class Mutex;
@@ -17,16 +17,55 @@ class Scheduler
 
     void addNewThread(Thread *thread);
     void sleep();
+
+    /**
+     * makes a sleeping thread runnable again, the thread has to be sleeping already
+     * (a thread going to sleep on a WaitQueue is marked as sleeping before it can be woken up)
+     */
     void wake(Thread *thread_to_wake);
     void yield();
+    /**
+     * prints the threads with their accounting and the wakeup latency histogram
+     */
     void printThreadList();
     void printStackTraces();
     void printLockingInformation();
     bool isSchedulingEnabled();
     bool isCurrentlyCleaningUp();
+
+    /**
+     * called by the timer interrupt handler, see TimerQueue::handleInterrupt
+     */
     void incTicks();
+
+    /**
+     * @return the number of ticks (time slices) since the timer was started
+     */
     uint32 getTicks();
 
+    /**
+     * @return true if a thread other than the idle thread is ready to run, interrupts have to be disabled
+     */
+    bool threadsReady();
+
+    /**
+     * writes the thread accounting and the wakeup latency histogram as text, the generator of /dev/sched
+     * @return the length of the text
+     */
+    static size_t writeStatistics(char* buffer, size_t size);
+
+    /**
+     * number of buckets of the wakeup latency histogram, bucket i counts latencies in [2^i, 2^(i+1))
+     * timestamp units, the last one everything above
+     */
+    static const size_t LATENCY_BUCKETS = 32;
+
+    /**
+     * submits the cleanup of dead threads to the system work queue,
+     * called when a thread is marked to be destroyed with interrupts disabled
+     */
+    void queueCleanup();
+
     /**
      * NEVER EVER EVER CALL THIS METHOD OUTSIDE OF AN INTERRUPT CONTEXT
      * this is the method that decides which threads will be scheduled next
@@ -38,10 +77,26 @@ class Scheduler
 
   protected:
     friend class IdleThread;
-    friend class CleanupThread;
+    friend class Thread;
 
     void cleanupDeadThreads();
 
+    static size_t cleanupJob(void* arg);
+
+    /**
+     * Appends a runnable thread to the ready queue of its priority.
+     * Interrupts have to be disabled while calling this.
+     * @param thread the thread, nothing happens if it is already queued
+     */
+    void enqueueReadyThread(Thread* thread);
+
+    /**
+     * Removes a thread from its ready queue.
+     * Interrupts have to be disabled while calling this.
+     * @param thread the thread, nothing happens if it is not queued
+     */
+    void dequeueReadyThread(Thread* thread);
+
   private:
     Scheduler();
 
@@ -58,15 +113,49 @@ class Scheduler
      */
     void unlockScheduling();
 
+    /**
+     * Takes the first thread out of the highest non-empty ready queue
+     * @return the thread or 0 if all ready queues are empty
+     */
+    Thread* popNextReadyThread();
+
+    /**
+     * charges the time since the last call to the current thread
+     */
+    void accountTime(uint64 now);
+
+    void recordLatency(uint64 latency);
+
     static Scheduler *instance_;
 
     typedef ustl::list<Thread*> ThreadList;
     ThreadList threads_;
 
+    /**
+     * One FIFO ready queue per priority, bit i of ready_queues_bitmap_ is set iff queue i is non-empty
+     */
+    Thread* ready_queues_head_[Thread::NUM_PRIORITIES];
+    Thread* ready_queues_tail_[Thread::NUM_PRIORITIES];
+    uint32 ready_queues_bitmap_;
+
     size_t block_scheduling_;
 
-    size_t ticks_;
+    /**
+     * timestamp of the last call of schedule(), the time since then belongs to currentThread
+     */
+    uint64 last_accounted_;
+
+    /**
+     * time from waking up a thread until it runs, see LATENCY_BUCKETS
+     */
+    size_t latency_histogram_[LATENCY_BUCKETS];
+
+    WorkItem cleanup_work_;
+
+    /**
+     * the worker which runs cleanupDeadThreads right now, 0 if none does
+     */
+    Thread* cleaning_up_;
 
     IdleThread idle_thread_;
-    CleanupThread cleanup_thread_;
 };
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "types.h"
+#include "WaitQueue.h"
+
+class Thread;
+
+/**
+ * Deferred work of interrupt handlers (bottom halves).
+ * The interrupt handler (top half) only acknowledges the device, saves what is lost otherwise and raises
+ * its source. A kernel thread of the highest priority runs the handlers of the raised sources with
+ * interrupts enabled, raising a source again before its handler ran only runs it once.
+ * Until the scheduler runs there is no thread to defer to, the handlers are run by raise() then.
+ * The latency from raising a source until its handler starts and the run time of the handlers are
+ * recorded per source, in ArchCommon::getTimestamp() units.
+ */
+class SoftIrq
+{
+  public:
+    enum Source
+    {
+      KEYBOARD, SERIAL, BLOCK_DEVICE, NUM_SOURCES
+    };
+
+    typedef void (*Handler)();
+
+    /**
+     * sets the bottom half of a source, it is called from the worker thread with interrupts enabled
+     */
+    static void setHandler(Source source, const char* name, Handler handler);
+
+    /**
+     * marks the source as pending and wakes up the worker thread, interrupts have to be disabled
+     */
+    static void raise(Source source);
+
+    /**
+     * @return true if a raised source waits for a worker which would preempt the current thread,
+     * the interrupt handler should schedule then, interrupts have to be disabled
+     */
+    static bool shouldPreempt();
+
+    /**
+     * creates the worker thread, the handlers can be set before
+     */
+    static void initialise();
+
+    static void printStatistics();
+
+    /**
+     * writes the per source counters and latencies as text, the generator of /dev/softirq
+     * @return the length of the text
+     */
+    static size_t writeStatistics(char* buffer, size_t size);
+
+  private:
+    friend class SoftIrqThread;
+
+    /**
+     * waits until a source is raised and runs the handlers of all raised sources
+     */
+    static void runPending();
+
+    static void runHandler(Source source, uint64 raised_at);
+
+    struct Entry
+    {
+      const char* name_;
+      Handler handler_;
+      uint64 raised_at_;
+      size_t raised_;
+      size_t runs_;
+      uint64 latency_total_;
+      uint64 latency_max_;
+      uint64 run_total_;
+      uint64 run_max_;
+    };
+
+    static Entry sources_[NUM_SOURCES];
+
+    /**
+     * bit i is set while source i is raised and its handler has not been started yet
+     */
+    static size_t pending_;
+
+    static WaitQueue waiters_;
+    static Thread* thread_;
+};
@@ -34,7 +34,48 @@ public:
    */
   bool isFree();
 
+  /**
+   * prints how often the spinlock was contended, and how the waiting threads got it
+   */
+  void printStatistics();
+
+  /**
+   * Sets the number of pause instructions a thread busy waits for a contended spinlock
+   * before it starts yielding. 0 disables spinning.
+   */
+  static void setSpinBudget(size_t spin_budget);
+
+  /**
+   * @return the spin budget, unless it was set: DEFAULT_SPIN_BUDGET with more than one cpu, 0 with a single one
+   */
+  static size_t getSpinBudget();
+
+  static const size_t DEFAULT_SPIN_BUDGET = 1024;
+
+  /**
+   * the maximum number of pause instructions between two attempts to take the lock
+   */
+  static const size_t MAX_BACKOFF = 64;
+
 private:
+  /**
+   * Busy wait for the lock with exponential backoff, as long as the thread holding it is running on another cpu.
+   * @return true if the lock has been acquired
+   */
+  bool spin();
+
+  static size_t spin_budget_;
+
+  // statistics, only modified while holding the spinlock
+  size_t num_acquires_;
+  size_t num_contended_;
+  size_t num_acquired_spinning_;
+  size_t num_yields_;
+  /**
+   * the longest time a contended acquire took, in ArchCommon::getTimestamp units
+   */
+  uint64 max_wait_;
+
   /**
    * The basic spinlock is just a variable which is
    */
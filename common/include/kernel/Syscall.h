@@ -21,6 +21,12 @@ class Syscall
   static void pseudols(const char *pathname, char *buffer, size_t size);
 
   static size_t createprocess(size_t path, size_t sleep);
+
+  /**
+   * creates a copy of the calling process which shares its memory copy-on-write
+   * @return the pid of the child to the parent, 0 to the child, -1 if the process could not be forked
+   */
+  static size_t fork();
   static void trace();
 };
 
@@ -30,6 +30,12 @@ class Thread
 
     static const char* threadStatePrintable[3];
 
+    /**
+     * Number of priority levels known to the scheduler, a higher value means a higher priority
+     */
+    static const size_t NUM_PRIORITIES = 8;
+    static const size_t DEFAULT_PRIORITY = 4;
+
     enum TYPE { KERNEL_THREAD, USER_THREAD };
 
     /**
@@ -104,6 +110,31 @@ class Thread
 
     void setState(ThreadState state);
 
+    /**
+     * @return the effective priority, the base priority or a higher one inherited from threads waiting on its locks
+     */
+    size_t getPriority() const;
+
+    size_t getBasePriority() const;
+
+    /**
+     * Changes the base priority of the thread, moving it to the matching ready queue if it is runnable
+     * @param priority the new priority, has to be smaller than NUM_PRIORITIES
+     */
+    void setPriority(size_t priority);
+
+    /**
+     * Priority inheritance: raises the effective priority to the given one if it is lower.
+     * Interrupts have to be disabled.
+     */
+    void inheritPriority(size_t priority);
+
+    /**
+     * Recomputes the effective priority from the base priority and the threads waiting on the locks
+     * the thread holds, called when it releases a lock or a lock is handed over to it.
+     */
+    void updateEffectivePriority();
+
     /**
      * A part of the single-chained waiters list for the locks.
      * It references to the next element of the list.
@@ -124,14 +155,75 @@ class Thread
      */
     Lock* holding_lock_list_;
 
+    /**
+     * Links of the doubly linked ready queue the thread is in while it is runnable but not running.
+     * Only accessed by the Scheduler with interrupts disabled.
+     */
+    Thread* next_thread_in_run_queue_;
+    Thread* prev_thread_in_run_queue_;
+    bool in_run_queue_;
+
+    /**
+     * The time the thread sleeps until and its position in the heap of the TimerQueue,
+     * TimerQueue::NOT_QUEUED if it is not in there. Only accessed by the TimerQueue with interrupts disabled.
+     */
+    uint64 timer_deadline_;
+    size_t timer_heap_index_;
+
+    /**
+     * CPU accounting in ArchCommon::getTimestamp() units, updated by the Scheduler.
+     * The time between two calls of schedule() is charged to the thread which ran,
+     * as user or kernel time depending on where it was interrupted.
+     */
+    uint64 user_time_;
+    uint64 kernel_time_;
+
+    /**
+     * total time spent in a ready queue waiting for the cpu
+     */
+    uint64 run_queue_wait_;
+    uint64 ready_since_;
+
+    /**
+     * a switch is voluntary if the thread yielded or went to sleep, involuntary if it was preempted
+     */
+    size_t voluntary_switches_;
+    size_t involuntary_switches_;
+
+    /**
+     * set by Scheduler::yield, so schedule() can tell a yield from a preemption
+     */
+    bool yielding_;
+
+    /**
+     * set when a sleeping thread is woken up, its wait in the ready queue goes into the wakeup latency histogram
+     */
+    bool woken_up_;
+
   private:
     Thread(Thread const &src);
     Thread &operator=(Thread const &src);
 
     volatile ThreadState state_;
 
+    /**
+     * priority_ is the effective priority the scheduler uses, it is at least base_priority_
+     */
+    size_t priority_;
+    size_t base_priority_;
+
+    /**
+     * moves the thread to the ready queue of the new effective priority, interrupts have to be disabled
+     */
+    void changePriority(size_t priority);
+
     size_t tid_;
 
+    /**
+     * the tid of the last thread created, tids are never reused
+     */
+    static uint64 last_tid_;
+
     Terminal* my_terminal_;
 
   protected:
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "types.h"
+
+class Thread;
+
+/**
+ * Keeps the time since boot and the threads sleeping until a deadline, in a min-heap ordered by deadline.
+ * If the timer supports one-shot interrupts, the next interrupt is programmed for the earliest deadline
+ * or the end of the time slice, whatever comes first. While only the idle thread runs there are
+ * no time slices, so the periodic tick is suppressed and the cpu is only woken up for the next deadline.
+ * Otherwise the timer keeps running periodically and the deadlines are checked on every tick.
+ */
+class TimerQueue
+{
+  public:
+    static TimerQueue* instance();
+
+    /**
+     * length of a scheduler tick (time slice) in nanoseconds, the period of the PIT at its lowest frequency
+     */
+    static const uint64 NS_PER_TICK = 54925439;
+
+    static const uint64 NS_PER_MS = 1000000;
+
+    /**
+     * @return the nanoseconds since the timer was started
+     */
+    uint64 now();
+
+    /**
+     * puts the current thread to sleep until now() reaches the deadline
+     * @param deadline the time to wake up, in nanoseconds since the timer was started
+     */
+    void sleepUntil(uint64 deadline);
+
+    /**
+     * puts the current thread to sleep for the given time
+     */
+    void nanosleep(uint64 ns);
+
+    /**
+     * Called by the timer interrupt handler. Advances the time and wakes up the threads whose deadline has passed.
+     */
+    void handleInterrupt();
+
+    /**
+     * Programs the next timer interrupt, called by the scheduler with interrupts disabled.
+     * @param idle true if nothing but the idle thread is going to run, no time slice has to end then
+     */
+    void programNextInterrupt(bool idle);
+
+    /**
+     * removes a thread from the sleeping threads, e.g. because it is going to be destroyed
+     */
+    void cancel(Thread* thread);
+
+    /**
+     * @return the number of timer interrupts so far
+     */
+    size_t getNumInterrupts();
+
+    static const size_t NOT_QUEUED = (size_t) -1;
+
+  private:
+    TimerQueue();
+
+    /**
+     * makes sure the heap can take one more thread, returns with interrupts disabled
+     */
+    void reserve();
+
+    void push(Thread* thread);
+    void removeAt(size_t index);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    void place(Thread* thread, size_t index);
+
+    static TimerQueue* instance_;
+
+    Thread** heap_;
+    size_t size_;
+    size_t capacity_;
+
+    /**
+     * the time the timer was programmed at, in periodic mode the time of the last tick
+     */
+    uint64 base_;
+
+    /**
+     * the deadline the last interrupt was programmed for, 0 if it has run out
+     */
+    uint64 programmed_deadline_;
+
+    /**
+     * true once the timer has been switched to one-shot interrupts, false while it runs periodically
+     */
+    bool one_shot_;
+
+    /**
+     * true if the timer does not support one-shot interrupts
+     */
+    bool periodic_only_;
+
+    size_t interrupts_;
+};
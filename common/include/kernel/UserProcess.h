@@ -14,6 +14,13 @@ class UserProcess : public Thread
      */
     UserProcess(ustl::string minixfs_filename, FileSystemInfo *fs_info, uint32 terminal_number = 0);
 
+    /**
+     * Constructor of a forked process, it continues after the fork syscall of the parent with
+     * a copy-on-write copy of its address space. The process is killed if forking fails.
+     * @param parent the process calling fork, it has to be the current thread
+     */
+    UserProcess(UserProcess& parent);
+
     virtual ~UserProcess();
 
     virtual void Run(); // not used
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "types.h"
+
+class Thread;
+
+/**
+ * A FIFO queue of sleeping threads, chained through Thread::next_thread_in_lock_waiters_list_,
+ * so a thread can wait on one queue at a time.
+ * All methods have to be called with interrupts disabled. Checking the condition to wait for and
+ * going to sleep is atomic this way, a thread cannot be woken up in between and miss it.
+ */
+class WaitQueue
+{
+  public:
+    WaitQueue();
+
+    /**
+     * Appends the current thread and puts it to sleep until it is woken up.
+     * Interrupts are enabled while the thread sleeps and disabled again when it returns.
+     * @param guard a lock word held by the caller, it is cleared once the thread is marked as sleeping
+     */
+    void sleep(size_t* guard = 0);
+
+    /**
+     * Wakes up the thread which has been waiting longest.
+     * @return the thread or 0 if the queue is empty
+     */
+    Thread* wakeOne();
+
+    /**
+     * Wakes up all threads.
+     * @return the number of threads woken up
+     */
+    size_t wakeAll();
+
+    /**
+     * Appends a thread without putting it to sleep, e.g. a busy waiter which should be visible to the deadlock checks
+     */
+    void pushBack(Thread* thread);
+
+    /**
+     * Removes the thread from the queue without waking it up
+     * @return true if the thread was in the queue
+     */
+    bool remove(Thread* thread);
+
+    /**
+     * @return the thread which has been waiting longest, the others follow through next_thread_in_lock_waiters_list_
+     */
+    Thread* first() const
+    {
+      return head_;
+    }
+
+    bool empty() const
+    {
+      return head_ == 0;
+    }
+
+  private:
+    Thread* popFront();
+
+    Thread* head_;
+    Thread* tail_;
+};
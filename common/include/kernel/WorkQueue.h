@@ -0,0 +1,120 @@
+#pragma once
+
+#include "types.h"
+#include "WaitQueue.h"
+
+class WorkQueue;
+
+/**
+ * A job for a WorkQueue, which also serves as its completion: the submitter can wait for the result like for a future.
+ * Submitting a job which is still queued does nothing, submitting it while it runs makes it run once more afterwards,
+ * so a job can be submitted whenever there is new work for it without piling up.
+ * The item has to stay valid until the job is done.
+ */
+class WorkItem
+{
+  public:
+    /**
+     * the job, it is called by a worker thread with interrupts enabled
+     * @return the result passed to the waiters
+     */
+    typedef size_t (*Function)(void* arg);
+
+    WorkItem(Function function, void* arg = 0);
+
+    /**
+     * waits until the job has run since it was submitted last
+     * @return the result of the job
+     */
+    size_t wait();
+
+    /**
+     * @return true if the job is neither queued nor running
+     */
+    bool isDone() const
+    {
+      return state_ == DONE;
+    }
+
+  private:
+    friend class WorkQueue;
+
+    enum State
+    {
+      DONE, QUEUED, RUNNING
+    };
+
+    Function function_;
+    void* arg_;
+    size_t result_;
+    State state_;
+
+    /**
+     * set if the job has been submitted again while it was running
+     */
+    bool resubmitted_;
+
+    WorkItem* next_;
+    WaitQueue waiters_;
+};
+
+/**
+ * Runs WorkItems on a bounded pool of kernel threads, so background work does not need a thread of its own.
+ * The pool starts with one worker and grows on demand, up to max_workers, when a job is submitted while all
+ * workers are busy. Workers are never destroyed, idle ones sleep until the next job is submitted.
+ */
+class WorkQueue
+{
+  public:
+    /**
+     * the queue for the kernel's own background jobs, it has to be created before the first job is submitted
+     */
+    static WorkQueue* system();
+
+    /**
+     * @param name the name of the queue, the workers are named after it
+     * @param max_workers the maximum number of worker threads
+     * @param priority the priority of the worker threads
+     */
+    WorkQueue(const char* name, size_t max_workers, size_t priority);
+
+    /**
+     * Queues a job. It may be called with interrupts disabled and from interrupt handlers,
+     * no worker is added then, so the job waits for one of the existing workers.
+     * @return false if the job was already queued
+     */
+    bool submit(WorkItem* item);
+
+    void printStatistics();
+
+  private:
+    friend class WorkQueueWorker;
+
+    /**
+     * the loop of a worker thread: takes the first job and runs it
+     */
+    void runWorker();
+
+    /**
+     * creates a worker thread, num_workers_ has to be incremented already
+     */
+    void addWorker();
+
+    void append(WorkItem* item);
+
+    static WorkQueue* system_;
+
+    const char* name_;
+    size_t max_workers_;
+    size_t priority_;
+    size_t num_workers_;
+    size_t busy_workers_;
+
+    WorkItem* head_;
+    WorkItem* tail_;
+
+    WaitQueue idle_workers_;
+
+    size_t submitted_;
+    size_t completed_;
+};
@@ -2,6 +2,7 @@
 
 #include "new.h"
 #include "SpinLock.h"
+#include "SlabAllocator.h"
 #include "assert.h"
 
 class MallocSegment
@@ -77,6 +78,7 @@ class KernelMemoryManager
 
     /**
      * allocateMemory is called by new
+     * small sizes are served by the slab caches, everything else
      * searches the MallocSegment-List for a free segment with size >= requested_size
      * @param requested_size number of bytes to allocate
      * @return pointer to Memory Address or 0 if Not Enough Memory
@@ -165,6 +167,8 @@ class KernelMemoryManager
 
     SpinLock lock_;
 
+    SlabAllocator slab_allocator_;
+
     uint32 segments_used_;
     uint32 segments_free_;
     size_t approx_memory_free_;
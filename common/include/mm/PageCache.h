@@ -0,0 +1,108 @@
+#pragma once
+
+#include "types.h"
+#include "Mutex.h"
+
+class Inode;
+
+/**
+ * One cached page of a file
+ */
+class PageCacheEntry
+{
+  public:
+    Inode* inode_;
+    size_t index_;
+    size_t ppn_;
+
+    PageCacheEntry* hash_next_;
+    PageCacheEntry* lru_prev_;
+    PageCacheEntry* lru_next_;
+};
+
+/**
+ * Page frames holding the contents of file pages, keyed by (inode, page index in the file).
+ * A frame is mapped read-only into every process which maps the same page of the file, so
+ * the text of a binary is loaded once, no matter how often it runs.
+ * The cache holds one reference to every frame (see PageManager::addReference). Frames
+ * which are not mapped anywhere else can be reclaimed in LRU order under memory pressure.
+ * Writing to the inode or deleting it drops its pages, mapped frames stay with their processes.
+ */
+class PageCache
+{
+  public:
+    static PageCache* instance();
+
+    /**
+     * @return the frame caching the page with a reference added for the caller, 0 if it is not cached
+     */
+    size_t get(Inode* inode, size_t index);
+
+    /**
+     * @return true if the page is cached, no reference is added
+     */
+    bool contains(Inode* inode, size_t index);
+
+    /**
+     * adds a frame holding the contents of the page to the cache, the caller keeps its reference.
+     * If the page has been cached in the meantime, the caller's reference to the new frame is dropped instead.
+     * @return the frame caching the page, the caller holds a reference to it
+     */
+    size_t insert(Inode* inode, size_t index, size_t ppn);
+
+    /**
+     * drops all cached pages of the inode, it has to be called before the file changes or the inode is deleted
+     */
+    void invalidate(Inode* inode);
+
+    /**
+     * frees up to num frames which are only referenced by the cache, least recently used first.
+     * It may sleep, so it must not be called with interrupts disabled.
+     * @return the number of frames freed
+     */
+    size_t reclaim(size_t num);
+
+    /**
+     * @return true if reclaim can be called by the current thread
+     */
+    bool canReclaim();
+
+    void printStatistics();
+
+    /**
+     * writes the counters as text, the generator of /dev/pagecache
+     * @return the length of the text
+     */
+    static size_t writeStatistics(char* buffer, size_t size);
+
+    static const size_t NUM_HASH_BUCKETS = 256;
+
+  private:
+    PageCache();
+
+    size_t hash(Inode* inode, size_t index);
+    PageCacheEntry* lookup(Inode* inode, size_t index);
+
+    /**
+     * unlinks the entry, deletes it and drops the reference of the cache to its frame
+     */
+    void remove(PageCacheEntry* entry);
+    void hashRemove(PageCacheEntry* entry);
+    void lruRemove(PageCacheEntry* entry);
+    void lruPushFront(PageCacheEntry* entry);
+
+    static PageCache* instance_;
+
+    Mutex lock_;
+
+    PageCacheEntry* hash_buckets_[NUM_HASH_BUCKETS];
+    PageCacheEntry* lru_head_;
+    PageCacheEntry* lru_tail_;
+
+    size_t num_pages_;
+    size_t hits_;
+    size_t misses_;
+    size_t inserts_;
+    size_t reclaimed_;
+    size_t invalidated_;
+};
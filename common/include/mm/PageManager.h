@@ -8,6 +8,70 @@
 #define DYNAMIC_KMM (0) // Please note that this means that the KMM depends on the page manager
 // and you will have a harder time implementing swapping. Pros only!
 
+#ifdef DEBUG
+#define PAGE_POISONING (1) // fill free pages with 0xFF and check them on allocation to detect use-after-free
+#else
+#define PAGE_POISONING (0)
+#endif
+
+class FreePageBlock;
+
+/**
+ * A small stack of free single pages owned by one cpu.
+ * It is only accessed by its cpu with interrupts disabled, so it needs no lock.
+ */
+class PageMagazine
+{
+  public:
+    static const size_t SIZE = 64;
+    static const size_t BATCH = 32;
+
+    uint32 ppns_[SIZE];
+    size_t count_;
+
+    size_t hits_;
+    size_t refills_;
+    size_t drains_;
+};
+
+/**
+ * The descriptor of a physical page frame, PageManager keeps one for every frame in an array indexed by ppn.
+ * It takes 16 bytes per frame, 0.4% of the memory (512 KiB for 128 MiB of RAM).
+ * All fields are changed with interrupts disabled.
+ */
+class PageFrame
+{
+  public:
+    enum Flags
+    {
+      USER = 1, // mapped into user space
+      FILE_BACKED = 2, // holds the contents of a file page, e.g. for the PageCache
+      DIRTY = 4, // written since its contents were filled in
+      LRU = 8, // linked into the LRU list of user frames
+      SLAB = 16, // a page of the SlabAllocator
+    };
+
+    /**
+     * the number of references, 0 if the frame is free
+     */
+    uint16 ref_count_;
+    uint16 flags_;
+
+    /**
+     * the physical address of the page table entry mapping the frame, 0 if it is not known.
+     * A frame with more than one reference has no single entry, unless its page table is shared.
+     */
+    uint32 rmap_;
+
+    /**
+     * ppns of the neighbours in the LRU list, 0 at its ends
+     */
+    uint32 lru_prev_;
+    uint32 lru_next_;
+};
+
+static_assert(sizeof(PageFrame) == 16, "PageFrame has to stay small, there is one for every frame");
+
 class PageManager
 {
   public:
@@ -27,19 +91,74 @@ class PageManager
     size_t getNumFreePages() const;
 
     /**
-     * returns the number of the lowest free Page
-     * and marks that Page as used.
+     * returns the number of a free, zeroed block of physical pages
+     * and marks it as used. The block is aligned to its size rounded up to a power of two.
+     * Single pages are taken from the magazine of the current cpu without taking lock_.
      * returns always 4kb ppns!
+     * @param page_size size of the block in bytes, a multiple of PAGE_SIZE
+     * @param may_fail return 0 instead of failing if there is no free block of this size
      */
-    uint32 allocPPN(uint32 page_size = PAGE_SIZE);
+    uint32 allocPPN(uint32 page_size = PAGE_SIZE, bool may_fail = false);
 
     /**
-     * marks physical page <page_number> as free, if it was used in
-     * user or kernel space.
+     * drops a reference to physical page <page_number> and marks it as free once
+     * there is none left, if it was used in user or kernel space.
+     * Blocks of more than one page must not be shared.
      * @param page_number Physcial Page to mark as unused
+     * @param page_size size of the block in bytes, a multiple of PAGE_SIZE
      */
     void freePPN(uint32 page_number, uint32 page_size = PAGE_SIZE);
 
+    /**
+     * adds a reference to an allocated page, so it can be mapped more than once.
+     * Every reference is dropped with freePPN, allocPPN hands out a page with one reference.
+     */
+    void addReference(uint32 page_number);
+
+    /**
+     * @return the number of references to the page, 0 if it is free
+     */
+    uint32 getReferenceCount(uint32 page_number) const;
+
+    /**
+     * records the page table entry which maps the page, it has to be called by ArchMemory::mapPage after the entry
+     * is written. The entry is the reverse mapping of the page as long as the mapping holds its only reference.
+     * Dropping any reference with freePPN, e.g. in ArchMemory::unmapPage, or adding one forgets the entry again.
+     * @param pt_ppn the page table page containing the entry
+     * @param pte the identity mapped address of the entry
+     * @param user pages mapped into user space are added to the LRU list
+     */
+    void addMapping(uint32 page_number, uint32 pt_ppn, pointer pte, bool user);
+
+    /**
+     * @return the identity mapped address of the page table entry mapping the page, 0 if it is not known
+     */
+    pointer getMapping(uint32 page_number) const;
+
+    /**
+     * @param flags PageFrame::Flags to set, they are cleared when the page is freed
+     */
+    void setFlags(uint32 page_number, uint16 flags);
+    void clearFlags(uint32 page_number, uint16 flags);
+    uint16 getFlags(uint32 page_number) const;
+
+    /**
+     * @return the page number of an address in the identity mapping of the physical memory, 0 if it is outside
+     */
+    uint32 getPPNOfIdentAddress(pointer address) const;
+
+    /**
+     * moves the least recently used user frame to the front of the LRU list, it is the hand of the clock of the
+     * page reclaim. Interrupts have to be disabled.
+     * @return the frame, 0 if there is no user frame
+     */
+    uint32 rotateLRU();
+
+    size_t getNumLRUFrames() const
+    {
+      return num_lru_frames_;
+    }
+
     Thread* heldBy()
     {
       return lock_.heldBy();
@@ -47,25 +166,82 @@ class PageManager
 
     PageManager();
 
-    void printBitmap()
-    {
-      page_usage_table_->bmprint();
-    }
+    /**
+     * prints the number of free blocks of every buddy order and the magazine counters using kprintfd
+     */
+    void printFreeLists();
 
-  private:
     /**
-     * used internally to mark pages as reserved
-     * @param ppn
-     * @param num
-     * @return
+     * blocks of up to 2^MAX_ORDER pages are managed by the buddy allocator
      */
-    bool reservePages(uint32 ppn, uint32 num = 1);
+    static const uint32 MAX_ORDER = 10;
 
+  private:
     PageManager(PageManager const&);
 
-    Bitmap* page_usage_table_;
+    /**
+     * takes a block of 2^order pages from the free lists, splitting a larger block if necessary
+     * @return the first ppn of the block or 0 if there is no block large enough
+     */
+    uint32 allocBlock(uint32 order);
+
+    /**
+     * returns a naturally aligned block of 2^order pages to the free lists, merging it with its free buddies
+     */
+    void freeBlock(uint32 ppn, uint32 order);
+
+    /**
+     * returns an arbitrary range of pages to the free lists as naturally aligned blocks
+     */
+    void freeRange(uint32 ppn, uint32 num);
+
+    void addFreeBlock(uint32 ppn, uint32 order);
+    void removeFreeBlock(FreePageBlock* block);
+
+    /**
+     * @return the magazine of the cpu we are running on, interrupts have to be disabled
+     */
+    PageMagazine& currentMagazine();
+
+    void lruPushFront(uint32 ppn);
+    void lruRemove(uint32 ppn);
+
+    /**
+     * fills the magazine of the current cpu with a batch of pages from the free lists
+     * @return one page of the batch for the caller or 0 if there is no free page left
+     */
+    uint32 refillMagazine();
+
+    /**
+     * @param ppn page to put into the magazine of the current cpu, half of the magazine is
+     * given back to the free lists if it is full
+     */
+    void putIntoMagazine(uint32 ppn);
+
+    /**
+     * bit n is set iff ppn n is the first page of a block in one of the free lists
+     */
+    Bitmap* free_block_heads_;
+
+    /**
+     * the descriptors of all frames, allocated next to free_block_heads_
+     */
+    PageFrame* frames_;
+
+    /**
+     * the user frames, the most recently mapped first
+     */
+    uint32 lru_head_;
+    uint32 lru_tail_;
+    size_t num_lru_frames_;
+
+    FreePageBlock* free_lists_[MAX_ORDER + 1];
+    size_t num_free_blocks_[MAX_ORDER + 1];
+    size_t num_free_pages_;
     uint32 number_of_pages_;
-    uint32 lowest_unreserved_page_;
+
+    // only one cpu is brought up for now
+    PageMagazine magazines_[1];
 
     SpinLock lock_;
 
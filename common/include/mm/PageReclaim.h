@@ -0,0 +1,116 @@
+#pragma once
+
+#include "types.h"
+#include "Mutex.h"
+
+class ArchMemory;
+class BDVirtualDevice;
+class BDRequest;
+
+/**
+ * Frees page frames when PageManager::allocPPN runs out of them, so a working set larger than the memory
+ * slows down instead of bringing down the kernel.
+ * Frames only held by the PageCache go first. Then a clock sweeps over the LRU list of user frames in
+ * PageManager: a frame accessed since the hand passed it last time gets a second chance. A clean frame
+ * which the Loader filled from the binary is dropped and loaded again on the next fault, any other frame
+ * is written to a slot of the swap partition and read back by the PageFaultHandler.
+ * Only frames with a single reverse mapped page table entry are evicted (see PageManager::addMapping).
+ * The swap partition is the first one of type 0x82 (Linux swap), without it only clean frames are freed.
+ */
+class PageReclaim
+{
+  public:
+    static PageReclaim* instance();
+
+    /**
+     * looks for the swap partition, it has to be called after the block device detection
+     */
+    void initialise();
+
+    /**
+     * frees at least num frames if possible, in batches to spread the cost of the scan and of the writes.
+     * It may sleep, so it must not be called with interrupts disabled.
+     * @return the number of frames freed
+     */
+    size_t reclaim(size_t num);
+
+    /**
+     * @return true if reclaim can be called by the current thread
+     */
+    bool canReclaim();
+
+    /**
+     * reads an evicted page back from the swap partition and maps it
+     * @return false if the page is not in the swap partition
+     */
+    bool swapIn(ArchMemory& arch_memory, size_t virtual_page);
+
+    /**
+     * the slot is referenced by one more page table entry, e.g. after copying a shared page table
+     */
+    void addSlotReference(size_t slot);
+
+    /**
+     * drops a reference to a swap slot, the slot is free once there is none left
+     */
+    void freeSlot(size_t slot);
+
+    void printStatistics();
+
+    /**
+     * writes the counters as text, the generator of /dev/swap
+     * @return the length of the text
+     */
+    static size_t writeStatistics(char* buffer, size_t size);
+
+    static const uint8 SWAP_PARTITION_TYPE = 0x82;
+
+    /**
+     * the minimum number of frames freed by a call to reclaim
+     */
+    static const size_t BATCH = 16;
+
+  private:
+    PageReclaim();
+
+    /**
+     * evicts frames from the LRU list until num are freed or every frame has been visited twice
+     * @return the number of frames freed
+     */
+    size_t scan(size_t num);
+
+    /**
+     * waits for the writes of evicted frames to the swap partition and frees the frames
+     * @return the number of frames freed
+     */
+    size_t completeWrites(uint32* ppns, BDRequest** requests, size_t num);
+
+    /**
+     * @return a free slot with one reference, 0 if the swap partition is full. Interrupts have to be disabled.
+     */
+    size_t allocSlot();
+
+    static PageReclaim* instance_;
+
+    /**
+     * held while frames are evicted and while pages are read back, so a page is never read before it is written
+     */
+    Mutex lock_;
+
+    BDVirtualDevice* device_;
+
+    /**
+     * the number of page table entries referring to every slot, changed with interrupts disabled.
+     * Slot 0 is never used, it holds the header of the swap partition.
+     */
+    uint16* slot_references_;
+    size_t num_slots_;
+    size_t num_used_slots_;
+    size_t next_slot_;
+
+    size_t scans_;
+    size_t pages_scanned_;
+    size_t pages_dropped_;
+    size_t swap_outs_;
+    size_t swap_ins_;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "types.h"
+
+class SlabCache;
+
+/**
+ * Header at the start of every page that is owned by a SlabCache,
+ * the objects of the page follow directly after it
+ */
+class SlabPage
+{
+  public:
+    SlabPage(SlabCache* cache, uint32 ppn);
+
+    bool markerOk()
+    {
+      return marker_ == (0x51AB51AB00000000ull | (uint32) (size_t) this);
+    }
+
+    pointer firstObject();
+
+    uint64 marker_; // = (0x51ab51ab << 32) | (this & 0xffffffff);
+    SlabCache* cache_;
+    SlabPage* next_;
+    SlabPage* prev_;
+    pointer free_list_;
+    size_t objects_used_;
+    uint32 ppn_;
+};
+
+#ifdef DEBUG
+/**
+ * In a debug build every slab object is preceded by the same information a MallocSegment keeps
+ */
+class SlabObjectDebugInfo
+{
+  public:
+    bool markerOk()
+    {
+      return marker_ == (0xdeadbeef00000000ull | (uint32) (size_t) this);
+    }
+
+    uint64 marker_; // = (0xdeadbeef << 32) | (this & 0xffffffff) while the object is allocated
+    pointer next_free_;
+    // the address where this object has been allocated or released at last
+    pointer freed_at_;
+    pointer alloc_at_;
+    pointer alloc_by_;
+};
+#endif
+
+/**
+ * A cache of equally sized objects, carved out of whole pages from the PageManager
+ */
+class SlabCache
+{
+  public:
+    void init(size_t object_size);
+
+    /**
+     * takes an object from the first partially used page, or from a new page if there is none
+     * @return the object slot or 0 if no page could be allocated
+     */
+    pointer allocate();
+
+    /**
+     * puts an object slot back on the free list of its page
+     * @param page the page the slot belongs to
+     * @param slot the object slot
+     */
+    void free(SlabPage* page, pointer slot);
+
+    size_t object_size_;
+    size_t objects_per_page_;
+
+    size_t num_pages_;
+    size_t objects_used_;
+
+  private:
+    SlabPage* createPage();
+    void releasePage(SlabPage* page);
+
+    static void listAdd(SlabPage*& list, SlabPage* page);
+    static void listRemove(SlabPage*& list, SlabPage* page);
+
+    SlabPage* partial_pages_;
+    SlabPage* full_pages_;
+    SlabPage* empty_page_;
+
+    friend class SlabAllocator;
+};
+
+/**
+ * Size class allocator for small kernel heap objects.
+ * It is not locked on its own, the KernelMemoryManager calls it with its lock held.
+ */
+class SlabAllocator
+{
+  public:
+    static const size_t NUM_SIZE_CLASSES = 8;
+
+    /**
+     * the largest size (including the debug information in a debug build) served by the slabs,
+     * larger requests have to go to the segment list
+     */
+    static const size_t MAX_OBJECT_SIZE = 2016;
+
+    SlabAllocator();
+
+    /**
+     * allocates a zeroed object of the smallest size class that fits
+     * @param requested_size the size in bytes, at most MAX_OBJECT_SIZE minus the debug information
+     * @param called_by the caller recorded in a debug build
+     * @return the object or 0 if the size is too large or there is no free page left
+     */
+    pointer allocate(size_t requested_size, pointer called_by);
+
+    /**
+     * @param virtual_address an address not belonging to the segment heap
+     * @return true if the object was freed, false if it is not a slab object
+     */
+    bool free(pointer virtual_address, pointer called_by);
+
+    /**
+     * @return the usable size of the slab object or 0 if it is not a slab object
+     */
+    size_t getObjectSize(pointer virtual_address);
+
+    /**
+     * @param show_stats print usage and fragmentation per size class
+     * @return the number of bytes in allocated objects
+     */
+    size_t getUsedMemory(bool show_stats);
+
+  private:
+    SlabPage* getPageFromAddress(pointer virtual_address);
+
+    SlabCache caches_[NUM_SIZE_CLASSES];
+};
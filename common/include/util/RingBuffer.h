@@ -1,18 +1,17 @@
 #pragma once
 
-#ifdef __cplusplus
-extern "C"
-{
-#endif
-
-#ifdef __cplusplus
-}
-#endif
-
 #include "new.h"
 #include "ArchThreads.h"
 #include "assert.h"
 
+/**
+ * Bounded lock-free queue for any number of producers and consumers, usable from interrupt handlers.
+ * Every slot carries a sequence number which tells whether it is free for the producer of position pos
+ * (sequence == pos) or holds the element of position pos for a consumer (sequence == pos + 1).
+ * Producers reserve a whole span of slots with a single compare and swap on the enqueue position and
+ * commit each slot by publishing its sequence, so a span is never interleaved with other producers.
+ * Elements which do not fit are dropped and counted instead of blocking the producer.
+ */
 template<class T>
 class RingBuffer
 {
@@ -20,60 +19,184 @@ class RingBuffer
     RingBuffer ( uint32 size=128 );
     ~RingBuffer();
     bool get ( T &c );
+
+    /**
+     * takes up to max elements out of the buffer
+     * @return the number of elements taken
+     */
+    size_t get ( T *data, size_t max );
+
     void put ( T c );
+
+    /**
+     * puts all count elements into the buffer as one contiguous span, or none of them if there is not enough space
+     * @return true if the elements have been put into the buffer
+     */
+    bool put ( const T *data, size_t count );
+
     void clear();
+    bool isEmpty();
+
+    /**
+     * @return the number of elements which have been dropped because the buffer was full
+     */
+    size_t getDropped();
 
   private:
+    struct Slot
+    {
+      size_t sequence_;
+      T value_;
+    };
 
-    size_t buffer_size_;
-    T *buffer_;
-    size_t write_pos_;
-    size_t read_pos_;
+    // the compiler must neither cache the value nor move the following loads and stores before it,
+    // the cpu does not reorder loads with later loads and stores on x86 and there is only one cpu on arm
+    static size_t loadAcquire ( size_t &value )
+    {
+      size_t result = *( volatile size_t* ) &value;
+      asm volatile ( "" : : : "memory" );
+      return result;
+    }
+
+    // testSetLock is a full barrier, all stores before it are visible once the new value is
+    static void storeRelease ( size_t &value, size_t new_value )
+    {
+      ArchThreads::testSetLock ( value, new_value );
+    }
+
+    void addDropped ( size_t count );
+
+    Slot *slots_;
+    size_t mask_;
+    size_t enqueue_pos_;
+    size_t dequeue_pos_;
+    size_t dropped_;
 };
 
 template <class T>
-RingBuffer<T>::RingBuffer ( uint32 size )
+RingBuffer<T>::RingBuffer ( uint32 size ) :
+    enqueue_pos_ ( 0 ), dequeue_pos_ ( 0 ), dropped_ ( 0 )
 {
   assert ( size>1 );
-  buffer_size_=size;
-  buffer_=new T[buffer_size_];
-  write_pos_=1;
-  read_pos_=0;
+  // the positions are mapped to slots with a mask, so the size is rounded up to a power of 2
+  size_t buffer_size = 2;
+  while ( buffer_size < size )
+    buffer_size *= 2;
+  mask_ = buffer_size - 1;
+  slots_ = new Slot[buffer_size];
+  for ( size_t i = 0; i < buffer_size; ++i )
+    slots_[i].sequence_ = i;
 }
 
 template <class T>
 RingBuffer<T>::~RingBuffer()
 {
-  delete[] buffer_;
+  delete[] slots_;
 }
 
 template <class T>
 void RingBuffer<T>::put ( T c )
 {
-  size_t old_write_pos=write_pos_;
-  if ( old_write_pos == read_pos_ )
-    return;
-  buffer_[old_write_pos]=c;
-  ArchThreads::testSetLock ( write_pos_, ( old_write_pos + 1 ) % buffer_size_ );
+  put ( &c, 1 );
 }
 
 template <class T>
-void RingBuffer<T>::clear()
+bool RingBuffer<T>::put ( const T *data, size_t count )
 {
-  ArchThreads::testSetLock ( write_pos_,1 );
-  // assumed that there is only one reader who can't have called clear and get at the same time.
-  // here get would return garbage.
-  ArchThreads::testSetLock ( read_pos_,0 );
+  if ( count == 0 )
+    return true;
+  if ( count > mask_ + 1 )
+  {
+    addDropped ( count );
+    return false;
+  }
+  size_t pos = loadAcquire ( enqueue_pos_ );
+  while ( true )
+  {
+    bool full = false;
+    bool moved = false;
+    for ( size_t i = 0; i < count; ++i )
+    {
+      ssize_t diff = ( ssize_t ) ( loadAcquire ( slots_[( pos + i ) & mask_].sequence_ ) - ( pos + i ) );
+      // a slot behind the span has not been consumed yet, or another producer has taken the position
+      full = diff < 0;
+      moved = diff > 0;
+      if ( full || moved )
+        break;
+    }
+    if ( full )
+    {
+      addDropped ( count );
+      return false;
+    }
+    if ( !moved && ArchThreads::compareAndSwap ( enqueue_pos_, pos, pos + count ) )
+      break;
+    pos = loadAcquire ( enqueue_pos_ );
+  }
+  for ( size_t i = 0; i < count; ++i )
+  {
+    Slot &slot = slots_[( pos + i ) & mask_];
+    slot.value_ = data[i];
+    storeRelease ( slot.sequence_, pos + i + 1 );
+  }
+  return true;
 }
 
 template <class T>
 bool RingBuffer<T>::get ( T &c )
 {
-  uint32 new_read_pos = ( read_pos_ + 1 ) % buffer_size_;
-  if ( write_pos_ == new_read_pos ) //nothing new to read
-    return false;
-  c = buffer_[new_read_pos];
-  ArchThreads::testSetLock ( read_pos_,new_read_pos );
+  size_t pos = loadAcquire ( dequeue_pos_ );
+  Slot *slot;
+  while ( true )
+  {
+    slot = &slots_[pos & mask_];
+    ssize_t diff = ( ssize_t ) ( loadAcquire ( slot->sequence_ ) - ( pos + 1 ) );
+    if ( diff < 0 ) //nothing new to read
+      return false;
+    if ( diff == 0 && ArchThreads::compareAndSwap ( dequeue_pos_, pos, pos + 1 ) )
+      break;
+    pos = loadAcquire ( dequeue_pos_ );
+  }
+  c = slot->value_;
+  // the slot is free for the producer of the position one round later
+  storeRelease ( slot->sequence_, pos + mask_ + 1 );
   return true;
 }
 
+template <class T>
+size_t RingBuffer<T>::get ( T *data, size_t max )
+{
+  size_t count = 0;
+  while ( count < max && get ( data[count] ) )
+    ++count;
+  return count;
+}
+
+template <class T>
+void RingBuffer<T>::clear()
+{
+  T c;
+  while ( get ( c ) )
+    ;
+}
+
+template <class T>
+bool RingBuffer<T>::isEmpty()
+{
+  size_t pos = loadAcquire ( dequeue_pos_ );
+  return loadAcquire ( slots_[pos & mask_].sequence_ ) != pos + 1;
+}
+
+template <class T>
+size_t RingBuffer<T>::getDropped()
+{
+  return loadAcquire ( dropped_ );
+}
+
+template <class T>
+void RingBuffer<T>::addDropped ( size_t count )
+{
+  size_t dropped = loadAcquire ( dropped_ );
+  while ( !ArchThreads::compareAndSwap ( dropped_, dropped, dropped + count ) )
+    dropped = loadAcquire ( dropped_ );
+}
@@ -2,6 +2,7 @@
 
 #include "types.h"
 #include "chardev.h"
+#include "RingBuffer.h"
 
 #define MAX_PORTS  16
 
@@ -58,8 +59,16 @@ class SerialPort : public CharacterDevice
      */
     virtual int32 writeData(uint32 offset, uint32 size, const char*buffer);
 
+    /**
+     * the top half of the interrupt, received bytes are only stored until serviceDeferredIRQ runs
+     */
     void irq_handler();
 
+    /**
+     * moves the bytes received by irq_handler into the input buffer
+     */
+    void serviceDeferredIRQ();
+
     /**
      * Returns the Architecture specific data for this serial port.
      * The basic task of any operating system is to hide this ugly data.
@@ -81,6 +90,9 @@ class SerialPort : public CharacterDevice
     size_t WriteLock;
     size_t SerialLock;
 
+    // the input buffer takes a mutex, so the interrupt handler puts the received bytes in here
+    RingBuffer<uint8> received_;
+
   private:
     ArchSerialInfo port_info_;
 
@@ -110,6 +122,11 @@ class SerialManager
     uint32 get_port_number(const uint8* friendly_name);
     void service_irq(uint32 irq_num);
 
+    /**
+     * the bottom half of the serial interrupts, see SoftIrq
+     */
+    void serviceDeferredIRQ();
+
   private:
     uint32 num_ports;
 };
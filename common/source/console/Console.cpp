@@ -4,6 +4,15 @@
 #include "KeyboardManager.h"
 #include "Scheduler.h"
 #include "PageManager.h"
+#include "PageCache.h"
+#include "PageReclaim.h"
+#include "BlockCache.h"
+#include "BDManager.h"
+#include "LockProfiler.h"
+#include "TimerQueue.h"
+#include "SoftIrq.h"
+#include "WorkQueue.h"
+#include "PriorityInheritanceTest.h"
 #include "backtrace.h"
 
 Console* main_console;
@@ -47,13 +56,34 @@ void Console::handleKey(uint32 key)
 // else...
   switch (key)
   {
+    case KEY_F6:
+      PriorityInheritanceTest::start();
+      break;
+
+    case KEY_F7:
+      if (LockProfiler::isEnabled())
+        LockProfiler::disable();
+      else
+        LockProfiler::enable();
+      kprintfd("LockProfiler %s\n", LockProfiler::isEnabled() ? "enabled" : "disabled");
+      break;
+
+    case KEY_F8:
+      LockProfiler::printReport();
+      break;
+
     case KEY_F9:
-      PageManager::instance()->printBitmap();
+      PageManager::instance()->printFreeLists();
       kprintfd("Used kernel memory: %zu\n", KernelMemoryManager::instance()->getUsedKernelMemory(true));
+      PageCache::instance()->printStatistics();
+      PageReclaim::instance()->printStatistics();
+      BlockCache::instance()->printStatistics();
+      BDManager::getInstance()->printStatistics();
       break;
 
     case KEY_F10:
       Scheduler::instance()->printLockingInformation();
+      KernelMemoryManager::instance()->getKMMLock().printStatistics();
       break;
 
     case KEY_F11:
@@ -62,6 +92,10 @@ void Console::handleKey(uint32 key)
 
     case KEY_F12:
       Scheduler::instance()->printThreadList();
+      kprintfd("%zu timer interrupts in %u ticks\n", TimerQueue::instance()->getNumInterrupts(),
+               Scheduler::instance()->getTicks());
+      SoftIrq::printStatistics();
+      WorkQueue::system()->printStatistics();
       break;
 
     case '\b':
@@ -122,7 +156,7 @@ void Console::Run(void)
         handleKey(key);
       }
     }
-    Scheduler::instance()->yield();
+    km->waitForKey();
   } while (1);
 }
 bool Console::isDisplayable(uint32 key)
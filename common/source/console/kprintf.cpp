@@ -6,6 +6,7 @@
 #include "ArchInterrupts.h"
 #include "RingBuffer.h"
 #include "Scheduler.h"
+#include "WorkQueue.h"
 #include "assert.h"
 #include "debug.h"
 #include "ustringformat.h"
@@ -14,67 +15,93 @@
 //the ones following it, when the nosleep buffer gets full
 
 RingBuffer<char> *nosleep_rb_;
-Thread *flush_thread_;
+// the dropped characters which have already been reported
+size_t reported_dropped_ = 0;
 
-void flushActiveConsole()
+static const size_t NOSLEEP_BUFFER_SIZE = 4096;
+// the flushing job writes this many characters to the terminal at once
+static const size_t FLUSH_SPAN = 256;
+// a message is put into the nosleep buffer in spans of this size, so it does not interleave with others
+static const size_t KPRINTF_SPAN = 128;
+
+size_t flushActiveConsole(void* arg __attribute__((unused)))
 {
   assert(main_console);
   assert(nosleep_rb_);
   assert(ArchInterrupts::testIFSet());
-  char c = 0;
-  while (nosleep_rb_->get(c))
+  char buffer[FLUSH_SPAN];
+  size_t length;
+  while ((length = nosleep_rb_->get(buffer, sizeof(buffer))))
+  {
+    main_console->getActiveTerminal()->writeBuffer(buffer, length);
+  }
+  size_t dropped = nosleep_rb_->getDropped();
+  if (dropped != reported_dropped_)
   {
-    main_console->getActiveTerminal()->write(c);
+    kprintf("kprintf: %zu characters dropped, the nosleep buffer was full\n", dropped - reported_dropped_);
+    reported_dropped_ = dropped;
   }
-  Scheduler::instance()->yield();
+  return 0;
 }
 
-class KprintfFlushingThread : public Thread
-{
-  public:
-
-    KprintfFlushingThread() : Thread(0, "KprintfFlushingThread", Thread::KERNEL_THREAD)
-    {
-    }
-
-    virtual void Run()
-    {
-      while (true)
-      {
-        flushActiveConsole();
-      }
-    }
-};
+// submitted to the system work queue whenever something is put into nosleep_rb_
+WorkItem flush_work_(&flushActiveConsole);
 
 void kprintf_init()
 {
-  nosleep_rb_ = new RingBuffer<char>(1024);
-  debug(KPRINTF, "Adding Important kprintf Flush Thread\n");
-  flush_thread_ = new KprintfFlushingThread();
-  Scheduler::instance()->addNewThread(flush_thread_);
+  nosleep_rb_ = new RingBuffer<char>(NOSLEEP_BUFFER_SIZE);
 }
 
-void kprintf_func(int ch, void *arg __attribute__((unused)))
+static bool kprintfCanWriteDirectly()
 {
   //check if atomar or not in current context
-  if ((ArchInterrupts::testIFSet() && Scheduler::instance()->isSchedulingEnabled())
-      || (main_console->areLocksFree() && main_console->getActiveTerminal()->isLockFree()))
+  return (ArchInterrupts::testIFSet() && Scheduler::instance()->isSchedulingEnabled())
+      || (main_console->areLocksFree() && main_console->getActiveTerminal()->isLockFree());
+}
+
+struct KprintfSpan
+{
+  char buffer_[KPRINTF_SPAN];
+  size_t length_;
+  bool direct_;
+};
+
+static void kprintfFlushSpan(KprintfSpan* span)
+{
+  if (!span->length_)
+    return;
+  if (span->direct_)
   {
-    main_console->getActiveTerminal()->write(ch);
+    main_console->getActiveTerminal()->writeBuffer(span->buffer_, span->length_);
   }
   else
   {
-    nosleep_rb_->put(ch);
+    nosleep_rb_->put(span->buffer_, span->length_);
+    WorkQueue::system()->submit(&flush_work_);
   }
+  span->length_ = 0;
+}
+
+static void kprintfSpanFunc(int ch, void *arg)
+{
+  KprintfSpan* span = (KprintfSpan*) arg;
+  span->buffer_[span->length_++] = ch;
+  if (span->length_ == sizeof(span->buffer_))
+    kprintfFlushSpan(span);
 }
 
 void kprintf(const char *fmt, ...)
 {
   va_list args;
+  KprintfSpan span;
+  span.length_ = 0;
+  // decided once, so the message is either written directly or goes through the nosleep buffer as a whole
+  span.direct_ = kprintfCanWriteDirectly();
 
   va_start(args, fmt);
-  kvprintf(fmt, kprintf_func, 0, 10, args);
+  kvprintf(fmt, kprintfSpanFunc, &span, 10, args);
   va_end(args);
+  kprintfFlushSpan(&span);
 }
 
 void kprintfd_func(int ch, void *arg __attribute__((unused)))
@@ -6,6 +6,7 @@
 #include "kprintf.h"
 #include "debug.h"
 #include "kstring.h"
+#include "SoftIrq.h"
 
 BDManager *BDManager::getInstance()
 {
@@ -15,9 +16,15 @@ BDManager *BDManager::getInstance()
 }
 
 
+static void blockDeviceBottomHalf()
+{
+  BDManager::getInstance()->serviceDeferredIRQ();
+}
+
 BDManager::BDManager() :
-    probeIRQ(false)
+    probeIRQ(false), io_scheduler_policy_(IOScheduler::DEADLINE)
 {
+  SoftIrq::setHandler(SoftIrq::BLOCK_DEVICE, "block_device", &blockDeviceBottomHalf);
 }
 
 void BDManager::doDeviceDetection(void)
@@ -59,6 +66,13 @@ void BDManager::serviceIRQ(uint32 irq_num)
   debug(BD_MANAGER, "serviceIRQ:End servicing IRQ\n");
 }
 
+void BDManager::serviceDeferredIRQ()
+{
+  // the partitions of a disk share its driver, the driver only does work for an interrupt once
+  for (BDVirtualDevice* dev : device_list_)
+    dev->getDriver()->serviceDeferredIRQ();
+}
+
 BDVirtualDevice* BDManager::getDeviceByNumber(uint32 dev_num)
 {
   return device_list_[dev_num];
@@ -88,4 +102,28 @@ uint32 BDManager::getNumberOfDevices(void)
   return device_list_.size();
 }
 
+BDVirtualDevice* BDManager::getFirstDeviceOfDriver(BDDriver* driver)
+{
+  for (BDVirtualDevice* dev : device_list_)
+    if (dev->getDriver() == driver)
+      return dev;
+  return 0;
+}
+
+void BDManager::setIOSchedulerPolicy(IOScheduler::POLICY policy)
+{
+  debug(BD_MANAGER, "setIOSchedulerPolicy: %s\n", IOScheduler::getPolicyName(policy));
+  io_scheduler_policy_ = policy;
+  for (BDVirtualDevice* dev : device_list_)
+    if (dev->getDriver()->getIOScheduler() && getFirstDeviceOfDriver(dev->getDriver()) == dev)
+      dev->getDriver()->getIOScheduler()->setPolicy(policy);
+}
+
+void BDManager::printStatistics()
+{
+  for (BDVirtualDevice* dev : device_list_)
+    if (dev->getDriver()->getIOScheduler() && getFirstDeviceOfDriver(dev->getDriver()) == dev)
+      dev->getDriver()->getIOScheduler()->printStatistics(dev->getName());
+}
+
 BDManager* BDManager::instance_ = 0;
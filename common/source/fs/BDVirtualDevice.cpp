@@ -5,6 +5,8 @@
 #include "kstring.h"
 #include "debug.h"
 #include "kprintf.h"
+#include "Scheduler.h"
+#include "Thread.h"
 
 BDVirtualDevice::BDVirtualDevice(BDDriver * driver, uint32 offset, uint32 num_sectors, uint32 sector_size,
                                  const char *name, bool writable) :
@@ -45,7 +47,7 @@ void BDVirtualDevice::addRequest(BDRequest * command)
 }
 
 
-int32 BDVirtualDevice::readData(uint32 offset, uint32 size, char *buffer)
+BDRequest* BDVirtualDevice::submitRead(uint32 offset, uint32 size, char *buffer)
 {
   assert(buffer);
   assert(offset % block_size_ == 0 && "we can only read multiples of block_size_ from the device");
@@ -53,64 +55,62 @@ int32 BDVirtualDevice::readData(uint32 offset, uint32 size, char *buffer)
 
   assert((offset + size <= getNumBlocks() * block_size_) && "tried reading out of range");
 
-  debug(BD_VIRT_DEVICE, "readData\n");
-  uint32 blocks2read = size / block_size_, jiffies = 0;
-  uint32 blockoffset = offset / block_size_;
-
-  debug(BD_VIRT_DEVICE, "blocks2read %d\n", blocks2read);
-  BDRequest bd(dev_number_, BDRequest::BD_READ, blockoffset, blocks2read, buffer);
-  addRequest(&bd);
-
-  if (driver_->irq != 0)
-  {
-    bool interrupt_context = ArchInterrupts::disableInterrupts();
-    ArchInterrupts::enableInterrupts();
-
-    while (bd.getStatus() == BDRequest::BD_QUEUED && jiffies++ < IO_TIMEOUT)
-      ArchInterrupts::yieldIfIFSet();
-
-    if (!interrupt_context)
-      ArchInterrupts::disableInterrupts();
-  }
-
-  if (bd.getStatus() != BDRequest::BD_DONE)
-  {
-    return -1;
-  }
-  return size;
+  debug(BD_VIRT_DEVICE, "submitRead: blocks2read %d\n", size / block_size_);
+  BDRequest* bd = new BDRequest(dev_number_, BDRequest::BD_READ, offset / block_size_, size / block_size_, buffer);
+  addRequest(bd);
+  return bd;
 }
 
-
-int32 BDVirtualDevice::writeData(uint32 offset, uint32 size, char *buffer)
+BDRequest* BDVirtualDevice::submitWrite(uint32 offset, uint32 size, char *buffer)
 {
+  assert(buffer);
   assert(offset % block_size_ == 0 && "we can only write multiples of block_size_ to the device");
   assert(size % block_size_ == 0 && "we can only write multiples of block_size_ to the device");
 
   assert((offset + size <= getNumBlocks() * block_size_) && "tried writing out of range");
 
-  debug(BD_VIRT_DEVICE, "writeData\n");
-  uint32 blocks2write = size / block_size_, jiffies = 0;
-  uint32 blockoffset = offset / block_size_;
-
-  BDRequest bd(dev_number_, BDRequest::BD_WRITE, blockoffset, blocks2write, buffer);
-  addRequest(&bd);
+  debug(BD_VIRT_DEVICE, "submitWrite: blocks2write %d\n", size / block_size_);
+  BDRequest* bd = new BDRequest(dev_number_, BDRequest::BD_WRITE, offset / block_size_, size / block_size_, buffer);
+  addRequest(bd);
+  return bd;
+}
 
-  if (driver_->irq != 0)
+int32 BDVirtualDevice::waitForRequest(BDRequest *request)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  if (currentThread && interrupts_enabled)
   {
-    bool interrupt_context = ArchInterrupts::disableInterrupts();
+    // the driver wakes the waiter from its interrupt handler, so checking the status and going to sleep must not be interrupted
+    while (request->getStatus() == BDRequest::BD_QUEUED)
+      request->getWaitQueue()->sleep();
+  }
+  else
+  {
+    // nobody can be put to sleep before the scheduler runs, but the interrupt still has to come in
     ArchInterrupts::enableInterrupts();
-
-    while (bd.getStatus() == BDRequest::BD_QUEUED && jiffies++ < IO_TIMEOUT)
+    while (request->getStatus() == BDRequest::BD_QUEUED)
       ArchInterrupts::yieldIfIFSet();
-
-    if (!interrupt_context)
-      ArchInterrupts::disableInterrupts();
+    ArchInterrupts::disableInterrupts();
   }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
 
-  if (bd.getStatus() != BDRequest::BD_DONE)
-    return -1;
-  else
-    return size;
+  int32 result = (request->getStatus() == BDRequest::BD_DONE) ? (int32) (request->getNumBlocks() * sector_size_) : -1;
+  delete request;
+  return result;
+}
+
+int32 BDVirtualDevice::readData(uint32 offset, uint32 size, char *buffer)
+{
+  debug(BD_VIRT_DEVICE, "readData\n");
+  return waitForRequest(submitRead(offset, size, buffer));
+}
+
+
+int32 BDVirtualDevice::writeData(uint32 offset, uint32 size, char *buffer)
+{
+  debug(BD_VIRT_DEVICE, "writeData\n");
+  return waitForRequest(submitWrite(offset, size, buffer));
 }
 
 
@@ -0,0 +1,404 @@
+#include "BlockCache.h"
+#include "BDVirtualDevice.h"
+#include "BDManager.h"
+#include "Scheduler.h"
+#include "TimerQueue.h"
+#include "Thread.h"
+#include "kstring.h"
+#include "kprintf.h"
+#include "assert.h"
+#include "debug.h"
+
+BlockCache* BlockCache::instance_ = 0;
+
+class BlockCacheWritebackThread : public Thread
+{
+  public:
+    BlockCacheWritebackThread() : Thread(0, "BlockCacheWritebackThread", Thread::KERNEL_THREAD)
+    {
+    }
+
+    virtual void Run()
+    {
+      while (true)
+      {
+        TimerQueue::instance()->nanosleep(BlockCache::WRITEBACK_INTERVAL * TimerQueue::NS_PER_TICK);
+        BlockCache::instance()->flush(0);
+      }
+    }
+};
+
+BlockCache* BlockCache::instance()
+{
+  if (unlikely(!instance_))
+    instance_ = new BlockCache();
+  return instance_;
+}
+
+BlockCache::BlockCache() :
+    lock_("BlockCache::lock_"), io_done_(&lock_, "BlockCache::io_done_"), lru_head_(0), lru_tail_(0), pinned_(0),
+    write_generation_(0), hits_(0), misses_(0), writebacks_(0), evictions_(0)
+{
+  memset(entries_, 0, sizeof(entries_));
+  memset(hash_buckets_, 0, sizeof(hash_buckets_));
+  for (BlockCacheEntry& entry : entries_)
+    lruPushFront(&entry);
+  writeback_thread_ = new BlockCacheWritebackThread();
+  Scheduler::instance()->addNewThread(writeback_thread_);
+}
+
+size_t BlockCache::hash(BDVirtualDevice* device, uint32 block)
+{
+  return (device->getDeviceNumber() * 31 + block) % NUM_HASH_BUCKETS;
+}
+
+void BlockCache::lruRemove(BlockCacheEntry* entry)
+{
+  if (entry->lru_prev_)
+    entry->lru_prev_->lru_next_ = entry->lru_next_;
+  else
+    lru_head_ = entry->lru_next_;
+  if (entry->lru_next_)
+    entry->lru_next_->lru_prev_ = entry->lru_prev_;
+  else
+    lru_tail_ = entry->lru_prev_;
+  entry->lru_prev_ = 0;
+  entry->lru_next_ = 0;
+}
+
+void BlockCache::lruPushFront(BlockCacheEntry* entry)
+{
+  entry->lru_prev_ = 0;
+  entry->lru_next_ = lru_head_;
+  if (lru_head_)
+    lru_head_->lru_prev_ = entry;
+  else
+    lru_tail_ = entry;
+  lru_head_ = entry;
+}
+
+void BlockCache::hashRemove(BlockCacheEntry* entry)
+{
+  BlockCacheEntry** link = &hash_buckets_[hash(entry->device_, entry->block_)];
+  while (*link != entry)
+  {
+    assert(*link && "block cache entry is missing in the hash index");
+    link = &(*link)->hash_next_;
+  }
+  *link = entry->hash_next_;
+  entry->hash_next_ = 0;
+}
+
+BlockCacheEntry* BlockCache::lookup(BDVirtualDevice* device, uint32 block)
+{
+  for (BlockCacheEntry* entry = hash_buckets_[hash(device, block)]; entry; entry = entry->hash_next_)
+  {
+    if (entry->device_ == device && entry->block_ == block)
+      return entry;
+  }
+  return 0;
+}
+
+bool BlockCache::isPinned(BDVirtualDevice* device, uint32 block, uint32 num_blocks, bool writes_only)
+{
+  for (PinnedRange* range = pinned_; range; range = range->next_)
+  {
+    if (range->device_ == device && (range->write_ || !writes_only) && block < range->block_ + range->num_blocks_ &&
+        range->block_ < block + num_blocks)
+      return true;
+  }
+  return false;
+}
+
+bool BlockCache::isBusy(BDVirtualDevice* device, uint32 block, uint32 num_blocks)
+{
+  for (uint32 i = 0; i < num_blocks; ++i)
+  {
+    BlockCacheEntry* entry = lookup(device, block + i);
+    if (entry && entry->busy_)
+      return true;
+  }
+  return false;
+}
+
+void BlockCache::pin(PinnedRange* range)
+{
+  assert(lock_.isHeldBy(currentThread));
+  range->next_ = pinned_;
+  pinned_ = range;
+}
+
+void BlockCache::unpin(PinnedRange* range)
+{
+  assert(lock_.isHeldBy(currentThread));
+  PinnedRange** link = &pinned_;
+  while (*link != range)
+    link = &(*link)->next_;
+  *link = range->next_;
+  io_done_.broadcast();
+}
+
+BlockCacheEntry* BlockCache::findVictim()
+{
+  for (BlockCacheEntry* entry = lru_tail_; entry; entry = entry->lru_prev_)
+  {
+    if (!entry->busy_ && !(entry->valid_ && isPinned(entry->device_, entry->block_, 1, false)))
+      return entry;
+  }
+  return 0;
+}
+
+bool BlockCache::writeBackEntry(BlockCacheEntry* entry)
+{
+  assert(lock_.isHeldBy(currentThread));
+  assert(entry->valid_ && entry->dirty_ && !entry->busy_);
+  size_t generation = entry->generation_;
+  entry->busy_ = true;
+  lock_.release();
+
+  debug(BLOCK_CACHE, "writing back block %u of device %s\n", entry->block_, entry->device_->getName());
+  bool success = entry->device_->writeData(entry->block_ * entry->size_, entry->size_, entry->data_) >= 0;
+
+  lock_.acquire();
+  finishWriteBack(entry, generation, success);
+  return success;
+}
+
+void BlockCache::finishWriteBack(BlockCacheEntry* entry, size_t generation, bool success)
+{
+  assert(lock_.isHeldBy(currentThread));
+  if (!success)
+    debug(BLOCK_CACHE, "ERROR: writing block %u of device %s failed\n", entry->block_, entry->device_->getName());
+  else if (entry->generation_ == generation)
+    entry->dirty_ = false;
+  entry->busy_ = false;
+  ++writebacks_;
+  io_done_.broadcast();
+}
+
+BlockCacheEntry* BlockCache::getEntry(BDVirtualDevice* device, uint32 block, bool fill)
+{
+  assert(lock_.isHeldBy(currentThread));
+  BlockCacheEntry* entry;
+  while (true)
+  {
+    entry = lookup(device, block);
+    if (entry && entry->valid_)
+    {
+      ++hits_;
+      lruRemove(entry);
+      lruPushFront(entry);
+      return entry;
+    }
+
+    // wait if another thread is filling the entry, writeBlocks is changing the block on the device,
+    // or every entry is busy or pinned
+    if (!entry)
+      entry = findVictim();
+    else
+      entry = 0;
+    if (!entry || isPinned(device, block, 1, true))
+    {
+      io_done_.wait();
+      continue;
+    }
+    if (!entry->valid_ || !entry->dirty_)
+      break;
+    // the lock is dropped for the write, so everything has to be looked up again afterwards.
+    // A victim which cannot be written is moved out of the way.
+    if (!writeBackEntry(entry))
+    {
+      lruRemove(entry);
+      lruPushFront(entry);
+    }
+  }
+
+  ++misses_;
+  if (entry->valid_)
+  {
+    ++evictions_;
+    hashRemove(entry);
+  }
+  uint32 block_size = device->getBlockSize();
+  if (entry->size_ != block_size)
+  {
+    delete[] entry->data_;
+    entry->data_ = new char[block_size];
+    entry->size_ = block_size;
+  }
+  entry->device_ = device;
+  entry->block_ = block;
+  entry->valid_ = false;
+  entry->dirty_ = false;
+  BlockCacheEntry** bucket = &hash_buckets_[hash(device, block)];
+  entry->hash_next_ = *bucket;
+  *bucket = entry;
+  lruRemove(entry);
+  lruPushFront(entry);
+
+  if (fill)
+  {
+    // the entry is in the index already, so other threads wait for it instead of reading the block as well
+    entry->busy_ = true;
+    lock_.release();
+    if (device->readData(block * block_size, block_size, entry->data_) < 0)
+    {
+      debug(BLOCK_CACHE, "ERROR: reading block %u of device %s failed\n", block, device->getName());
+      memset(entry->data_, 0, block_size);
+    }
+    lock_.acquire();
+    entry->busy_ = false;
+    io_done_.broadcast();
+  }
+  entry->valid_ = true;
+  return entry;
+}
+
+void BlockCache::read(BDVirtualDevice* device, uint32 block, uint32 offset, uint32 size, char* buffer)
+{
+  assert(device && buffer);
+  assert(offset + size <= device->getBlockSize());
+  ScopeLock l(lock_);
+  BlockCacheEntry* entry = getEntry(device, block, true);
+  memcpy(buffer, entry->data_ + offset, size);
+}
+
+void BlockCache::write(BDVirtualDevice* device, uint32 block, uint32 offset, uint32 size, const char* buffer)
+{
+  assert(device && buffer);
+  assert(offset + size <= device->getBlockSize());
+  ScopeLock l(lock_);
+  // a block which is overwritten completely does not have to be read first
+  BlockCacheEntry* entry = getEntry(device, block, offset != 0 || size != device->getBlockSize());
+  memcpy(entry->data_ + offset, buffer, size);
+  entry->dirty_ = true;
+  entry->generation_ = ++write_generation_;
+}
+
+int32 BlockCache::readBlocks(BDVirtualDevice* device, uint32 block, uint32 num_blocks, char* buffer)
+{
+  assert(device && buffer);
+  uint32 block_size = device->getBlockSize();
+  PinnedRange range = { device, block, num_blocks, false, 0 };
+  ScopeLock l(lock_);
+  while (isPinned(device, block, num_blocks, true))
+    io_done_.wait();
+  // cached blocks of the range are not evicted until the read is done, a write back finishing in the meantime
+  // would make the device newer than the buffer, but not the cache
+  pin(&range);
+  lock_.release();
+  int32 result = device->readData(block * block_size, num_blocks * block_size, buffer);
+  lock_.acquire();
+  for (uint32 i = 0; i < num_blocks; ++i)
+  {
+    BlockCacheEntry* entry = lookup(device, block + i);
+    if (entry && entry->valid_)
+      memcpy(buffer + i * block_size, entry->data_, block_size);
+  }
+  unpin(&range);
+  return result;
+}
+
+int32 BlockCache::writeBlocks(BDVirtualDevice* device, uint32 block, uint32 num_blocks, const char* buffer)
+{
+  assert(device && buffer);
+  uint32 block_size = device->getBlockSize();
+  PinnedRange range = { device, block, num_blocks, true, 0 };
+  ScopeLock l(lock_);
+  // another request or a write back of the range could reach the disk after this one
+  while (isPinned(device, block, num_blocks, false) || isBusy(device, block, num_blocks))
+    io_done_.wait();
+  pin(&range);
+  // the cached copies stay dirty until the device has the data, they are not written back or evicted before
+  size_t generation = ++write_generation_;
+  for (uint32 i = 0; i < num_blocks; ++i)
+  {
+    BlockCacheEntry* entry = lookup(device, block + i);
+    if (entry)
+    {
+      memcpy(entry->data_, buffer + i * block_size, block_size);
+      entry->dirty_ = true;
+      entry->generation_ = generation;
+    }
+  }
+  lock_.release();
+  int32 result = device->writeData(block * block_size, num_blocks * block_size, (char*) buffer);
+  lock_.acquire();
+  if (result >= 0)
+  {
+    for (uint32 i = 0; i < num_blocks; ++i)
+    {
+      BlockCacheEntry* entry = lookup(device, block + i);
+      if (entry && entry->generation_ == generation)
+        entry->dirty_ = false;
+    }
+  }
+  unpin(&range);
+  return result;
+}
+
+void BlockCache::flush(BDVirtualDevice* device)
+{
+  // a batch of dirty blocks is queued at the driver before waiting, so the disk does not idle between two blocks.
+  // The batch is collected with lock_ held and marked busy, lock_ is dropped for the writes.
+  BlockCacheEntry* entries[FLUSH_BATCH_SIZE];
+  size_t generations[FLUSH_BATCH_SIZE];
+  BDRequest* requests[FLUSH_BATCH_SIZE];
+  ScopeLock l(lock_);
+  size_t next = 0;
+  while (true)
+  {
+    size_t num_queued = 0;
+    for (; next < NUM_ENTRIES && num_queued < FLUSH_BATCH_SIZE; ++next)
+    {
+      BlockCacheEntry& entry = entries_[next];
+      if (!entry.valid_ || !entry.dirty_ || entry.busy_ || (device && entry.device_ != device) ||
+          isPinned(entry.device_, entry.block_, 1, true))
+        continue;
+      entry.busy_ = true;
+      entries[num_queued] = &entry;
+      generations[num_queued++] = entry.generation_;
+    }
+    if (num_queued == 0)
+      break;
+
+    lock_.release();
+    for (size_t i = 0; i < num_queued; ++i)
+    {
+      debug(BLOCK_CACHE, "writing back block %u of device %s\n", entries[i]->block_, entries[i]->device_->getName());
+      requests[i] = entries[i]->device_->submitWrite(entries[i]->block_ * entries[i]->size_, entries[i]->size_,
+                                                     entries[i]->data_);
+    }
+    bool success[FLUSH_BATCH_SIZE];
+    for (size_t i = 0; i < num_queued; ++i)
+      success[i] = entries[i]->device_->waitForRequest(requests[i]) >= 0;
+    lock_.acquire();
+    for (size_t i = 0; i < num_queued; ++i)
+      finishWriteBack(entries[i], generations[i], success[i]);
+  }
+
+  // blocks which another thread is writing back are not on the device before its write is done
+  for (size_t i = 0; i < NUM_ENTRIES;)
+  {
+    BlockCacheEntry& entry = entries_[i];
+    if (entry.valid_ && entry.busy_ && (!device || entry.device_ == device))
+    {
+      io_done_.wait();
+      i = 0;
+    }
+    else
+      ++i;
+  }
+}
+
+void BlockCache::printStatistics()
+{
+  size_t num_valid = 0, num_dirty = 0;
+  for (BlockCacheEntry& entry : entries_)
+  {
+    num_valid += entry.valid_;
+    num_dirty += entry.dirty_;
+  }
+  kprintfd("BlockCache: %zu of %zu blocks cached, %zu dirty\n", num_valid, NUM_ENTRIES, num_dirty);
+  kprintfd("BlockCache: %zu hits, %zu misses, %zu evictions, %zu writebacks\n", hits_, misses_, evictions_, writebacks_);
+}
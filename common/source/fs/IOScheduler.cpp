@@ -0,0 +1,228 @@
+#include "IOScheduler.h"
+#include "BDRequest.h"
+#include "Scheduler.h"
+#include "Mutex.h"
+#include "Thread.h"
+#include "kprintf.h"
+#include "assert.h"
+#include "debug.h"
+
+IOScheduler::IOScheduler(POLICY policy, uint32 max_merged_blocks, Mutex& lock) :
+    policy_(policy), max_merged_blocks_(max_merged_blocks), lock_(lock), next_sector_(0), writes_starved_(0), num_requests_(0),
+    num_merges_(0), num_dispatches_(0), depth_(0), max_depth_(0), depth_sum_(0)
+{
+  for (size_t i = 0; i < NUM_LISTS; ++i)
+  {
+    heads_[i] = 0;
+    tails_[i] = 0;
+  }
+}
+
+const char* IOScheduler::getPolicyName(POLICY policy)
+{
+  return policy == NOOP ? "noop" : "deadline";
+}
+
+size_t IOScheduler::listOf(BDRequest* request)
+{
+  if (policy_ == NOOP)
+    return READ_LIST;
+  return request->getCmd() == BDRequest::BD_READ ? READ_LIST : WRITE_LIST;
+}
+
+void IOScheduler::setPolicy(POLICY policy)
+{
+  ScopeLock lock(lock_);
+  // the pending chains are collected in their current order and inserted again
+  BDRequest* chains = 0;
+  BDRequest* chains_tail = 0;
+  for (size_t i = 0; i < NUM_LISTS; ++i)
+  {
+    while (BDRequest* chain = heads_[i])
+    {
+      remove(chain);
+      if (chains_tail)
+        chains_tail->sched_next_ = chain;
+      else
+        chains = chain;
+      chains_tail = chain;
+    }
+  }
+  policy_ = policy;
+  while (BDRequest* chain = chains)
+  {
+    chains = chain->sched_next_;
+    insert(chain);
+  }
+}
+
+void IOScheduler::insert(BDRequest* chain)
+{
+  size_t list = listOf(chain);
+  BDRequest* before = 0;
+  if (policy_ == DEADLINE)
+  {
+    before = heads_[list];
+    while (before && before->getStartBlock() <= chain->getStartBlock())
+      before = before->sched_next_;
+  }
+  chain->sched_next_ = before;
+  chain->sched_prev_ = before ? before->sched_prev_ : tails_[list];
+  if (chain->sched_prev_)
+    chain->sched_prev_->sched_next_ = chain;
+  else
+    heads_[list] = chain;
+  if (before)
+    before->sched_prev_ = chain;
+  else
+    tails_[list] = chain;
+}
+
+void IOScheduler::remove(BDRequest* chain)
+{
+  size_t list = listOf(chain);
+  if (chain->sched_prev_)
+    chain->sched_prev_->sched_next_ = chain->sched_next_;
+  else
+    heads_[list] = chain->sched_next_;
+  if (chain->sched_next_)
+    chain->sched_next_->sched_prev_ = chain->sched_prev_;
+  else
+    tails_[list] = chain->sched_prev_;
+  chain->sched_next_ = 0;
+  chain->sched_prev_ = 0;
+}
+
+bool IOScheduler::tryMerge(BDRequest* request)
+{
+  for (BDRequest* chain = heads_[listOf(request)]; chain; chain = chain->sched_next_)
+  {
+    if (chain->getCmd() != request->getCmd() ||
+        chain->merged_blocks_ + request->getNumBlocks() > max_merged_blocks_)
+      continue;
+
+    if (chain->getStartBlock() + chain->merged_blocks_ == request->getStartBlock())
+    {
+      debug(IO_SCHEDULER, "back merge of sector %u into the chain at sector %u\n", request->getStartBlock(),
+            chain->getStartBlock());
+      chain->merge_tail_->merge_next_ = request;
+      chain->merge_tail_ = request;
+      chain->merged_blocks_ += request->getNumBlocks();
+      return true;
+    }
+
+    if (request->getStartBlock() + request->getNumBlocks() == chain->getStartBlock())
+    {
+      debug(IO_SCHEDULER, "front merge of sector %u into the chain at sector %u\n", request->getStartBlock(),
+            chain->getStartBlock());
+      // the request takes the place of the chain, it keeps the older deadline
+      request->merge_next_ = chain;
+      request->merge_tail_ = chain->merge_tail_;
+      request->merged_blocks_ = request->getNumBlocks() + chain->merged_blocks_;
+      request->queued_at_ = chain->queued_at_;
+      request->sched_prev_ = chain->sched_prev_;
+      request->sched_next_ = chain->sched_next_;
+      size_t list = listOf(chain);
+      if (request->sched_prev_)
+        request->sched_prev_->sched_next_ = request;
+      else
+        heads_[list] = request;
+      if (request->sched_next_)
+        request->sched_next_->sched_prev_ = request;
+      else
+        tails_[list] = request;
+      chain->sched_next_ = 0;
+      chain->sched_prev_ = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void IOScheduler::add(BDRequest* request)
+{
+  assert(lock_.isHeldBy(currentThread) || system_state != RUNNING);
+  assert(request->getCmd() == BDRequest::BD_READ || request->getCmd() == BDRequest::BD_WRITE);
+  request->merge_next_ = 0;
+  request->merge_tail_ = request;
+  request->merged_blocks_ = request->getNumBlocks();
+  request->queued_at_ = Scheduler::instance()->getTicks();
+
+  ++num_requests_;
+  depth_sum_ += depth_;
+  if (++depth_ > max_depth_)
+    max_depth_ = depth_;
+
+  if (tryMerge(request))
+    ++num_merges_;
+  else
+    insert(request);
+}
+
+BDRequest* IOScheduler::oldest(size_t list)
+{
+  BDRequest* oldest = heads_[list];
+  for (BDRequest* chain = oldest; chain; chain = chain->sched_next_)
+  {
+    if ((int32) (chain->queued_at_ - oldest->queued_at_) < 0)
+      oldest = chain;
+  }
+  return oldest;
+}
+
+BDRequest* IOScheduler::next()
+{
+  assert(lock_.isHeldBy(currentThread) || system_state != RUNNING);
+  BDRequest* chain = 0;
+  if (policy_ == NOOP)
+  {
+    chain = heads_[READ_LIST];
+  }
+  else
+  {
+    // a request which has waited for too long is served first, reads before writes
+    uint32 now = Scheduler::instance()->getTicks();
+    BDRequest* oldest_read = oldest(READ_LIST);
+    BDRequest* oldest_write = oldest(WRITE_LIST);
+    if (oldest_read && now - oldest_read->queued_at_ >= READ_EXPIRE)
+      chain = oldest_read;
+    else if (oldest_write && now - oldest_write->queued_at_ >= WRITE_EXPIRE)
+      chain = oldest_write;
+
+    if (!chain)
+    {
+      size_t list = (heads_[READ_LIST] && (!heads_[WRITE_LIST] || writes_starved_ < WRITES_STARVED)) ? READ_LIST :
+                                                                                                        WRITE_LIST;
+      // one way elevator: the first chain behind the last position, or the lowest one
+      for (chain = heads_[list]; chain && chain->getStartBlock() < next_sector_; chain = chain->sched_next_)
+        ;
+      if (!chain)
+        chain = heads_[list];
+    }
+
+    if (chain && listOf(chain) == READ_LIST && heads_[WRITE_LIST])
+      ++writes_starved_;
+    else if (chain && listOf(chain) == WRITE_LIST)
+      writes_starved_ = 0;
+  }
+
+  if (!chain)
+    return 0;
+
+  remove(chain);
+  next_sector_ = chain->getStartBlock() + chain->merged_blocks_;
+  ++num_dispatches_;
+  for (BDRequest* request = chain; request; request = request->merge_next_)
+    --depth_;
+  debug(IO_SCHEDULER, "dispatching %u sectors at sector %u\n", chain->merged_blocks_, chain->getStartBlock());
+  return chain;
+}
+
+void IOScheduler::printStatistics(const char* name)
+{
+  kprintfd("IOScheduler %s (%s): %zu requests in %zu commands, %zu merged (%zu%%)\n", name, getPolicyName(policy_),
+           num_requests_, num_dispatches_, num_merges_, num_requests_ ? (100 * num_merges_) / num_requests_ : 0);
+  kprintfd("IOScheduler %s: queue depth %zu, max %zu, average %zu.%02zu\n", name, depth_, max_depth_,
+           num_requests_ ? depth_sum_ / num_requests_ : 0,
+           num_requests_ ? ((100 * depth_sum_) / num_requests_) % 100 : 0);
+}
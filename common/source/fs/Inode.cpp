@@ -2,6 +2,9 @@
 #include "Superblock.h"
 #include "FileSystemType.h"
 #include "File.h"
+#ifndef EXE2MINIXFS
+#include "PageCache.h"
+#endif
 
 Inode::Inode(Superblock *superblock, uint32 inode_type) :
     i_dentrys_(),
@@ -12,7 +15,8 @@ Inode::Inode(Superblock *superblock, uint32 inode_type) :
     i_size_(0),
     i_type_(inode_type),
     i_state_(I_UNUSED),
-    i_mode_((A_READABLE ^ A_WRITABLE) ^ A_EXECABLE)
+    i_mode_((A_READABLE ^ A_WRITABLE) ^ A_EXECABLE),
+    i_cached_pages_(0)
 {
 }
 
@@ -23,6 +27,9 @@ Inode::~Inode()
         debug(INODE, "~Inode %s %p refcount: %u\n", getSuperblock()->getFSType()->getFSName(), this, numRefs());
     }
     assert(numRefs() == 0);
+#ifndef EXE2MINIXFS
+    PageCache::instance()->invalidate(this);
+#endif
 }
 
 uint32 Inode::incRefCount()
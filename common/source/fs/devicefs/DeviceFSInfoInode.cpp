@@ -0,0 +1,44 @@
+#include "fs/devicefs/DeviceFSInfoInode.h"
+#include "kstring.h"
+#include "ustringformat.h"
+#include "assert.h"
+
+#include "console/kprintf.h"
+
+DeviceFSInfoInode::DeviceFSInfoInode(Superblock* super_block, Generator generator, size_t max_size) :
+    RamFSInode(super_block, I_FILE), generator_(generator), max_size_(max_size), lock_("DeviceFSInfoInode::lock_")
+{
+  assert(generator);
+  delete[] data_;
+  data_ = new char[max_size];
+  i_size_ = 0;
+  i_mode_ = A_READABLE;
+}
+
+int32 DeviceFSInfoInode::readData(uint32 offset, uint32 size, char *buffer)
+{
+  ScopeLock lock(lock_);
+  if (offset == 0)
+    i_size_ = generator_(data_, max_size_);
+  return RamFSInode::readData(offset, size, buffer);
+}
+
+int32 DeviceFSInfoInode::writeData(uint32 offset __attribute__((unused)), uint32 size __attribute__((unused)),
+                                   const char *buffer __attribute__((unused)))
+{
+  return -1;
+}
+
+void DeviceFSInfoInode::append(char*& buffer, size_t& remaining, const char* format, ...)
+{
+  if (remaining <= 1)
+    return;
+  va_list args;
+  va_start(args, format);
+  size_t length = vsnprintf(buffer, remaining, format, args);
+  va_end(args);
+  if (length >= remaining)
+    length = remaining - 1;
+  buffer += length;
+  remaining -= length;
+}
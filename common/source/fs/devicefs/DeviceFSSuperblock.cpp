@@ -5,6 +5,12 @@
 #include "fs/Inode.h"
 #include "fs/File.h"
 #include "fs/FileDescriptor.h"
+#include "fs/devicefs/DeviceFSInfoInode.h"
+#include "LockProfiler.h"
+#include "Scheduler.h"
+#include "SoftIrq.h"
+#include "PageCache.h"
+#include "PageReclaim.h"
 
 #include "console/kprintf.h"
 
@@ -22,6 +28,11 @@ DeviceFSSuperBlock* DeviceFSSuperBlock::instance_ = 0;
 DeviceFSSuperBlock::DeviceFSSuperBlock(DeviceFSType* fs_type, uint32 s_dev) :
     RamFSSuperblock(fs_type, s_dev)
 {
+  addInfoFile(new DeviceFSInfoInode(this, &LockProfiler::writeReport, 8192), "lockstat");
+  addInfoFile(new DeviceFSInfoInode(this, &Scheduler::writeStatistics, 8192), "sched");
+  addInfoFile(new DeviceFSInfoInode(this, &SoftIrq::writeStatistics, 1024), "softirq");
+  addInfoFile(new DeviceFSInfoInode(this, &PageCache::writeStatistics, 512), "pagecache");
+  addInfoFile(new DeviceFSInfoInode(this, &PageReclaim::writeStatistics, 512), "swap");
 }
 
 DeviceFSSuperBlock::~DeviceFSSuperBlock()
@@ -39,6 +50,15 @@ void DeviceFSSuperBlock::addDevice(Inode* device_inode, const char* node_name)
   all_inodes_.push_back(device_inode);
 }
 
+void DeviceFSSuperBlock::addInfoFile(Inode* inode, const char* node_name)
+{
+  assert(inode->getType() == I_FILE);
+  Dentry* dentry = new Dentry(inode, s_root_, node_name);
+
+  assert(inode->mkfile(dentry) == 0);
+  all_inodes_.push_back(inode);
+}
+
 DeviceFSSuperBlock* DeviceFSSuperBlock::getInstance()
 {
     if (!instance_)
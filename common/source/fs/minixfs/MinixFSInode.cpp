@@ -1,6 +1,7 @@
 #include "MinixFSInode.h"
 #ifndef EXE2MINIXFS
 #include "kstring.h"
+#include "PageCache.h"
 #endif
 #include <assert.h>
 #include "MinixFSSuperblock.h"
@@ -60,23 +61,49 @@ int32 MinixFSInode::readData(uint32 offset, uint32 size, char *buffer)
     else
       size = i_size_ - offset;
   }
-  uint32 start_zone = offset / ZONE_SIZE;
-  uint32 zone_offset = offset % ZONE_SIZE;
-  uint32 num_zones = (zone_offset + size) / ZONE_SIZE + 1;
-  char rbuffer[ZONE_SIZE];
+  if (size == 0)
+    return 0;
 
+  MinixFSSuperblock* sb = (MinixFSSuperblock*) superblock_;
+  uint32 first_zone = offset / ZONE_SIZE;
+  uint32 last_zone = (offset + size - 1) / ZONE_SIZE;
   uint32 index = 0;
-  debug(M_INODE, "readData: zone: %d, zone_offset %d, num_zones: %d\n", start_zone, zone_offset, num_zones);
-  for (uint32 zone = start_zone; zone < start_zone + num_zones; zone++)
+  debug(M_INODE, "readData: first zone: %d, last zone: %d\n", first_zone, last_zone);
+  for (uint32 zone = first_zone; zone <= last_zone;)
   {
-    memset(rbuffer, 0, sizeof(rbuffer));
-    ((MinixFSSuperblock *) superblock_)->readZone(i_zones_->getZone(zone), rbuffer);
+    uint32 zone_offset = (zone == first_zone) ? offset % ZONE_SIZE : 0;
     uint32 count = size - index;
-    uint32 zone_diff = ZONE_SIZE - zone_offset;
-    count = count < zone_diff ? count : zone_diff;
-    memcpy(buffer + index, rbuffer + zone_offset, count);
-    index += count;
-    zone_offset = 0;
+    if (count > ZONE_SIZE - zone_offset)
+      count = ZONE_SIZE - zone_offset;
+    uint32 disk_zone = i_zones_->getZone(zone);
+    if (disk_zone == 0)
+    {
+      // zone 0 marks a hole in the file
+      memset(buffer + index, 0, count);
+      index += count;
+      ++zone;
+      continue;
+    }
+    if (count < ZONE_SIZE)
+    {
+      // partial head or tail zone
+      char zone_buffer[ZONE_SIZE];
+      sb->readZone(disk_zone, zone_buffer);
+      memcpy(buffer + index, zone_buffer + zone_offset, count);
+      index += count;
+      ++zone;
+      continue;
+    }
+
+    // full zones are read straight into the caller's buffer, as long as they are contiguous on disk
+    uint32 run_length = 1;
+    while (zone + run_length <= last_zone && size - index >= (run_length + 1) * ZONE_SIZE &&
+           i_zones_->getZone(zone + run_length) == disk_zone + run_length)
+      ++run_length;
+    debug(M_INODE, "readData: reading %d zones starting at zone %d (disk zone %d)\n", run_length, zone, disk_zone);
+    sb->readBlocks(disk_zone, run_length * ZONE_SIZE / BLOCK_SIZE, buffer + index);
+    index += run_length * ZONE_SIZE;
+    zone += run_length;
   }
   return size;
 }
@@ -84,19 +111,20 @@ int32 MinixFSInode::readData(uint32 offset, uint32 size, char *buffer)
 int32 MinixFSInode::writeData(uint32 offset, uint32 size, const char *buffer)
 {
   debug(M_INODE, "MinixFSInode writeData> offset: %d, size: %d, i_size_: %d\n", offset, size, i_size_);
-  uint32 zone = offset / ZONE_SIZE;
-  uint32 num_zones = (offset % ZONE_SIZE + size) / ZONE_SIZE + 1;
-  
-  if (num_zones*ZONE_SIZE < size) return -1;
+  if (size == 0)
+    return 0;
 
+#ifndef EXE2MINIXFS
+  // pages of the file shared through the page cache would be stale after the write
+  PageCache::instance()->invalidate(this);
+#endif
+  MinixFSSuperblock* sb = (MinixFSSuperblock*) superblock_;
   uint32 last_used_zone = i_size_ / ZONE_SIZE;
-  uint32 last_zone = last_used_zone;
   if ((size + offset) > i_size_)
   {
     uint32 num_new_zones = (size + offset - i_size_) / ZONE_SIZE + 1;
-    for (uint32 new_zones = 0; new_zones < num_new_zones; new_zones++, last_zone++)
+    for (uint32 new_zones = 0; new_zones < num_new_zones; new_zones++)
     {
-      MinixFSSuperblock* sb = (MinixFSSuperblock*) superblock_;
       debug(M_INODE, "writeData: allocating new Zone\n");
       uint16 new_zone = sb->allocateZone();
       i_zones_->setZone(i_zones_->getNumZones(), new_zone);
@@ -111,40 +139,56 @@ int32 MinixFSInode::writeData(uint32 offset, uint32 size, const char *buffer)
     if (zone_size_offset)
     {
       readData(i_size_ - zone_size_offset, zone_size_offset, fill_buffer);
-      ((MinixFSSuperblock *) superblock_)->writeZone(last_used_zone, fill_buffer);
-    }
-    ++last_used_zone;
-    for (; last_used_zone <= offset / ZONE_SIZE; last_used_zone++)
-    {
+      sb->writeZone(i_zones_->getZone(last_used_zone), fill_buffer);
       memset(fill_buffer, 0, sizeof(fill_buffer));
-      ((MinixFSSuperblock *) superblock_)->writeZone(last_used_zone, fill_buffer);
+      ++last_used_zone;
     }
-    --last_used_zone;
+    for (; last_used_zone <= offset / ZONE_SIZE; last_used_zone++)
+      sb->writeZone(i_zones_->getZone(last_used_zone), fill_buffer);
     i_size_ = offset;
   }
-  uint32 zone_offset = offset % ZONE_SIZE;
-  char* wbuffer_array = new char[num_zones * ZONE_SIZE];
-  char* wbuffer = wbuffer_array;
-  memset((void*) wbuffer, 0, num_zones * ZONE_SIZE);
-  debug(M_INODE, "writeData: reading data at the beginning of zone: offset-zone_offset: %d,zone_offset: %d\n",
-        offset - zone_offset, zone_offset);
-  readData(offset - zone_offset, num_zones * ZONE_SIZE, wbuffer);
-  for (uint32 index = 0, pos = zone_offset; index < size; pos++, index++)
-  {
-    wbuffer[pos] = buffer[index];
-  }
-  for (uint32 zone_index = 0; zone_index < num_zones; zone_index++)
+
+  uint32 first_zone = offset / ZONE_SIZE;
+  uint32 last_zone = (offset + size - 1) / ZONE_SIZE;
+  uint32 index = 0;
+  for (uint32 zone = first_zone; zone <= last_zone;)
   {
-    debug(M_INODE, "writeData: writing zone_index: %d, i_zones_->getZone(zone) : %d\n", zone_index,
-          i_zones_->getZone(zone));
-    ((MinixFSSuperblock *) superblock_)->writeZone(i_zones_->getZone(zone_index + zone), wbuffer);
-    wbuffer += ZONE_SIZE;
+    uint32 zone_offset = (zone == first_zone) ? offset % ZONE_SIZE : 0;
+    uint32 count = size - index;
+    if (count > ZONE_SIZE - zone_offset)
+      count = ZONE_SIZE - zone_offset;
+    if (count < ZONE_SIZE)
+    {
+      // partial head or tail zone, the rest of it has to be preserved
+      char zone_buffer[ZONE_SIZE];
+      if (zone * ZONE_SIZE < i_size_)
+        sb->readZone(i_zones_->getZone(zone), zone_buffer);
+      else
+        memset(zone_buffer, 0, sizeof(zone_buffer));
+      memcpy(zone_buffer + zone_offset, buffer + index, count);
+      debug(M_INODE, "writeData: writing partial zone %d (disk zone %d)\n", zone, i_zones_->getZone(zone));
+      sb->writeZone(i_zones_->getZone(zone), zone_buffer);
+      index += count;
+      ++zone;
+      continue;
+    }
+
+    // full zones are written straight from the caller's buffer, as long as they are contiguous on disk
+    uint32 disk_zone = i_zones_->getZone(zone);
+    uint32 run_length = 1;
+    while (zone + run_length <= last_zone && size - index >= (run_length + 1) * ZONE_SIZE &&
+           i_zones_->getZone(zone + run_length) == disk_zone + run_length)
+      ++run_length;
+    debug(M_INODE, "writeData: writing %d zones starting at zone %d (disk zone %d)\n", run_length, zone, disk_zone);
+    sb->writeBlocks(disk_zone, run_length * ZONE_SIZE / BLOCK_SIZE, buffer + index);
+    index += run_length * ZONE_SIZE;
+    zone += run_length;
   }
+
   if (i_size_ < offset + size)
   {
     i_size_ = offset + size;
   }
-  delete[] wbuffer_array;
   return size;
 }
 
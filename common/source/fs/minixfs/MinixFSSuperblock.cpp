@@ -12,6 +12,7 @@
 #include "kstring.h"
 #include "BDManager.h"
 #include "BDVirtualDevice.h"
+#include "BlockCache.h"
 #endif
 
 #define ROOT_NAME "/"
@@ -153,6 +154,10 @@ MinixFSSuperblock::~MinixFSSuperblock()
 
   delete storage_manager_;
 
+#ifndef EXE2MINIXFS
+  BlockCache::instance()->flush(BDManager::getInstance()->getDeviceByNumber(s_dev_));
+#endif
+
   debug(M_SB, "~MinixSuperblock finished\n");
 }
 
@@ -300,7 +305,10 @@ void MinixFSSuperblock::readBlocks(uint16 block, uint32 num_blocks, char* buffer
   assert(fread(buffer, 1, BLOCK_SIZE * num_blocks, (FILE*)s_dev_) == BLOCK_SIZE * num_blocks);
 #else
   BDVirtualDevice* bdvd = BDManager::getInstance()->getDeviceByNumber(s_dev_);
-  bdvd->readData(block * bdvd->getBlockSize(), num_blocks * bdvd->getBlockSize(), buffer);
+  if (num_blocks == 1)
+    BlockCache::instance()->read(bdvd, block, 0, BLOCK_SIZE, buffer);
+  else
+    BlockCache::instance()->readBlocks(bdvd, block, num_blocks, buffer);
 #endif
 }
 
@@ -309,33 +317,45 @@ void MinixFSSuperblock::writeZone(uint16 zone, char* buffer)
   writeBlocks(zone, ZONE_SIZE / BLOCK_SIZE, buffer);
 }
 
-void MinixFSSuperblock::writeBlocks(uint16 block, uint32 num_blocks, char* buffer)
+void MinixFSSuperblock::writeBlocks(uint16 block, uint32 num_blocks, const char* buffer)
 {
 #ifdef EXE2MINIXFS
   fseek((FILE*)s_dev_, offset_ + block * BLOCK_SIZE, SEEK_SET);
   assert(fwrite(buffer, 1, BLOCK_SIZE * num_blocks, (FILE*)s_dev_) == BLOCK_SIZE * num_blocks);
 #else
   BDVirtualDevice* bdvd = BDManager::getInstance()->getDeviceByNumber(s_dev_);
-  bdvd->writeData(block * bdvd->getBlockSize(), num_blocks * bdvd->getBlockSize(), buffer);
+  if (num_blocks == 1)
+    BlockCache::instance()->write(bdvd, block, 0, BLOCK_SIZE, buffer);
+  else
+    BlockCache::instance()->writeBlocks(bdvd, block, num_blocks, buffer);
 #endif
 }
 
 int32 MinixFSSuperblock::readBytes(uint32 block, uint32 offset, uint32 size, char* buffer)
 {
   assert(offset+size <= BLOCK_SIZE);
+#ifdef EXE2MINIXFS
   char rbuffer[BLOCK_SIZE];
   readBlocks(block, 1, rbuffer);
-  memcpy(rbuffer + offset, buffer, size);
+  memcpy(buffer, rbuffer + offset, size);
+#else
+  BlockCache::instance()->read(BDManager::getInstance()->getDeviceByNumber(s_dev_), block, offset, size, buffer);
+#endif
   return size;
 }
 
 int32 MinixFSSuperblock::writeBytes(uint32 block, uint32 offset, uint32 size, char* buffer)
 {
   assert(offset+size <= BLOCK_SIZE);
+#ifdef EXE2MINIXFS
   char wbuffer[BLOCK_SIZE];
   readBlocks(block, 1, wbuffer);
   memcpy(wbuffer + offset, buffer, size);
   writeBlocks(block, 1, wbuffer);
+#else
+  // only the cached copy is modified, so repeated inode updates end up in a single device write
+  BlockCache::instance()->write(BDManager::getInstance()->getDeviceByNumber(s_dev_), block, offset, size, buffer);
+#endif
   return size;
 }
 
@@ -5,6 +5,7 @@
 #include "fs/ramfs/RamFSFile.h"
 #include "fs/Dentry.h"
 #include "FileSystemType.h"
+#include "mm/PageCache.h"
 
 #include "console/kprintf.h"
 
@@ -51,6 +52,7 @@ int32 RamFSInode::writeData(uint32 offset, uint32 size, const char *buffer)
     return 0;
   }
 
+  PageCache::instance()->invalidate(this);
   uint32 write_size = Min(size, getSize() - offset);
   if(write_size != size)
   {
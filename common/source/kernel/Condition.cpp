@@ -85,25 +85,13 @@ void Condition::signal(pointer called_by, bool broadcast)
 
   assert(mutex_->isHeldBy(currentThread));
   checkInterrupts("Condition::signal");
-  do
-  {
-    lockWaitersList();
-    last_accessed_at_ = called_by;
-    Thread* thread_to_be_woken_up = popBackThreadFromWaitersList();
-    unlockWaitersList();
-
-    if(thread_to_be_woken_up)
-    {
-      //debug(LOCK, "Condition: Thread %s (%p) being signaled for condition %s (%p).\n",
-      //      thread_to_be_woken_up->getName(), thread_to_be_woken_up, getName(), this);
-
-      Scheduler::instance()->wake(thread_to_be_woken_up);
-    }
-    else
-    {
-      break;
-    }
-  } while (broadcast);
+  lockWaitersList();
+  last_accessed_at_ = called_by;
+  if(broadcast)
+    waiters_.wakeAll();
+  else
+    waiters_.wakeOne();
+  unlockWaitersList();
 }
 
 void Condition::broadcast(pointer called_by)
@@ -1,6 +1,7 @@
 #include "IdleThread.h"
 #include "Scheduler.h"
 #include "ArchCommon.h"
+#include "ArchInterrupts.h"
 
 IdleThread::IdleThread() : Thread(0, "IdleThread", Thread::KERNEL_THREAD)
 {
@@ -8,20 +9,14 @@ IdleThread::IdleThread() : Thread(0, "IdleThread", Thread::KERNEL_THREAD)
 
 void IdleThread::Run()
 {
-  uint32 last_ticks = 0;
-  uint32 new_ticks = 0;
   while (1)
   {
-    new_ticks = Scheduler::instance()->getTicks();
-    if (new_ticks == last_ticks)
-    {
-      last_ticks = new_ticks + 1;
+    // a thread woken up between the check and halting the cpu would have to wait for the next interrupt,
+    // which may be far away without the periodic tick, so idle() enables interrupts and halts atomically
+    ArchInterrupts::disableInterrupts();
+    if (!Scheduler::instance()->threadsReady())
       ArchCommon::idle();
-    }
-    else
-    {
-      last_ticks = new_ticks;
-      Scheduler::instance()->yield();
-    }
+    ArchInterrupts::enableInterrupts();
+    Scheduler::instance()->yield();
   }
 }
@@ -14,13 +14,32 @@
 #include <umemory.h>
 #include "File.h"
 #include "FileDescriptor.h"
+#include "Inode.h"
+#include "PageCache.h"
 
-Loader::Loader(ssize_t fd) : fd_(fd), hdr_(0), phdrs_(), program_binary_lock_("Loader::program_binary_lock_"), userspace_debug_info_(0)
+Loader::Loader(ssize_t fd) : fd_(fd), hdr_(0), phdrs_(), program_binary_lock_("Loader::program_binary_lock_"), userspace_debug_info_(0),
+    inode_(0), fault_around_pages_(MIN_FAULT_AROUND_PAGES), last_window_end_(0), num_faults_(0), num_pages_loaded_(0),
+    num_pages_shared_(0)
 {
+  FileDescriptor* file_descriptor = VfsSyscall::getFileDescriptor(fd);
+  if(file_descriptor)
+    inode_ = file_descriptor->getFile()->getInode();
+}
+
+Loader::Loader(const Loader& parent, ssize_t fd) : fd_(fd), hdr_(new Elf::Ehdr(*parent.hdr_)), phdrs_(parent.phdrs_),
+    program_binary_lock_("Loader::program_binary_lock_"), userspace_debug_info_(0), inode_(0),
+    fault_around_pages_(MIN_FAULT_AROUND_PAGES), last_window_end_(0), num_faults_(0), num_pages_loaded_(0),
+    num_pages_shared_(0)
+{
+  FileDescriptor* file_descriptor = VfsSyscall::getFileDescriptor(fd);
+  if(file_descriptor)
+    inode_ = file_descriptor->getFile()->getInode();
 }
 
 Loader::~Loader()
 {
+  debug(LOADER, "Loader: %zu page faults loaded %zu pages, %zu of them shared\n", num_faults_, num_pages_loaded_,
+        num_pages_shared_);
   delete userspace_debug_info_;
   delete hdr_;
   userspace_debug_info_ = nullptr;
@@ -31,57 +50,223 @@ void Loader::loadPage(pointer virtual_address)
 {
   debug(LOADER, "Loader:loadPage: Request to load the page for address %p.\n", (void*)virtual_address);
   const pointer virt_page_start_addr = virtual_address & ~(PAGE_SIZE - 1);
-  const pointer virt_page_end_addr = virt_page_start_addr + PAGE_SIZE;
-  bool found_page_content = false;
-  // get a new page for the mapping
-  size_t ppn = PageManager::instance()->allocPPN();
 
   program_binary_lock_.acquire();
 
+  const Elf::Phdr* segment = findSegment(virt_page_start_addr);
+  if(!segment)
+  {
+    program_binary_lock_.release();
+    debug(LOADER, "Loader::loadPage: ERROR! No section refers to the given address.\n");
+    Syscall::exit(666);
+  }
+
+  size_t num_pages = faultAroundPages(virt_page_start_addr, *segment);
+  if(pageShareable(virt_page_start_addr, *segment))
+  {
+    bool loaded = loadSharedPages(*segment, virt_page_start_addr, num_pages);
+    program_binary_lock_.release();
+    if(!loaded)
+    {
+      debug(LOADER, "ERROR! Some parts of the content could not be loaded from the binary.\n");
+      Syscall::exit(999);
+    }
+    return;
+  }
+
+  // get new pages for the mapping, a single one if there is no free block large enough
+  size_t ppn = (num_pages > 1) ? PageManager::instance()->allocPPN(num_pages * PAGE_SIZE, true) : 0;
+  if(!ppn)
+  {
+    num_pages = 1;
+    ppn = PageManager::instance()->allocPPN();
+  }
+  last_window_end_ = virt_page_start_addr + num_pages * PAGE_SIZE;
+  ++num_faults_;
+  num_pages_loaded_ += num_pages;
+
+  bool loaded;
+  if(pageInSegment(virt_page_start_addr, *segment))
+    loaded = loadSegmentPages(*segment, virt_page_start_addr, num_pages, ppn);
+  else
+    loaded = loadMixedPage(virt_page_start_addr, ppn) &&
+             (num_pages == 1 || loadSegmentPages(*segment, virt_page_start_addr + PAGE_SIZE, num_pages - 1, ppn + 1));
+  program_binary_lock_.release();
+
+  if(!loaded)
+  {
+    for(size_t i = 0; i < num_pages; ++i)
+      PageManager::instance()->freePPN(ppn + i);
+    debug(LOADER, "ERROR! Some parts of the content could not be loaded from the binary.\n");
+    Syscall::exit(999);
+  }
+
+  for(size_t i = 0; i < num_pages; ++i)
+  {
+    // as long as the process does not write to it, the page reclaim can drop the page and it is loaded again
+    PageManager::instance()->setFlags(ppn + i, PageFrame::FILE_BACKED);
+    bool page_mapped = arch_memory_.mapPage(virt_page_start_addr / PAGE_SIZE + i, ppn + i, true, true);
+    if (!page_mapped)
+    {
+      debug(LOADER, "Loader::loadPage: The page has been mapped by someone else.\n");
+      PageManager::instance()->freePPN(ppn + i);
+    }
+  }
+  debug(LOADER, "Loader::loadPage: Load request for address %p has been successfully finished, %zu pages loaded.\n",
+        (void*)virtual_address, num_pages);
+}
+
+const Elf::Phdr* Loader::findSegment(pointer page)
+{
+  const Elf::Phdr* segment = 0;
+  for(const Elf::Phdr& phdr : phdrs_)
+  {
+    if(phdr.p_vaddr < page + PAGE_SIZE && phdr.p_vaddr + phdr.p_memsz > page &&
+       (!segment || phdr.p_vaddr + phdr.p_memsz > segment->p_vaddr + segment->p_memsz))
+      segment = &phdr;
+  }
+  return segment;
+}
+
+bool Loader::pageInSegment(pointer page, const Elf::Phdr& segment)
+{
+  return page >= segment.p_vaddr && page + PAGE_SIZE <= segment.p_vaddr + segment.p_memsz;
+}
+
+size_t Loader::faultAroundPages(pointer page, const Elf::Phdr& segment)
+{
+  // a fault shortly behind the last window means the binary is walked through, so the window grows
+  if(page >= last_window_end_ && page < last_window_end_ + fault_around_pages_ * PAGE_SIZE)
+  {
+    if(fault_around_pages_ < MAX_FAULT_AROUND_PAGES)
+      fault_around_pages_ *= 2;
+  }
+  else if(fault_around_pages_ > MIN_FAULT_AROUND_PAGES)
+  {
+    fault_around_pages_ /= 2;
+  }
+
+  size_t num_pages = 1;
+  while(num_pages < fault_around_pages_)
+  {
+    pointer next_page = page + num_pages * PAGE_SIZE;
+    if(!pageInSegment(next_page, segment) || arch_memory_.checkAddressValid(next_page))
+      break;
+    ++num_pages;
+  }
+  return num_pages;
+}
+
+bool Loader::loadMixedPage(pointer page, size_t ppn)
+{
+  const pointer virt_page_start_addr = page;
+  const pointer virt_page_end_addr = virt_page_start_addr + PAGE_SIZE;
+
   // Iterate through all sections and load the ones intersecting into the page.
   for(ustl::list<Elf::Phdr>::iterator it = phdrs_.begin(); it != phdrs_.end(); it++)
   {
-    if((*it).p_vaddr < virt_page_end_addr)
+    if((*it).p_vaddr < virt_page_end_addr && (*it).p_vaddr + (*it).p_filesz > virt_page_start_addr)
     {
-      if((*it).p_vaddr + (*it).p_filesz > virt_page_start_addr)
-      {
-        const pointer  virt_start_addr = ustl::max(virt_page_start_addr, (*it).p_vaddr);
-        const size_t   virt_offs_on_page = virt_start_addr - virt_page_start_addr;
-        const l_off_t  bin_start_addr = (*it).p_offset + (virt_start_addr - (*it).p_vaddr);
-        const size_t   bytes_to_load = ustl::min(virt_page_end_addr, (*it).p_vaddr + (*it).p_filesz) - virt_start_addr;
-        //debug(LOADER, "Loader::loadPage: Loading %d bytes from binary address %p to virtual address %p\n",
-        //      bytes_to_load, bin_start_addr, virt_start_addr);
-        if(readFromBinary((char *)ArchMemory::getIdentAddressOfPPN(ppn) + virt_offs_on_page, bin_start_addr, bytes_to_load))
-        {
-          program_binary_lock_.release();
-          PageManager::instance()->freePPN(ppn);
-          debug(LOADER, "ERROR! Some parts of the content could not be loaded from the binary.\n");
-          Syscall::exit(999);
-        }
-        found_page_content = true;
-      }
-      else if((*it).p_vaddr + (*it).p_memsz > virt_page_start_addr)
-      {
-        found_page_content = true;
-      }
+      const pointer  virt_start_addr = ustl::max(virt_page_start_addr, (*it).p_vaddr);
+      const size_t   virt_offs_on_page = virt_start_addr - virt_page_start_addr;
+      const l_off_t  bin_start_addr = (*it).p_offset + (virt_start_addr - (*it).p_vaddr);
+      const size_t   bytes_to_load = ustl::min(virt_page_end_addr, (*it).p_vaddr + (*it).p_filesz) - virt_start_addr;
+      //debug(LOADER, "Loader::loadPage: Loading %d bytes from binary address %p to virtual address %p\n",
+      //      bytes_to_load, bin_start_addr, virt_start_addr);
+      if(readFromBinary((char *)ArchMemory::getIdentAddressOfPPN(ppn) + virt_offs_on_page, bin_start_addr, bytes_to_load))
+        return false;
     }
   }
-  program_binary_lock_.release();
+  return true;
+}
+
+bool Loader::loadSegmentPages(const Elf::Phdr& segment, pointer first_page, size_t num_pages, size_t first_ppn)
+{
+  // the page frames are consecutive, so the part backed by the file is read at once, the rest stays zeroed
+  const pointer end = first_page + num_pages * PAGE_SIZE;
+  const pointer file_end = segment.p_vaddr + segment.p_filesz;
+  if(first_page >= file_end)
+    return true;
+  const size_t bytes_to_load = ustl::min(end, file_end) - first_page;
+  return !readFromBinary((char *)ArchMemory::getIdentAddressOfPPN(first_ppn),
+                         segment.p_offset + (first_page - segment.p_vaddr), bytes_to_load);
+}
 
-  if(!found_page_content)
+bool Loader::pageShareable(pointer page, const Elf::Phdr& segment)
+{
+  // the page has to show the same bytes of the file in every process, and none of them may change
+  if(!inode_ || (segment.p_flags & Elf::PF_W) || (segment.p_vaddr - segment.p_offset) % PAGE_SIZE)
+    return false;
+  const pointer file_end = segment.p_vaddr + segment.p_filesz;
+  // behind the end of the file part of the page the file goes on, the segment may expect zeroes there
+  if(page < segment.p_vaddr || page >= file_end ||
+     (page + PAGE_SIZE > file_end && segment.p_memsz != segment.p_filesz))
+    return false;
+  for(const Elf::Phdr& phdr : phdrs_)
   {
-    PageManager::instance()->freePPN(ppn);
-    debug(LOADER, "Loader::loadPage: ERROR! No section refers to the given address.\n");
-    Syscall::exit(666);
+    if(&phdr != &segment && phdr.p_vaddr < page + PAGE_SIZE && phdr.p_vaddr + phdr.p_memsz > page)
+      return false;
+  }
+  return true;
+}
+
+bool Loader::loadSharedPages(const Elf::Phdr& segment, pointer first_page, size_t max_pages)
+{
+  PageCache* cache = PageCache::instance();
+  const size_t first_index = (segment.p_offset + (first_page - segment.p_vaddr)) / PAGE_SIZE;
+  size_t num_pages = 1;
+  while(num_pages < max_pages && pageShareable(first_page + num_pages * PAGE_SIZE, segment))
+    ++num_pages;
+
+  // map the run of pages which are cached, or read the run of pages which are not at once and cache them
+  size_t ppns[MAX_FAULT_AROUND_PAGES];
+  size_t num_mapped = 0;
+  ppns[0] = cache->get(inode_, first_index);
+  if(ppns[0])
+  {
+    num_mapped = 1;
+    while(num_mapped < num_pages && (ppns[num_mapped] = cache->get(inode_, first_index + num_mapped)))
+      ++num_mapped;
+  }
+  else
+  {
+    num_mapped = 1;
+    while(num_mapped < num_pages && !cache->contains(inode_, first_index + num_mapped))
+      ++num_mapped;
+    size_t ppn = (num_mapped > 1) ? PageManager::instance()->allocPPN(num_mapped * PAGE_SIZE, true) : 0;
+    if(!ppn)
+    {
+      num_mapped = 1;
+      ppn = PageManager::instance()->allocPPN();
+    }
+    // the whole pages of the file are cached, so every segment sharing a page finds the same contents
+    const l_off_t position = first_index * PAGE_SIZE;
+    const size_t file_size = inode_->getSize();
+    const size_t bytes_to_load = ustl::min(num_mapped * PAGE_SIZE, file_size - (size_t)position);
+    if(readFromBinary((char *)ArchMemory::getIdentAddressOfPPN(ppn), position, bytes_to_load))
+    {
+      for(size_t i = 0; i < num_mapped; ++i)
+        PageManager::instance()->freePPN(ppn + i);
+      return false;
+    }
+    for(size_t i = 0; i < num_mapped; ++i)
+      ppns[i] = cache->insert(inode_, first_index + i, ppn + i);
   }
 
-  bool page_mapped = arch_memory_.mapPage(virt_page_start_addr / PAGE_SIZE, ppn, true);
-  if (!page_mapped)
+  for(size_t i = 0; i < num_mapped; ++i)
   {
-    debug(LOADER, "Loader::loadPage: The page has been mapped by someone else.\n");
-    PageManager::instance()->freePPN(ppn);
+    bool page_mapped = arch_memory_.mapPage(first_page / PAGE_SIZE + i, ppns[i], true, false);
+    if (!page_mapped)
+    {
+      debug(LOADER, "Loader::loadSharedPages: The page has been mapped by someone else.\n");
+      PageManager::instance()->freePPN(ppns[i]);
+    }
   }
-  debug(LOADER, "Loader::loadPage: Load request for address %p has been successfully finished.\n", (void*)virtual_address);
+  last_window_end_ = first_page + num_mapped * PAGE_SIZE;
+  ++num_faults_;
+  num_pages_loaded_ += num_mapped;
+  num_pages_shared_ += num_mapped;
+  return true;
 }
 
 bool Loader::readFromBinary (char* buffer, l_off_t position, size_t length)
@@ -12,18 +12,22 @@ Lock::Lock(const char *name) :
   held_by_(0),
   next_lock_on_holding_list_(0),
   last_accessed_at_(0),
+  profile_acquired_at_(0),
+  profile_called_by_(0),
   name_(name ? name : ""),
-  waiters_list_(0),
-  waiters_list_lock_(0)
+  waiters_list_lock_(0),
+  waiters_list_interrupts_enabled_(false)
 {
 }
 
 Lock::~Lock()
 {
+  if(unlikely(LockProfiler::hasRecords()))
+    LockProfiler::forgetLock(this);
   if(unlikely(system_state != RUNNING))
     return;
   // copy the pointers to the stack because it may be reseted before printing the element out.
-  Thread* waiter = waiters_list_;
+  Thread* waiter = waiters_.first();
   Thread* held_by = held_by_;
   if(waiter)
   {
@@ -44,9 +48,9 @@ Lock::~Lock()
 
 void Lock::printWaitersList()
 {
-  debug(LOCK, "Threads waiting for lock %s (%p), newest thread waiting first:\n", name_, this);
+  debug(LOCK, "Threads waiting for lock %s (%p), longest waiting thread first:\n", name_, this);
   size_t count = 0;
-  for(Thread* thread = waiters_list_; thread != 0; thread = thread->next_thread_in_lock_waiters_list_)
+  for(Thread* thread = waiters_.first(); thread != 0; thread = thread->next_thread_in_lock_waiters_list_)
   {
     kprintfd("%zu: %s (%p)\n", ++count, thread->getName(), thread);
   }
@@ -178,7 +182,7 @@ void Lock::checkForCircularDeadLock(Thread* thread_waiting, Lock* start)
       printOutCircularDeadLock(thread_waiting);
       assert(false);
     }
-    for(Thread* thread_waiting = lock->waiters_list_; thread_waiting != 0;
+    for(Thread* thread_waiting = lock->waiters_.first(); thread_waiting != 0;
         thread_waiting = thread_waiting->next_thread_in_lock_waiters_list_)
     {
       // The method has to be called recursively, so it is possible to check indirect
@@ -232,58 +236,29 @@ void Lock::checkInterrupts(const char* method)
 
 void Lock::lockWaitersList()
 {
-  // The waiters list lock is a simple spinlock.
-  // Just wait until the holding thread is releasing the lock,
-  // and acquire it. These steps have to be atomic.
+  // The waiters list lock is a simple spinlock, its holder runs with interrupts disabled.
+  // On a single cpu it can therefore never be contended, the waiting loop is only there for safety.
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
   while(ArchThreads::testSetLock(waiters_list_lock_, 1))
   {
-    Scheduler::instance()->yield();
+    ArchInterrupts::yieldIfIFSet();
   }
+  waiters_list_interrupts_enabled_ = interrupts_enabled;
 }
 
 void Lock::unlockWaitersList()
 {
+  bool interrupts_enabled = waiters_list_interrupts_enabled_;
   waiters_list_lock_ = 0;
+  if(interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
 }
 
-void Lock::pushFrontCurrentThreadToWaitersList()
+void Lock::pushBackCurrentThreadToWaitersList()
 {
   assert(currentThread);
   assert(waitersListIsLocked());
-  currentThread->next_thread_in_lock_waiters_list_ = waiters_list_;
-  // the following set has to be atomic
-  // waiters_list_ = currentThread;
-  ArchThreads::atomic_set((pointer&)(waiters_list_), (pointer)(currentThread));
-}
-
-Thread* Lock::popBackThreadFromWaitersList()
-{
-  assert(waitersListIsLocked());
-  Thread* thread = 0;
-  if(waiters_list_ == 0)
-  {
-    // the waiters list is empty
-  }
-  else if(waiters_list_->next_thread_in_lock_waiters_list_ == 0)
-  {
-    // this thread is the only one in the waiters list
-    thread = waiters_list_;
-    ArchThreads::atomic_set((pointer&)(waiters_list_), (pointer)(0));
-    waiters_list_ = 0;
-  }
-  else
-  {
-    // there is more than one thread in the waiters list
-    // search for the thread before the last thread in the list
-    Thread* previos;
-    for(previos = waiters_list_; previos->next_thread_in_lock_waiters_list_->next_thread_in_lock_waiters_list_ != 0;
-        previos = previos->next_thread_in_lock_waiters_list_);
-
-    thread = previos->next_thread_in_lock_waiters_list_;
-    // remove the last element
-    ArchThreads::atomic_set((pointer&)(previos->next_thread_in_lock_waiters_list_), (pointer)(0));
-  }
-  return thread;
+  waiters_.pushBack(currentThread);
 }
 
 void Lock::removeCurrentThreadFromWaitersList()
@@ -291,29 +266,8 @@ void Lock::removeCurrentThreadFromWaitersList()
   if(!currentThread)
     return;
   assert(waitersListIsLocked());
-  assert(waiters_list_);
-  if(currentThread == waiters_list_)
-  {
-    // the current thread is the first element
-    ArchThreads::atomic_set((pointer&)(waiters_list_), (pointer)(currentThread->next_thread_in_lock_waiters_list_));
-  }
-  else
-  {
-
-    for(Thread* thread = waiters_list_; thread->next_thread_in_lock_waiters_list_ != 0;
-        thread = thread->next_thread_in_lock_waiters_list_)
-    {
-      if(thread->next_thread_in_lock_waiters_list_ == currentThread)
-      {
-
-        ArchThreads::atomic_set((pointer&)(thread->next_thread_in_lock_waiters_list_),
-                                (pointer)(currentThread->next_thread_in_lock_waiters_list_));
-        break;
-      }
-    }
-  }
-  ArchThreads::atomic_set((pointer&)(currentThread->next_thread_in_lock_waiters_list_ ), (pointer)0);
-  return;
+  assert(!waiters_.empty());
+  waiters_.remove(currentThread);
 }
 
 void Lock::checkInvalidRelease(const char* method)
@@ -332,12 +286,61 @@ void Lock::checkInvalidRelease(const char* method)
   }
 }
 
+void Lock::recordAcquired(pointer called_by, bool contended, uint64 wait_start)
+{
+  uint64 now = ArchCommon::getTimestamp();
+  // profiling may have been enabled while the thread was waiting
+  LockProfiler::recordAcquire(this, called_by, contended, wait_start ? now - wait_start : 0);
+  profile_acquired_at_ = now;
+  profile_called_by_ = called_by;
+}
+
+void Lock::recordRelease()
+{
+  if(LockProfiler::isEnabled())
+    LockProfiler::recordRelease(this, profile_called_by_, ArchCommon::getTimestamp() - profile_acquired_at_);
+  profile_acquired_at_ = 0;
+}
+
 void Lock::sleepAndRelease ()
 {
+  assert(waitersListIsLocked());
+  assert(waiters_list_interrupts_enabled_ && "the waiters list has to be locked with interrupts enabled before sleeping");
   currentThread->lock_waiting_on_ = this;
-  pushFrontCurrentThreadToWaitersList();
-  unlockWaitersList();
-  // we can risk to go to sleep after the list has been unlocked,
-  // because the thread waking this thread waits until it goes to sleep
-  Scheduler::instance()->sleep();
+  boostHolders();
+  // the list lock is released only after the thread is marked as sleeping,
+  // so the thread waking this one always finds it asleep
+  waiters_.sleep(&waiters_list_lock_);
+  ArchInterrupts::enableInterrupts();
+}
+
+void Lock::boostHolders()
+{
+  assert(!ArchInterrupts::testIFSet());
+  size_t priority = currentThread->getPriority();
+  // the deadlock check before waiting guarantees that the chain ends
+  for(Lock* lock = this; lock != 0 && lock->held_by_ != 0; lock = lock->held_by_->lock_waiting_on_)
+  {
+    Thread* holder = lock->held_by_;
+    if(holder->getPriority() >= priority)
+      break;
+    debug(LOCK, "Lock::boostHolders: %s (%p) inherits priority %zu from %s (%p) via %s (%p)\n", holder->getName(),
+          holder, priority, currentThread->getName(), currentThread, lock->getName(), lock);
+    holder->inheritPriority(priority);
+  }
+}
+
+size_t Lock::highestWaiterPriority(Thread* thread)
+{
+  assert(!ArchInterrupts::testIFSet());
+  size_t priority = 0;
+  for(Lock* lock = thread->holding_lock_list_; lock != 0; lock = lock->next_lock_on_holding_list_)
+  {
+    for(Thread* waiter = lock->waiters_.first(); waiter != 0; waiter = waiter->next_thread_in_lock_waiters_list_)
+    {
+      if(waiter->getPriority() > priority)
+        priority = waiter->getPriority();
+    }
+  }
+  return priority;
 }
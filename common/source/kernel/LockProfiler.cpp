@@ -0,0 +1,198 @@
+#include "LockProfiler.h"
+#include "Lock.h"
+#include "ArchInterrupts.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "fs/devicefs/DeviceFSInfoInode.h"
+#include "Stabs2DebugInfo.h"
+extern Stabs2DebugInfo const* kernel_debug_info;
+
+// marks a slot of a lock which has been destroyed, the probe sequences have to continue behind it
+static const pointer FORGOTTEN = (pointer) -1;
+
+bool LockProfiler::enabled_ = false;
+bool LockProfiler::has_records_ = false;
+size_t LockProfiler::dropped_ = 0;
+LockProfiler::Entry LockProfiler::locks_[LockProfiler::MAX_LOCKS];
+LockProfiler::Entry LockProfiler::call_sites_[LockProfiler::MAX_CALL_SITES];
+
+void LockProfiler::enable()
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  memset(locks_, 0, sizeof(locks_));
+  memset(call_sites_, 0, sizeof(call_sites_));
+  dropped_ = 0;
+  has_records_ = true;
+  enabled_ = true;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void LockProfiler::disable()
+{
+  enabled_ = false;
+}
+
+LockProfiler::Entry* LockProfiler::find(Entry* table, size_t size, pointer key, bool create)
+{
+  size_t start = (key >> 4) % size;
+  for (size_t i = 0; i < size; ++i)
+  {
+    Entry* entry = &table[(start + i) % size];
+    if (entry->key_ == key)
+      return entry;
+    if (entry->key_ == 0)
+    {
+      if (!create)
+        return 0;
+      entry->key_ = key;
+      return entry;
+    }
+  }
+  return 0;
+}
+
+void LockProfiler::recordAcquire(Lock* lock, pointer called_by, bool contended, uint64 wait)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  Entry* entries[] = { find(locks_, MAX_LOCKS, (pointer) lock, true),
+                       find(call_sites_, MAX_CALL_SITES, called_by, true) };
+  for (Entry* entry : entries)
+  {
+    if (!entry)
+    {
+      ++dropped_;
+      continue;
+    }
+    entry->name_ = lock->getName();
+    ++entry->acquisitions_;
+    if (contended)
+      ++entry->contended_;
+    entry->wait_total_ += wait;
+    if (wait > entry->wait_max_)
+      entry->wait_max_ = wait;
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void LockProfiler::recordRelease(Lock* lock, pointer called_by, uint64 hold)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  Entry* entries[] = { find(locks_, MAX_LOCKS, (pointer) lock, false),
+                       find(call_sites_, MAX_CALL_SITES, called_by, false) };
+  for (Entry* entry : entries)
+  {
+    if (!entry)
+      continue;
+    entry->hold_total_ += hold;
+    if (hold > entry->hold_max_)
+      entry->hold_max_ = hold;
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void LockProfiler::forgetLock(Lock* lock)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  Entry* entry = find(locks_, MAX_LOCKS, (pointer) lock, false);
+  if (entry)
+  {
+    memset(entry, 0, sizeof(*entry));
+    entry->key_ = FORGOTTEN;
+  }
+  // the call sites may still point to the name of the lock
+  for (size_t i = 0; i < MAX_CALL_SITES; ++i)
+  {
+    if (call_sites_[i].name_ == lock->getName())
+      call_sites_[i].name_ = 0;
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+size_t LockProfiler::sortByWait(Entry* table, size_t size, Entry** sorted, size_t max)
+{
+  size_t num = 0;
+  for (size_t i = 0; i < size; ++i)
+  {
+    Entry* entry = &table[i];
+    if (entry->key_ == 0 || entry->key_ == FORGOTTEN)
+      continue;
+    // insertion sort, only the first max entries are kept
+    size_t pos = num < max ? num++ : max;
+    while (pos > 0 && sorted[pos - 1]->wait_total_ < entry->wait_total_)
+    {
+      if (pos < max)
+        sorted[pos] = sorted[pos - 1];
+      --pos;
+    }
+    if (pos < max)
+      sorted[pos] = entry;
+  }
+  return num;
+}
+
+void LockProfiler::printReport()
+{
+  Entry* sorted[REPORT_ENTRIES];
+  kprintfd("LockProfiler: %s, %zu records dropped, times in timestamp units\n", enabled_ ? "enabled" : "disabled",
+           dropped_);
+  kprintfd("%-32s %10s %10s %14s %12s %14s %12s\n", "lock", "acquires", "contended", "wait total", "wait max",
+           "hold total", "hold max");
+  size_t num = sortByWait(locks_, MAX_LOCKS, sorted, REPORT_ENTRIES);
+  for (size_t i = 0; i < num; ++i)
+  {
+    Entry* e = sorted[i];
+    kprintfd("%-32.32s %10zu %10zu %14llu %12llu %14llu %12llu\n", e->name_ ? e->name_ : "?", e->acquisitions_,
+             e->contended_, (unsigned long long) e->wait_total_, (unsigned long long) e->wait_max_,
+             (unsigned long long) e->hold_total_, (unsigned long long) e->hold_max_);
+  }
+  kprintfd("call sites with the longest wait:\n");
+  num = sortByWait(call_sites_, MAX_CALL_SITES, sorted, REPORT_ENTRIES);
+  for (size_t i = 0; i < num; ++i)
+  {
+    Entry* e = sorted[i];
+    kprintfd("%-32.32s %10zu %10zu %14llu %12llu %14llu %12llu\n", e->name_ ? e->name_ : "?", e->acquisitions_,
+             e->contended_, (unsigned long long) e->wait_total_, (unsigned long long) e->wait_max_,
+             (unsigned long long) e->hold_total_, (unsigned long long) e->hold_max_);
+    if (kernel_debug_info)
+      kernel_debug_info->printCallInformation(e->key_);
+  }
+}
+
+size_t LockProfiler::writeReport(char* buffer, size_t size)
+{
+  Entry* sorted[REPORT_ENTRIES];
+  char* position = buffer;
+  size_t remaining = size;
+  DeviceFSInfoInode::append(position, remaining, "# %s, %zu records dropped\n", enabled_ ? "enabled" : "disabled",
+                            dropped_);
+  DeviceFSInfoInode::append(position, remaining, "# lock acquires contended wait_total wait_max hold_total hold_max\n");
+  size_t num = sortByWait(locks_, MAX_LOCKS, sorted, REPORT_ENTRIES);
+  for (size_t i = 0; i < num; ++i)
+  {
+    Entry* e = sorted[i];
+    DeviceFSInfoInode::append(position, remaining, "%s %zu %zu %llu %llu %llu %llu\n", e->name_ ? e->name_ : "?",
+                              e->acquisitions_, e->contended_, (unsigned long long) e->wait_total_,
+                              (unsigned long long) e->wait_max_, (unsigned long long) e->hold_total_,
+                              (unsigned long long) e->hold_max_);
+  }
+  DeviceFSInfoInode::append(position, remaining,
+                            "# call_site function:line acquires contended wait_total wait_max hold_total hold_max\n");
+  num = sortByWait(call_sites_, MAX_CALL_SITES, sorted, REPORT_ENTRIES);
+  for (size_t i = 0; i < num; ++i)
+  {
+    Entry* e = sorted[i];
+    const char* function = 0;
+    ssize_t line = 0;
+    if (kernel_debug_info)
+      kernel_debug_info->getCallNameAndLine(e->key_, function, line);
+    DeviceFSInfoInode::append(position, remaining, "%zx %s:%zd %zu %zu %llu %llu %llu %llu\n", e->key_,
+                              function ? function : "?", line, e->acquisitions_, e->contended_,
+                              (unsigned long long) e->wait_total_, (unsigned long long) e->wait_max_,
+                              (unsigned long long) e->hold_total_, (unsigned long long) e->hold_max_);
+  }
+  return position - buffer;
+}
@@ -44,6 +44,7 @@ bool Mutex::acquireNonBlocking(pointer called_by)
   last_accessed_at_ = called_by;
   held_by_ = currentThread;
   pushFrontToCurrentThreadHoldingList();
+  profileAcquired(called_by, false, 0);
   return true;
 }
 
@@ -63,27 +64,31 @@ void Mutex::acquire(pointer called_by)
   // check for deadlocks, interrupts...
   doChecksBeforeWaiting();
 
-  while(ArchThreads::testSetLock(mutex_, 1))
+  uint64 wait_start = profileWaitStart();
+  bool contended = ArchThreads::testSetLock(mutex_, 1);
+  if(contended)
   {
-    checkCurrentThreadStillWaitingOnAnotherLock();
     lockWaitersList();
     // Here we have to check for the lock again, in case some one released it in between, we might sleep forever.
-    if(!ArchThreads::testSetLock(mutex_, 1))
+    if(ArchThreads::testSetLock(mutex_, 1))
     {
-      unlockWaitersList();
-      break;
+      sleepAndRelease();
+      // We have been waken up again. The releasing thread has handed the mutex over to us directly,
+      // so no other thread could have taken it in between.
+      currentThread->lock_waiting_on_ = 0;
+      assert(held_by_ == currentThread);
+      last_accessed_at_ = called_by;
+      profileAcquired(called_by, true, wait_start);
+      return;
     }
-    // check for deadlocks, interrupts...
-    doChecksBeforeWaiting();
-    sleepAndRelease();
-    // We have been waken up again.
-    currentThread->lock_waiting_on_ = 0;
+    unlockWaitersList();
   }
 
   assert(held_by_ == 0);
   pushFrontToCurrentThreadHoldingList();
   last_accessed_at_ = called_by;
   held_by_ = currentThread;
+  profileAcquired(called_by, contended, wait_start);
 }
 
 void Mutex::release(pointer called_by)
@@ -100,21 +105,38 @@ void Mutex::release(pointer called_by)
 //    kernel_debug_info->printCallInformation(called_by);
 //  }
   checkInvalidRelease("Mutex::release");
+  profileRelease();
   removeFromCurrentThreadHoldingList();
   last_accessed_at_ = called_by;
-  held_by_ = 0;
-  mutex_ = 0;
-  // Wake up a sleeping thread. It is okay that the mutex is not held by the current thread any longer.
-  // In worst case a new thread is woken up. Otherwise (first wake up, then release),
-  // it could happen that a thread is going to sleep after the this one is trying to wake up one.
-  // Then we are dead... (the thread may sleep forever, in case no other thread is going to acquire this mutex again).
+  // The waiters list is locked while the mutex changes hands, so no thread can go to sleep
+  // on the mutex after we have decided that nobody is waiting for it.
   lockWaitersList();
-  Thread* thread_to_be_woken_up = popBackThreadFromWaitersList();
-  unlockWaitersList();
+  Thread* thread_to_be_woken_up = waiters_.wakeOne();
+  size_t woken_priority = 0;
   if(thread_to_be_woken_up)
   {
-    Scheduler::instance()->wake(thread_to_be_woken_up);
+    // Hand the mutex directly over to the longest waiting thread, mutex_ stays set.
+    // The woken thread cannot run before the list is unlocked, so its holding list may be modified here.
+    held_by_ = thread_to_be_woken_up;
+    next_lock_on_holding_list_ = thread_to_be_woken_up->holding_lock_list_;
+    thread_to_be_woken_up->holding_lock_list_ = this;
+    // the new holder inherits the priority of the remaining waiters
+    thread_to_be_woken_up->updateEffectivePriority();
+    woken_priority = thread_to_be_woken_up->getPriority();
+  }
+  else
+  {
+    held_by_ = 0;
+    mutex_ = 0;
   }
+  // drop the priority inherited through this mutex
+  currentThread->updateEffectivePriority();
+  unlockWaitersList();
+  // a woken thread of higher priority should not wait for the end of the time slice
+  // (it may already be gone once the list is unlocked, so only its priority is looked at)
+  if(woken_priority > currentThread->getPriority() && ArchInterrupts::testIFSet() &&
+     Scheduler::instance()->isSchedulingEnabled())
+    Scheduler::instance()->yield();
 }
 
 bool Mutex::isFree()
@@ -0,0 +1,115 @@
+#include "PriorityInheritanceTest.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "Mutex.h"
+#include "TimerQueue.h"
+#include "kprintf.h"
+#include "debug.h"
+
+// the low priority thread is below the kernel threads with the default priority, the others are above them
+static const size_t LOW_PRIORITY = 1;
+static const size_t MEDIUM_PRIORITY = Thread::DEFAULT_PRIORITY + 1;
+static const size_t HIGH_PRIORITY = Thread::DEFAULT_PRIORITY + 2;
+
+// the low priority thread holds the mutex for a few time slices, the medium one keeps the cpu busy much longer
+static const uint64 HOLD_TICKS = 3;
+static const uint64 BUSY_TICKS = 30;
+
+static Mutex* test_lock = 0;
+static volatile bool medium_done = false;
+static volatile bool running = false;
+
+static void busyWait(uint64 ticks)
+{
+  uint64 end = TimerQueue::instance()->now() + ticks * TimerQueue::NS_PER_TICK;
+  while (TimerQueue::instance()->now() < end)
+    ;
+}
+
+class PriorityTestThread : public Thread
+{
+  public:
+    PriorityTestThread(const char* name, size_t priority) :
+        Thread(0, name, Thread::KERNEL_THREAD)
+    {
+      setPriority(priority);
+    }
+};
+
+class HighPriorityThread : public PriorityTestThread
+{
+  public:
+    HighPriorityThread() : PriorityTestThread("PriorityTestHigh", HIGH_PRIORITY)
+    {
+    }
+
+    virtual void Run()
+    {
+      uint64 start = TimerQueue::instance()->now();
+      test_lock->acquire();
+      uint64 wait = TimerQueue::instance()->now() - start;
+      bool medium_was_done = medium_done;
+      test_lock->release();
+
+      // the wait is bounded by the critical section plus a time slice for the hand over, not by the medium thread
+      uint64 bound = (HOLD_TICKS + 1) * TimerQueue::NS_PER_TICK;
+      uint64 busy = BUSY_TICKS * TimerQueue::NS_PER_TICK;
+      bool bounded = !medium_was_done && wait <= bound;
+      kprintf("PriorityInheritanceTest: %s, the high priority thread waited %llu ms for the mutex "
+              "(bound %llu ms, the medium thread runs for %llu ms)\n", bounded ? "passed" : "FAILED",
+              (unsigned long long) (wait / TimerQueue::NS_PER_MS), (unsigned long long) (bound / TimerQueue::NS_PER_MS),
+              (unsigned long long) (busy / TimerQueue::NS_PER_MS));
+      debug(SCHEDULER, "PriorityInheritanceTest: %s, wait %llu ns\n", bounded ? "passed" : "FAILED",
+            (unsigned long long) wait);
+      running = false;
+    }
+};
+
+class MediumPriorityThread : public PriorityTestThread
+{
+  public:
+    MediumPriorityThread() : PriorityTestThread("PriorityTestMedium", MEDIUM_PRIORITY)
+    {
+    }
+
+    virtual void Run()
+    {
+      busyWait(BUSY_TICKS);
+      medium_done = true;
+    }
+};
+
+class LowPriorityThread : public PriorityTestThread
+{
+  public:
+    LowPriorityThread() : PriorityTestThread("PriorityTestLow", LOW_PRIORITY)
+    {
+    }
+
+    virtual void Run()
+    {
+      // both are created before either is started. The high one goes first: if a tick came between the two,
+      // the medium one must not get the cpu before the high one has blocked on the mutex and boosted us
+      HighPriorityThread* high = new HighPriorityThread();
+      MediumPriorityThread* medium = new MediumPriorityThread();
+      test_lock->acquire();
+      Scheduler::instance()->addNewThread(high);
+      Scheduler::instance()->addNewThread(medium);
+      busyWait(HOLD_TICKS);
+      test_lock->release();
+    }
+};
+
+void PriorityInheritanceTest::start()
+{
+  if (running)
+  {
+    kprintf("PriorityInheritanceTest: already running\n");
+    return;
+  }
+  running = true;
+  medium_done = false;
+  if (!test_lock)
+    test_lock = new Mutex("PriorityInheritanceTest::test_lock");
+  Scheduler::instance()->addNewThread(new LowPriorityThread());
+}
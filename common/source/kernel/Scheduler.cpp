@@ -13,6 +13,8 @@
 #include "umap.h"
 #include "ustring.h"
 #include "Lock.h"
+#include "TimerQueue.h"
+#include "fs/devicefs/DeviceFSInfoInode.h"
 
 ArchThreadRegisters *currentThreadRegisters;
 Thread *currentThread;
@@ -26,36 +28,65 @@ Scheduler *Scheduler::instance()
   return instance_;
 }
 
-Scheduler::Scheduler()
+Scheduler::Scheduler() :
+    cleanup_work_(&Scheduler::cleanupJob), cleaning_up_(0)
 {
   block_scheduling_ = 0;
-  ticks_ = 0;
-  addNewThread(&cleanup_thread_);
+  last_accounted_ = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+    latency_histogram_[i] = 0;
+  for (size_t i = 0; i < Thread::NUM_PRIORITIES; ++i)
+  {
+    ready_queues_head_[i] = 0;
+    ready_queues_tail_[i] = 0;
+  }
+  ready_queues_bitmap_ = 0;
   addNewThread(&idle_thread_);
 }
 
 uint32 Scheduler::schedule()
 {
   assert(!ArchInterrupts::testIFSet() && "Tried to schedule with Interrupts enabled");
+  uint64 now = ArchCommon::getTimestamp();
+  accountTime(now);
   if (block_scheduling_ != 0)
   {
     debug(SCHEDULER, "schedule: currently blocked\n");
+    TimerQueue::instance()->programNextInterrupt(false);
     return 0;
   }
 
-  auto it = threads_.begin();
-  for(; it != threads_.end(); ++it)
+  // the previous thread goes to the back of its ready queue if it is still runnable, sleeping threads are not queued at all
+  Thread* previous = currentThread;
+  if (previous && previous != &idle_thread_ && previous->schedulable())
+    enqueueReadyThread(previous);
+
+  currentThread = popNextReadyThread();
+  if (currentThread)
   {
-    if((*it)->schedulable())
+    uint64 wait = now - currentThread->ready_since_;
+    currentThread->run_queue_wait_ += wait;
+    if (currentThread->woken_up_)
     {
-      currentThread = *it;
-      break;
+      recordLatency(wait);
+      currentThread->woken_up_ = false;
     }
   }
+  else
+    currentThread = &idle_thread_;
 
-  assert(it != threads_.end() && "No schedulable thread found");
+  if (previous && previous != currentThread)
+  {
+    if (previous->yielding_ || !previous->schedulable())
+      ++previous->voluntary_switches_;
+    else
+      ++previous->involuntary_switches_;
+  }
+  if (previous)
+    previous->yielding_ = false;
 
-  ustl::rotate(threads_.begin(), it + 1, threads_.end()); // no new/delete here - important because interrupts are disabled
+  // nothing but the idle thread runs, so there is no time slice to end and the tick can be left out
+  TimerQueue::instance()->programNextInterrupt(currentThread == &idle_thread_);
 
   //debug(SCHEDULER, "Scheduler::schedule: new currentThread is %p %s, switch_to_userspace: %d\n", currentThread, currentThread->getName(), currentThread->switch_to_userspace_);
 
@@ -85,6 +116,63 @@ void Scheduler::addNewThread(Thread *thread)
   KernelMemoryManager::instance()->getKMMLock().release();
   threads_.push_back(thread);
   unlockScheduling();
+  if (thread != &idle_thread_ && thread->schedulable())
+  {
+    bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+    enqueueReadyThread(thread);
+    if (interrupts_enabled)
+      ArchInterrupts::enableInterrupts();
+  }
+}
+
+void Scheduler::enqueueReadyThread(Thread* thread)
+{
+  assert(!ArchInterrupts::testIFSet() && "Ready queues may only be changed with interrupts disabled");
+  if (thread->in_run_queue_ || thread == &idle_thread_)
+    return;
+  size_t priority = thread->priority_;
+  thread->next_thread_in_run_queue_ = 0;
+  thread->prev_thread_in_run_queue_ = ready_queues_tail_[priority];
+  if (ready_queues_tail_[priority])
+    ready_queues_tail_[priority]->next_thread_in_run_queue_ = thread;
+  else
+    ready_queues_head_[priority] = thread;
+  ready_queues_tail_[priority] = thread;
+  ready_queues_bitmap_ |= (1U << priority);
+  thread->in_run_queue_ = true;
+  thread->ready_since_ = ArchCommon::getTimestamp();
+}
+
+void Scheduler::dequeueReadyThread(Thread* thread)
+{
+  assert(!ArchInterrupts::testIFSet() && "Ready queues may only be changed with interrupts disabled");
+  if (!thread->in_run_queue_)
+    return;
+  size_t priority = thread->priority_;
+  if (thread->prev_thread_in_run_queue_)
+    thread->prev_thread_in_run_queue_->next_thread_in_run_queue_ = thread->next_thread_in_run_queue_;
+  else
+    ready_queues_head_[priority] = thread->next_thread_in_run_queue_;
+  if (thread->next_thread_in_run_queue_)
+    thread->next_thread_in_run_queue_->prev_thread_in_run_queue_ = thread->prev_thread_in_run_queue_;
+  else
+    ready_queues_tail_[priority] = thread->prev_thread_in_run_queue_;
+  if (!ready_queues_head_[priority])
+    ready_queues_bitmap_ &= ~(1U << priority);
+  thread->next_thread_in_run_queue_ = 0;
+  thread->prev_thread_in_run_queue_ = 0;
+  thread->in_run_queue_ = false;
+}
+
+Thread* Scheduler::popNextReadyThread()
+{
+  if (!ready_queues_bitmap_)
+    return 0;
+  size_t priority = 31 - __builtin_clz(ready_queues_bitmap_);
+  Thread* thread = ready_queues_head_[priority];
+  assert(thread && thread->schedulable());
+  dequeueReadyThread(thread);
+  return thread;
 }
 
 void Scheduler::sleep()
@@ -96,9 +184,7 @@ void Scheduler::sleep()
 
 void Scheduler::wake(Thread* thread_to_wake)
 {
-  // wait until the thread is sleeping
-  while(thread_to_wake->getState() != Sleeping)
-    yield();
+  assert(thread_to_wake->getState() == Sleeping && "tried to wake a thread which is not sleeping");
   thread_to_wake->setState(Running);
 }
 
@@ -112,6 +198,8 @@ void Scheduler::yield()
              currentThread, currentThread->name_.c_str());
     currentThread->printBacktrace();
   }
+  if (currentThread)
+    currentThread->yielding_ = true;
   ArchThreads::yield();
 }
 
@@ -121,6 +209,7 @@ void Scheduler::cleanupDeadThreads()
      functionality could be implemented more cleanly in another place.
      (e.g. Thread/Process destructor) */
 
+  cleaning_up_ = currentThread;
   lockScheduling();
   uint32 thread_count_max = threads_.size();
   if (thread_count_max > 1024)
@@ -148,18 +237,93 @@ void Scheduler::cleanupDeadThreads()
     }
     debug(SCHEDULER, "cleanupDeadThreads: done\n");
   }
+  cleaning_up_ = 0;
+}
+
+size_t Scheduler::cleanupJob(void* arg __attribute__((unused)))
+{
+  Scheduler::instance()->cleanupDeadThreads();
+  return 0;
+}
+
+void Scheduler::queueCleanup()
+{
+  assert(!ArchInterrupts::testIFSet());
+  WorkQueue::system()->submit(&cleanup_work_);
+}
+
+bool Scheduler::threadsReady()
+{
+  assert(!ArchInterrupts::testIFSet());
+  return ready_queues_bitmap_ != 0;
+}
+
+void Scheduler::accountTime(uint64 now)
+{
+  if (currentThread)
+  {
+    if (currentThread->switch_to_userspace_)
+      currentThread->user_time_ += now - last_accounted_;
+    else
+      currentThread->kernel_time_ += now - last_accounted_;
+  }
+  last_accounted_ = now;
+}
+
+void Scheduler::recordLatency(uint64 latency)
+{
+  size_t bucket = latency ? 63 - __builtin_clzll(latency) : 0;
+  if (bucket >= LATENCY_BUCKETS)
+    bucket = LATENCY_BUCKETS - 1;
+  ++latency_histogram_[bucket];
 }
 
 void Scheduler::printThreadList()
 {
   lockScheduling();
-  debug(SCHEDULER, "Scheduler::printThreadList: %zd Threads in List\n", threads_.size());
+  debug(SCHEDULER, "Scheduler::printThreadList: %zd Threads in List, times in timestamp units\n", threads_.size());
   for (size_t c = 0; c < threads_.size(); ++c)
-    debug(SCHEDULER, "Scheduler::printThreadList: threads_[%zd]: %p  %zd:%s     [%s]\n", c, threads_[c],
-          threads_[c]->getTID(), threads_[c]->getName(), Thread::threadStatePrintable[threads_[c]->state_]);
+  {
+    Thread* t = threads_[c];
+    debug(SCHEDULER, "Scheduler::printThreadList: threads_[%zd]: %p  %zd:%s     [%s] prio %zd\n", c, t, t->getTID(),
+          t->getName(), Thread::threadStatePrintable[t->state_], t->priority_);
+    debug(SCHEDULER, "    user %llu kernel %llu run queue wait %llu switches %zu voluntary %zu involuntary\n",
+          (unsigned long long) t->user_time_, (unsigned long long) t->kernel_time_,
+          (unsigned long long) t->run_queue_wait_, t->voluntary_switches_, t->involuntary_switches_);
+  }
+  debug(SCHEDULER, "Scheduler::printThreadList: wakeup latency histogram:\n");
+  for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+  {
+    if (latency_histogram_[i])
+      debug(SCHEDULER, "    >= 2^%zu: %zu\n", i, latency_histogram_[i]);
+  }
   unlockScheduling();
 }
 
+size_t Scheduler::writeStatistics(char* buffer, size_t size)
+{
+  Scheduler* scheduler = instance();
+  char* position = buffer;
+  size_t remaining = size;
+  scheduler->lockScheduling();
+  DeviceFSInfoInode::append(position, remaining, "# times in timestamp units\n");
+  DeviceFSInfoInode::append(position, remaining,
+                            "# tid name state priority user kernel run_queue_wait voluntary involuntary\n");
+  for (Thread* t : scheduler->threads_)
+  {
+    DeviceFSInfoInode::append(position, remaining, "%zu %s %s %zu %llu %llu %llu %zu %zu\n", t->getTID(),
+                              t->getName(), Thread::threadStatePrintable[t->state_], t->priority_,
+                              (unsigned long long) t->user_time_, (unsigned long long) t->kernel_time_,
+                              (unsigned long long) t->run_queue_wait_, t->voluntary_switches_,
+                              t->involuntary_switches_);
+  }
+  DeviceFSInfoInode::append(position, remaining, "# wakeup latency histogram: log2(latency) count\n");
+  for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+    DeviceFSInfoInode::append(position, remaining, "%zu %zu\n", i, scheduler->latency_histogram_[i]);
+  scheduler->unlockScheduling();
+  return position - buffer;
+}
+
 void Scheduler::lockScheduling() //not as severe as stopping Interrupts
 {
   if (unlikely(ArchThreads::testSetLock(block_scheduling_, 1)))
@@ -181,17 +345,17 @@ bool Scheduler::isSchedulingEnabled()
 
 bool Scheduler::isCurrentlyCleaningUp()
 {
-  return currentThread == &cleanup_thread_;
+  return cleaning_up_ && currentThread == cleaning_up_;
 }
 
 uint32 Scheduler::getTicks()
 {
-  return ticks_;
+  return TimerQueue::instance()->now() / TimerQueue::NS_PER_TICK;
 }
 
 void Scheduler::incTicks()
 {
-  ++ticks_;
+  TimerQueue::instance()->handleInterrupt();
 }
 
 void Scheduler::printStackTraces()
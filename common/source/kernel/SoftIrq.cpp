@@ -0,0 +1,138 @@
+#include "SoftIrq.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "ArchCommon.h"
+#include "ArchInterrupts.h"
+#include "kprintf.h"
+#include "assert.h"
+#include "fs/devicefs/DeviceFSInfoInode.h"
+
+SoftIrq::Entry SoftIrq::sources_[SoftIrq::NUM_SOURCES];
+size_t SoftIrq::pending_ = 0;
+WaitQueue SoftIrq::waiters_;
+Thread* SoftIrq::thread_ = 0;
+
+class SoftIrqThread : public Thread
+{
+  public:
+    SoftIrqThread() : Thread(0, "SoftIrqThread", Thread::KERNEL_THREAD)
+    {
+      // the bottom halves run before any other thread, like the interrupt handlers would
+      setPriority(Thread::NUM_PRIORITIES - 1);
+    }
+
+    virtual void Run()
+    {
+      while (true)
+      {
+        SoftIrq::runPending();
+      }
+    }
+};
+
+void SoftIrq::setHandler(Source source, const char* name, Handler handler)
+{
+  assert(source < NUM_SOURCES);
+  sources_[source].name_ = name;
+  sources_[source].handler_ = handler;
+}
+
+void SoftIrq::raise(Source source)
+{
+  assert(source < NUM_SOURCES);
+  assert(!ArchInterrupts::testIFSet());
+  Entry& entry = sources_[source];
+  ++entry.raised_;
+  if (unlikely(system_state != RUNNING))
+  {
+    runHandler(source, ArchCommon::getTimestamp());
+    return;
+  }
+  if (!(pending_ & (1UL << source)))
+  {
+    entry.raised_at_ = ArchCommon::getTimestamp();
+    pending_ |= (1UL << source);
+  }
+  waiters_.wakeAll();
+}
+
+bool SoftIrq::shouldPreempt()
+{
+  return pending_ && thread_ && currentThread && currentThread->getPriority() < thread_->getPriority();
+}
+
+void SoftIrq::initialise()
+{
+  assert(!thread_);
+  thread_ = new SoftIrqThread();
+  Scheduler::instance()->addNewThread(thread_);
+}
+
+void SoftIrq::runPending()
+{
+  uint64 raised_at[NUM_SOURCES];
+  ArchInterrupts::disableInterrupts();
+  while (!pending_)
+    waiters_.sleep();
+  size_t pending = pending_;
+  pending_ = 0;
+  for (size_t i = 0; i < NUM_SOURCES; ++i)
+    raised_at[i] = sources_[i].raised_at_;
+  ArchInterrupts::enableInterrupts();
+
+  for (size_t i = 0; i < NUM_SOURCES; ++i)
+  {
+    if (pending & (1UL << i))
+      runHandler((Source) i, raised_at[i]);
+  }
+}
+
+void SoftIrq::runHandler(Source source, uint64 raised_at)
+{
+  Entry& entry = sources_[source];
+  if (!entry.handler_)
+    return;
+  uint64 start = ArchCommon::getTimestamp();
+  entry.handler_();
+  uint64 end = ArchCommon::getTimestamp();
+  uint64 latency = start - raised_at;
+  uint64 run = end - start;
+  ++entry.runs_;
+  entry.latency_total_ += latency;
+  if (latency > entry.latency_max_)
+    entry.latency_max_ = latency;
+  entry.run_total_ += run;
+  if (run > entry.run_max_)
+    entry.run_max_ = run;
+}
+
+void SoftIrq::printStatistics()
+{
+  kprintfd("SoftIrq: times in timestamp units\n");
+  kprintfd("%-16s %10s %10s %14s %12s %14s %12s\n", "source", "raised", "runs", "latency total", "latency max",
+           "run total", "run max");
+  for (size_t i = 0; i < NUM_SOURCES; ++i)
+  {
+    Entry& e = sources_[i];
+    kprintfd("%-16.16s %10zu %10zu %14llu %12llu %14llu %12llu\n", e.name_ ? e.name_ : "?", e.raised_, e.runs_,
+             (unsigned long long) e.latency_total_, (unsigned long long) e.latency_max_,
+             (unsigned long long) e.run_total_, (unsigned long long) e.run_max_);
+  }
+}
+
+size_t SoftIrq::writeStatistics(char* buffer, size_t size)
+{
+  char* position = buffer;
+  size_t remaining = size;
+  DeviceFSInfoInode::append(position, remaining,
+                            "# source raised runs latency_total latency_max run_total run_max\n");
+  for (size_t i = 0; i < NUM_SOURCES; ++i)
+  {
+    Entry& e = sources_[i];
+    DeviceFSInfoInode::append(position, remaining, "%s %zu %zu %llu %llu %llu %llu\n", e.name_ ? e.name_ : "?",
+                              e.raised_, e.runs_, (unsigned long long) e.latency_total_,
+                              (unsigned long long) e.latency_max_, (unsigned long long) e.run_total_,
+                              (unsigned long long) e.run_max_);
+  }
+  return position - buffer;
+}
@@ -2,6 +2,7 @@
 #include "kprintf.h"
 #include "ArchThreads.h"
 #include "ArchInterrupts.h"
+#include "ArchCommon.h"
 #include "panic.h"
 #include "Scheduler.h"
 #include "Thread.h"
@@ -10,9 +11,54 @@
 #include "backtrace.h"
 extern Stabs2DebugInfo const *kernel_debug_info;
 
+// the budget has not been set yet, see getSpinBudget
+static const size_t SPIN_BUDGET_UNSET = (size_t)-1;
+
+size_t SpinLock::spin_budget_ = SPIN_BUDGET_UNSET;
+
 SpinLock::SpinLock(const char* name) :
-  Lock::Lock(name), lock_(0)
+  Lock::Lock(name), num_acquires_(0), num_contended_(0), num_acquired_spinning_(0), num_yields_(0), max_wait_(0),
+  lock_(0)
+{
+}
+
+void SpinLock::setSpinBudget(size_t spin_budget)
 {
+  spin_budget_ = spin_budget;
+}
+
+size_t SpinLock::getSpinBudget()
+{
+  // with a single cpu the holder cannot release the lock while we spin
+  if(spin_budget_ == SPIN_BUDGET_UNSET)
+  {
+    if(ArchCommon::getNumCpus() > 1)
+      spin_budget_ = DEFAULT_SPIN_BUDGET;
+    else
+      spin_budget_ = 0;
+  }
+  return spin_budget_;
+}
+
+bool SpinLock::spin()
+{
+  size_t spins = 0;
+  size_t spin_budget = getSpinBudget();
+  for(size_t backoff = 1; spins < spin_budget; backoff = (backoff < MAX_BACKOFF) ? backoff * 2 : MAX_BACKOFF)
+  {
+    // Spinning only makes sense while the holder is running on another cpu and can release the lock meanwhile.
+    // A holder which went to sleep or waits in a ready queue will not release it before we yield.
+    Thread* holder = held_by_;
+    if(holder && (!holder->schedulable() || holder->in_run_queue_))
+      return false;
+    for(size_t i = 0; i < backoff; ++i)
+      ArchThreads::pause();
+    spins += backoff;
+    // only try the atomic exchange if the lock looks free, to keep the bus quiet
+    if(lock_ == 0 && !ArchThreads::testSetLock(lock_, 1))
+      return true;
+  }
+  return false;
 }
 
 bool SpinLock::acquireNonBlocking(pointer called_by)
@@ -41,9 +87,11 @@ bool SpinLock::acquireNonBlocking(pointer called_by)
   }
   // The spinlock is now held by the current thread.
   assert(held_by_ == 0);
+  ++num_acquires_;
   last_accessed_at_ = called_by;
   held_by_ = currentThread;
   pushFrontToCurrentThreadHoldingList();
+  profileAcquired(called_by, false, 0);
   return true;
 }
 
@@ -60,33 +108,51 @@ void SpinLock::acquire(pointer called_by)
 //    debug(LOCK, "The acquire is called by: ");
 //    kernel_debug_info->printCallInformation(called_by);
 //  }
-  if(ArchThreads::testSetLock(lock_, 1))
+  uint64 wait_start = profileWaitStart();
+  bool contended = ArchThreads::testSetLock(lock_, 1);
+  if(contended)
   {
-    // We did not directly managed to acquire the spinlock, need to check for deadlocks and
-    // to push the current thread to the waiters list.
+    uint64 contended_at = ArchCommon::getTimestamp();
+    // We did not directly managed to acquire the spinlock, need to check for deadlocks.
     doChecksBeforeWaiting();
 
-    currentThread->lock_waiting_on_ = this;
-    lockWaitersList();
-    pushFrontCurrentThreadToWaitersList();
-    unlockWaitersList();
-
-    // here comes the basic spinlock
-    while(ArchThreads::testSetLock(lock_, 1))
+    // The lock is usually held only for a short time, so spin for a while first.
+    // Only if that does not help, the current thread is pushed to the waiters list and gives up the cpu.
+    bool acquired_spinning = spin();
+    size_t yields = 0;
+    if(!acquired_spinning)
     {
-      //SpinLock: Simplest of Locks, do the next best thing to busy waiting
-      Scheduler::instance()->yield();
+      currentThread->lock_waiting_on_ = this;
+      lockWaitersList();
+      pushBackCurrentThreadToWaitersList();
+      unlockWaitersList();
+
+      while(ArchThreads::testSetLock(lock_, 1))
+      {
+        //SpinLock: Simplest of Locks, do the next best thing to busy waiting
+        Scheduler::instance()->yield();
+        ++yields;
+      }
+      // Now we managed to acquire the spinlock. Remove the current thread from the waiters list.
+      lockWaitersList();
+      removeCurrentThreadFromWaitersList();
+      unlockWaitersList();
+      currentThread->lock_waiting_on_ = 0;
     }
-    // Now we managed to acquire the spinlock. Remove the current thread from the waiters list.
-    lockWaitersList();
-    removeCurrentThreadFromWaitersList();
-    unlockWaitersList();
-    currentThread->lock_waiting_on_ = 0;
+    ++num_contended_;
+    if(acquired_spinning)
+      ++num_acquired_spinning_;
+    num_yields_ += yields;
+    uint64 wait = ArchCommon::getTimestamp() - contended_at;
+    if(wait > max_wait_)
+      max_wait_ = wait;
   }
   // The current thread is now holding the spinlock
+  ++num_acquires_;
   last_accessed_at_ = called_by;
   held_by_ = currentThread;
   pushFrontToCurrentThreadHoldingList();
+  profileAcquired(called_by, contended, wait_start);
 }
 
 bool SpinLock::isFree()
@@ -113,9 +179,17 @@ void SpinLock::release(pointer called_by)
 //    kernel_debug_info->printCallInformation(called_by);
 //  }
   checkInvalidRelease("SpinLock::release");
+  profileRelease();
   removeFromCurrentThreadHoldingList();
   last_accessed_at_ = called_by;
   held_by_ = 0;
   lock_ = 0;
 }
 
+
+void SpinLock::printStatistics()
+{
+  kprintfd("SpinLock %s: %zu acquires, %zu contended, %zu of them acquired spinning, %zu yields, max wait %llu\n",
+           getName(), num_acquires_, num_contended_, num_acquired_spinning_, num_yields_,
+           (unsigned long long) max_wait_);
+}
@@ -7,6 +7,9 @@
 #include "UserProcess.h"
 #include "ProcessRegistry.h"
 #include "File.h"
+#include "TimerQueue.h"
+#include "Loader.h"
+#include "ArchCommon.h"
 
 size_t Syscall::syscallException(size_t syscall_number, size_t arg1, size_t arg2, size_t arg3, size_t arg4, size_t arg5)
 {
@@ -29,6 +32,9 @@ size_t Syscall::syscallException(size_t syscall_number, size_t arg1, size_t arg2
     case sc_exit:
       exit(arg1);
       break;
+    case sc_fork:
+      return_value = fork();
+      break;
     case sc_write:
       return_value = write(arg1, arg2, arg3);
       break;
@@ -168,12 +174,24 @@ size_t Syscall::createprocess(size_t path, size_t sleep)
   {
     while (ProcessRegistry::instance()->processCount() > process_count) // please note that this will fail ;)
     {
-      Scheduler::instance()->yield();
+      TimerQueue::instance()->nanosleep(10 * TimerQueue::NS_PER_MS);
     }
   }
   return 0;
 }
 
+size_t Syscall::fork()
+{
+  uint64 start = ArchCommon::getTimestamp();
+  UserProcess* child = new UserProcess(*(UserProcess*) currentThread);
+  // the child may already be gone once it has been added, killed ones are cleaned up by the scheduler
+  size_t pid = child->loader_ ? child->getTID() : -1U;
+  Scheduler::instance()->addNewThread(child);
+  debug(SYSCALL, "Syscall::fork: forked %zd in %llu timestamp units\n", pid,
+        (unsigned long long) (ArchCommon::getTimestamp() - start));
+  return pid;
+}
+
 void Syscall::trace()
 {
   currentThread->printBacktrace();
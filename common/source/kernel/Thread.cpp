@@ -4,6 +4,7 @@
 #include "ArchThreads.h"
 #include "ArchInterrupts.h"
 #include "Scheduler.h"
+#include "TimerQueue.h"
 #include "Loader.h"
 #include "Console.h"
 #include "Terminal.h"
@@ -15,6 +16,8 @@
 
 
 
+uint64 Thread::last_tid_ = 0;
+
 const char* Thread::threadStatePrintable[3] =
 {
 "Running", "Sleeping", "ToBeDestroyed"
@@ -31,7 +34,11 @@ extern "C" void threadStartHack()
 
 Thread::Thread(FileSystemInfo *working_dir, ustl::string name, Thread::TYPE type) :
     kernel_registers_(0), user_registers_(0), switch_to_userspace_(type == Thread::USER_THREAD ? 1 : 0), loader_(0),
-    next_thread_in_lock_waiters_list_(0), lock_waiting_on_(0), holding_lock_list_(0), state_(Running), tid_(0),
+    next_thread_in_lock_waiters_list_(0), lock_waiting_on_(0), holding_lock_list_(0), next_thread_in_run_queue_(0),
+    prev_thread_in_run_queue_(0), in_run_queue_(false), timer_deadline_(0), timer_heap_index_(TimerQueue::NOT_QUEUED),
+    user_time_(0), kernel_time_(0), run_queue_wait_(0), ready_since_(0), voluntary_switches_(0),
+    involuntary_switches_(0), yielding_(false), woken_up_(false), state_(Running), priority_(DEFAULT_PRIORITY), base_priority_(DEFAULT_PRIORITY),
+    tid_(ArchThreads::atomic_add(last_tid_, 1) + 1),
     my_terminal_(0), working_dir_(working_dir), name_(name)
 {
   debug(THREAD, "Thread ctor, this is %p, stack is %p, fs_info ptr: %p\n", this, kernel_stack_, working_dir_);
@@ -47,6 +54,7 @@ Thread::~Thread()
   user_registers_ = 0;
   delete kernel_registers_;
   kernel_registers_ = 0;
+  assert(!in_run_queue_ && "Thread is destroyed while still being in a ready queue");
   if(unlikely(holding_lock_list_ != 0))
   {
     debug(THREAD, "~Thread: ERROR: Thread <%s (%p)> is going to be destroyed, but still holds some locks!\n",
@@ -188,5 +196,71 @@ void Thread::setState(ThreadState new_state)
   assert(!((state_ == ToBeDestroyed) && (new_state != ToBeDestroyed)) && "Tried to change thread state when thread was already set to be destroyed");
   assert(!((new_state == Sleeping) && (currentThread != this)) && "Setting other threads to sleep is not thread-safe");
 
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  ThreadState old_state = state_;
   state_ = new_state;
+  if ((new_state == Running) && (old_state != Running))
+  {
+    woken_up_ = (old_state == Sleeping);
+    Scheduler::instance()->enqueueReadyThread(this);
+  }
+  else if (new_state == ToBeDestroyed)
+  {
+    Scheduler::instance()->dequeueReadyThread(this);
+    TimerQueue::instance()->cancel(this);
+    Scheduler::instance()->queueCleanup();
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+size_t Thread::getPriority() const
+{
+  return priority_;
+}
+
+size_t Thread::getBasePriority() const
+{
+  return base_priority_;
+}
+
+void Thread::setPriority(size_t priority)
+{
+  assert(priority < NUM_PRIORITIES);
+  base_priority_ = priority;
+  updateEffectivePriority();
+}
+
+void Thread::inheritPriority(size_t priority)
+{
+  assert(!ArchInterrupts::testIFSet());
+  if (priority > priority_)
+    changePriority(priority);
+}
+
+void Thread::updateEffectivePriority()
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  size_t priority = Lock::highestWaiterPriority(this);
+  if (priority < base_priority_)
+    priority = base_priority_;
+  if (priority != priority_)
+    changePriority(priority);
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void Thread::changePriority(size_t priority)
+{
+  assert(!ArchInterrupts::testIFSet());
+  if (in_run_queue_)
+  {
+    Scheduler::instance()->dequeueReadyThread(this);
+    priority_ = priority;
+    Scheduler::instance()->enqueueReadyThread(this);
+  }
+  else
+  {
+    priority_ = priority;
+  }
 }
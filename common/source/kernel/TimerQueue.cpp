@@ -0,0 +1,211 @@
+#include "TimerQueue.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "ArchInterrupts.h"
+#include "kstring.h"
+#include "assert.h"
+#include "debug.h"
+
+// interrupts closer than this are not programmed, handling them would take longer anyway
+static const uint64 MIN_ONE_SHOT_NS = 50000;
+
+TimerQueue* TimerQueue::instance_ = 0;
+
+TimerQueue* TimerQueue::instance()
+{
+  if (unlikely(!instance_))
+    instance_ = new TimerQueue();
+  return instance_;
+}
+
+TimerQueue::TimerQueue() :
+    heap_(0), size_(0), capacity_(0), base_(0), programmed_deadline_(0), one_shot_(false), periodic_only_(false),
+    interrupts_(0)
+{
+}
+
+uint64 TimerQueue::now()
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  uint64 time = base_;
+  if (one_shot_ && programmed_deadline_)
+    time += ArchInterrupts::getTimerElapsed();
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return time;
+}
+
+void TimerQueue::sleepUntil(uint64 deadline)
+{
+  assert(currentThread);
+  assert(ArchInterrupts::testIFSet() && "sleepUntil has to be called with interrupts enabled");
+  while (true)
+  {
+    reserve();
+    if (currentThread->timer_heap_index_ != NOT_QUEUED)
+      removeAt(currentThread->timer_heap_index_);
+    if (now() >= deadline)
+      break;
+    currentThread->timer_deadline_ = deadline;
+    push(currentThread);
+    // marked as sleeping before the timer interrupt can see the thread, so the wake up cannot get lost
+    currentThread->setState(Sleeping);
+    ArchInterrupts::enableInterrupts();
+    Scheduler::instance()->yield();
+  }
+  ArchInterrupts::enableInterrupts();
+}
+
+void TimerQueue::nanosleep(uint64 ns)
+{
+  sleepUntil(now() + ns);
+}
+
+void TimerQueue::handleInterrupt()
+{
+  assert(!ArchInterrupts::testIFSet());
+  ++interrupts_;
+  if (!one_shot_)
+  {
+    base_ += NS_PER_TICK;
+  }
+  else if (programmed_deadline_)
+  {
+    // the timer has run out, the time stands still at the deadline until the timer is programmed again
+    base_ += ArchInterrupts::getTimerElapsed();
+    if (base_ < programmed_deadline_)
+      base_ = programmed_deadline_;
+    programmed_deadline_ = 0;
+  }
+  uint64 time = now();
+  while (size_ && heap_[0]->timer_deadline_ <= time)
+  {
+    Thread* thread = heap_[0];
+    removeAt(0);
+    if (!thread->schedulable())
+      Scheduler::instance()->wake(thread);
+  }
+}
+
+void TimerQueue::programNextInterrupt(bool idle)
+{
+  assert(!ArchInterrupts::testIFSet());
+  if (periodic_only_)
+    return;
+  uint64 time = now();
+  // time slices end at multiples of the tick, so yielding threads do not move the end of the slice
+  uint64 target = idle ? (uint64) -1 : ((time + MIN_ONE_SHOT_NS) / NS_PER_TICK + 1) * NS_PER_TICK;
+  if (size_ && heap_[0]->timer_deadline_ < target)
+    target = heap_[0]->timer_deadline_;
+  // an interrupt which comes earlier programs the timer again anyway
+  if (one_shot_ && programmed_deadline_ && programmed_deadline_ <= target)
+    return;
+  if (target < time + MIN_ONE_SHOT_NS)
+    target = time + MIN_ONE_SHOT_NS;
+  uint64 programmed = ArchInterrupts::setTimerOneShot(target - time);
+  if (!programmed)
+  {
+    debug(SCHEDULER, "TimerQueue: the timer only supports periodic interrupts\n");
+    periodic_only_ = true;
+    return;
+  }
+  base_ = time;
+  programmed_deadline_ = time + programmed;
+  one_shot_ = true;
+}
+
+void TimerQueue::cancel(Thread* thread)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  if (thread->timer_heap_index_ != NOT_QUEUED)
+    removeAt(thread->timer_heap_index_);
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+size_t TimerQueue::getNumInterrupts()
+{
+  return interrupts_;
+}
+
+void TimerQueue::reserve()
+{
+  ArchInterrupts::disableInterrupts();
+  while (size_ == capacity_)
+  {
+    // memory must not be allocated with interrupts disabled, another thread may grow the heap meanwhile
+    size_t new_capacity = capacity_ ? capacity_ * 2 : 16;
+    ArchInterrupts::enableInterrupts();
+    Thread** new_heap = new Thread*[new_capacity];
+    ArchInterrupts::disableInterrupts();
+    if (new_capacity > capacity_)
+    {
+      memcpy(new_heap, heap_, size_ * sizeof(Thread*));
+      Thread** old_heap = heap_;
+      heap_ = new_heap;
+      capacity_ = new_capacity;
+      new_heap = old_heap;
+    }
+    ArchInterrupts::enableInterrupts();
+    delete[] new_heap;
+    ArchInterrupts::disableInterrupts();
+  }
+}
+
+void TimerQueue::push(Thread* thread)
+{
+  assert(size_ < capacity_);
+  place(thread, size_++);
+  siftUp(thread->timer_heap_index_);
+}
+
+void TimerQueue::removeAt(size_t index)
+{
+  assert(index < size_);
+  heap_[index]->timer_heap_index_ = NOT_QUEUED;
+  if (index == --size_)
+    return;
+  // the last thread fills the gap and moves to wherever its deadline belongs
+  Thread* moved = heap_[size_];
+  place(moved, index);
+  siftUp(index);
+  siftDown(moved->timer_heap_index_);
+}
+
+void TimerQueue::siftUp(size_t index)
+{
+  Thread* thread = heap_[index];
+  while (index > 0)
+  {
+    size_t parent = (index - 1) / 2;
+    if (heap_[parent]->timer_deadline_ <= thread->timer_deadline_)
+      break;
+    place(heap_[parent], index);
+    index = parent;
+  }
+  place(thread, index);
+}
+
+void TimerQueue::siftDown(size_t index)
+{
+  Thread* thread = heap_[index];
+  while (true)
+  {
+    size_t child = 2 * index + 1;
+    if (child >= size_)
+      break;
+    if (child + 1 < size_ && heap_[child + 1]->timer_deadline_ < heap_[child]->timer_deadline_)
+      ++child;
+    if (thread->timer_deadline_ <= heap_[child]->timer_deadline_)
+      break;
+    place(heap_[child], index);
+    index = child;
+  }
+  place(thread, index);
+}
+
+void TimerQueue::place(Thread* thread, size_t index)
+{
+  heap_[index] = thread;
+  thread->timer_heap_index_ = index;
+}
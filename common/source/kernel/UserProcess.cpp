@@ -26,7 +26,7 @@ UserProcess::UserProcess(ustl::string filename, FileSystemInfo *fs_info, uint32
   }
 
   size_t page_for_stack = PageManager::instance()->allocPPN();
-  bool vpn_mapped = loader_->arch_memory_.mapPage(USER_BREAK / PAGE_SIZE - 1, page_for_stack, 1);
+  bool vpn_mapped = loader_->arch_memory_.mapPage(USER_BREAK / PAGE_SIZE - 1, page_for_stack, 1, 1);
   assert(vpn_mapped && "Virtual page for stack was already mapped - this should never happen");
 
   ArchThreads::createUserRegisters(user_registers_, loader_->getEntryFunction(),
@@ -43,6 +43,35 @@ UserProcess::UserProcess(ustl::string filename, FileSystemInfo *fs_info, uint32
   switch_to_userspace_ = 1;
 }
 
+UserProcess::UserProcess(UserProcess& parent) :
+    Thread(new FileSystemInfo(*parent.getWorkingDirInfo()), parent.getName(), Thread::USER_THREAD),
+    fd_(VfsSyscall::open(parent.getName(), O_RDONLY))
+{
+  assert(currentThread == &parent);
+  ProcessRegistry::instance()->processStart();
+
+  if (fd_ >= 0)
+    loader_ = new Loader(*parent.loader_, fd_);
+
+  if (!loader_ || !parent.loader_->arch_memory_.forkInto(loader_->arch_memory_))
+  {
+    debug(USERPROCESS, "Error: forking %s failed!\n", parent.getName());
+    delete loader_;
+    loader_ = 0;
+    kill();
+    return;
+  }
+
+  ArchThreads::forkUserRegisters(user_registers_, parent.user_registers_, getKernelStackStartPointer());
+  ArchThreads::setAddressSpace(this, loader_->arch_memory_);
+
+  debug(USERPROCESS, "ctor: Forked %s\n", parent.getName());
+
+  setTerminal(parent.getTerminal());
+
+  switch_to_userspace_ = 1;
+}
+
 UserProcess::~UserProcess()
 {
   assert(Scheduler::instance()->isCurrentlyCleaningUp());
@@ -0,0 +1,85 @@
+#include "WaitQueue.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "ArchInterrupts.h"
+#include "assert.h"
+
+WaitQueue::WaitQueue() :
+    head_(0), tail_(0)
+{
+}
+
+void WaitQueue::pushBack(Thread* thread)
+{
+  assert(!ArchInterrupts::testIFSet());
+  thread->next_thread_in_lock_waiters_list_ = 0;
+  if (tail_)
+    tail_->next_thread_in_lock_waiters_list_ = thread;
+  else
+    head_ = thread;
+  tail_ = thread;
+}
+
+Thread* WaitQueue::popFront()
+{
+  Thread* thread = head_;
+  if (thread)
+  {
+    head_ = thread->next_thread_in_lock_waiters_list_;
+    if (!head_)
+      tail_ = 0;
+    thread->next_thread_in_lock_waiters_list_ = 0;
+  }
+  return thread;
+}
+
+bool WaitQueue::remove(Thread* thread)
+{
+  assert(!ArchInterrupts::testIFSet());
+  Thread* previous = 0;
+  for (Thread* current = head_; current; previous = current, current = current->next_thread_in_lock_waiters_list_)
+  {
+    if (current != thread)
+      continue;
+    if (previous)
+      previous->next_thread_in_lock_waiters_list_ = thread->next_thread_in_lock_waiters_list_;
+    else
+      head_ = thread->next_thread_in_lock_waiters_list_;
+    if (tail_ == thread)
+      tail_ = previous;
+    thread->next_thread_in_lock_waiters_list_ = 0;
+    return true;
+  }
+  return false;
+}
+
+void WaitQueue::sleep(size_t* guard)
+{
+  assert(!ArchInterrupts::testIFSet());
+  assert(currentThread);
+  pushBack(currentThread);
+  // the thread is sleeping before anybody else can get hold of the queue, so a wake up cannot get lost
+  currentThread->setState(Sleeping);
+  if (guard)
+    *guard = 0;
+  ArchInterrupts::enableInterrupts();
+  Scheduler::instance()->yield();
+  ArchInterrupts::disableInterrupts();
+}
+
+Thread* WaitQueue::wakeOne()
+{
+  assert(!ArchInterrupts::testIFSet());
+  Thread* thread = popFront();
+  if (thread)
+    Scheduler::instance()->wake(thread);
+  return thread;
+}
+
+size_t WaitQueue::wakeAll()
+{
+  size_t count = 0;
+  while (wakeOne())
+    ++count;
+  return count;
+}
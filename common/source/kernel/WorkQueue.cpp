@@ -0,0 +1,170 @@
+#include "WorkQueue.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "ArchInterrupts.h"
+#include "kprintf.h"
+#include "assert.h"
+#include "debug.h"
+
+// the system queue runs short jobs, a blocked job only holds up the others until a second worker is added
+static const size_t SYSTEM_WORKERS = 4;
+
+WorkQueue* WorkQueue::system_ = 0;
+
+class WorkQueueWorker : public Thread
+{
+  public:
+    WorkQueueWorker(WorkQueue* queue) :
+        Thread(0, ustl::string(queue->name_) + "Worker", Thread::KERNEL_THREAD), queue_(queue)
+    {
+      setPriority(queue->priority_);
+    }
+
+    virtual void kill()
+    {
+      assert(false && "a worker thread must not be destroyed, the jobs of its queue would be lost");
+    }
+
+    virtual void Run()
+    {
+      queue_->runWorker();
+    }
+
+  private:
+    WorkQueue* queue_;
+};
+
+WorkItem::WorkItem(Function function, void* arg) :
+    function_(function), arg_(arg), result_(0), state_(DONE), resubmitted_(false), next_(0)
+{
+}
+
+size_t WorkItem::wait()
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  while (state_ != DONE)
+    waiters_.sleep();
+  size_t result = result_;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  return result;
+}
+
+WorkQueue* WorkQueue::system()
+{
+  if (unlikely(!system_))
+    system_ = new WorkQueue("System", SYSTEM_WORKERS, Thread::DEFAULT_PRIORITY);
+  return system_;
+}
+
+WorkQueue::WorkQueue(const char* name, size_t max_workers, size_t priority) :
+    name_(name), max_workers_(max_workers), priority_(priority), num_workers_(1), busy_workers_(0), head_(0),
+    tail_(0), submitted_(0), completed_(0)
+{
+  assert(max_workers > 0);
+  assert(priority < Thread::NUM_PRIORITIES);
+  addWorker();
+}
+
+bool WorkQueue::submit(WorkItem* item)
+{
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  bool queued = true;
+  bool add_worker = false;
+  if (item->state_ == WorkItem::QUEUED)
+  {
+    queued = false;
+  }
+  else if (item->state_ == WorkItem::RUNNING)
+  {
+    // the worker running it queues it again when it is done, so the job never runs twice at the same time
+    item->resubmitted_ = true;
+  }
+  else
+  {
+    ++submitted_;
+    item->state_ = WorkItem::QUEUED;
+    append(item);
+    if (!idle_workers_.empty())
+    {
+      idle_workers_.wakeOne();
+    }
+    else if (interrupts_enabled && num_workers_ < max_workers_ && system_state == RUNNING)
+    {
+      // reserved now, so concurrent submits do not exceed the limit
+      ++num_workers_;
+      add_worker = true;
+    }
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  if (add_worker)
+    addWorker();
+  return queued;
+}
+
+void WorkQueue::runWorker()
+{
+  while (true)
+  {
+    ArchInterrupts::disableInterrupts();
+    while (!head_)
+      idle_workers_.sleep();
+    WorkItem* item = head_;
+    head_ = item->next_;
+    if (!head_)
+      tail_ = 0;
+    item->next_ = 0;
+    item->state_ = WorkItem::RUNNING;
+    ++busy_workers_;
+    ArchInterrupts::enableInterrupts();
+
+    size_t result = item->function_(item->arg_);
+
+    ArchInterrupts::disableInterrupts();
+    --busy_workers_;
+    ++completed_;
+    item->result_ = result;
+    if (item->resubmitted_)
+    {
+      item->resubmitted_ = false;
+      item->state_ = WorkItem::QUEUED;
+      append(item);
+    }
+    else
+    {
+      // the waiters may delete the item as soon as interrupts are enabled again
+      item->state_ = WorkItem::DONE;
+      item->waiters_.wakeAll();
+    }
+    ArchInterrupts::enableInterrupts();
+  }
+}
+
+void WorkQueue::addWorker()
+{
+  debug(SCHEDULER, "WorkQueue %s: adding worker %zu of at most %zu\n", name_, num_workers_, max_workers_);
+  Scheduler::instance()->addNewThread(new WorkQueueWorker(this));
+}
+
+void WorkQueue::append(WorkItem* item)
+{
+  item->next_ = 0;
+  if (tail_)
+    tail_->next_ = item;
+  else
+    head_ = item;
+  tail_ = item;
+}
+
+void WorkQueue::printStatistics()
+{
+  size_t queued = 0;
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  for (WorkItem* item = head_; item; item = item->next_)
+    ++queued;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  kprintfd("WorkQueue %s: %zu of at most %zu workers, %zu busy, %zu jobs queued, %zu submitted, %zu completed\n",
+           name_, num_workers_, max_workers_, busy_workers_, queued, submitted_, completed_);
+}
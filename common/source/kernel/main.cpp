@@ -3,13 +3,18 @@
 #include "ArchSerialInfo.h"
 #include "BDManager.h"
 #include "BDVirtualDevice.h"
+#include "BlockCache.h"
 #include "PageManager.h"
+#include "PageReclaim.h"
 #include "KernelMemoryManager.h"
 #include "ArchInterrupts.h"
 #include "ArchThreads.h"
 #include "kprintf.h"
 #include "Thread.h"
 #include "Scheduler.h"
+#include "TimerQueue.h"
+#include "SoftIrq.h"
+#include "WorkQueue.h"
 #include "ArchCommon.h"
 #include "ArchThreads.h"
 #include "Mutex.h"
@@ -65,6 +70,7 @@ extern "C" void startup()
   kprintf("Kernel end address is %p\n", &kernel_end_address);
 
   Scheduler::instance();
+  WorkQueue::system();
 
   //needs to be done after scheduler and terminal, but prior to enableInterrupts
   kprintf_init();
@@ -75,6 +81,7 @@ extern "C" void startup()
   ArchInterrupts::initialise();
 
   ArchInterrupts::setTimerFrequency(IRQ0_TIMER_FREQUENCY);
+  TimerQueue::instance();
 
   ArchCommon::initDebug();
 
@@ -92,6 +99,8 @@ extern "C" void startup()
   debug(MAIN, "Block Device creation\n");
   BDManager::getInstance()->doDeviceDetection();
   debug(MAIN, "Block Device done\n");
+  BlockCache::instance();
+  PageReclaim::instance()->initialise();
 
   for (BDVirtualDevice* bdvd : BDManager::getInstance()->device_list_)
   {
@@ -120,6 +129,7 @@ extern "C" void startup()
   ArchInterrupts::enableKBD();
 
   debug(MAIN, "Adding Kernel threads\n");
+  SoftIrq::initialise();
   Scheduler::instance()->addNewThread(main_console);
   Scheduler::instance()->addNewThread(new ProcessRegistry(new FileSystemInfo(*default_working_dir), user_progs /*see user_progs.h*/));
   Scheduler::instance()->printThreadList();
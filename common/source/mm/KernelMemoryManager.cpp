@@ -8,6 +8,7 @@
 #include "ArchInterrupts.h"
 #include "ArchMemory.h"
 #include "PageManager.h"
+#include "PageReclaim.h"
 #include "kstring.h"
 #include "Stabs2DebugInfo.h"
 #include "backtrace.h"
@@ -54,9 +55,25 @@ pointer KernelMemoryManager::allocateMemory(size_t requested_size, pointer calle
   requested_size = (requested_size + 0xF) & ~0xF;
 
   lockKMM();
-  pointer ptr = private_AllocateMemory(requested_size, called_by);
+  pointer ptr = 0;
+  if (pm_ready_ && requested_size <= SlabAllocator::MAX_OBJECT_SIZE)
+  {
+    ptr = slab_allocator_.allocate(requested_size, tracing_ ? called_by : 0);
+    // pages cannot be reclaimed while the lock is held, free some without it and try again
+    while (!ptr)
+    {
+      unlockKMM();
+      bool reclaimed = PageReclaim::instance()->canReclaim() && PageReclaim::instance()->reclaim(1) > 0;
+      lockKMM();
+      if (!reclaimed)
+        break;
+      ptr = slab_allocator_.allocate(requested_size, tracing_ ? called_by : 0);
+    }
+  }
   if (ptr)
     unlockKMM();
+  else if ((ptr = private_AllocateMemory(requested_size, called_by)))
+    unlockKMM();
 
   debug(KMM, "allocateMemory returns address: %zx \n", ptr);
   return ptr;
@@ -89,9 +106,19 @@ pointer KernelMemoryManager::private_AllocateMemory(size_t requested_size, point
 
 bool KernelMemoryManager::freeMemory(pointer virtual_address, pointer called_by)
 {
-  if (virtual_address == 0 || virtual_address < ((pointer) first_) || virtual_address >= kernel_break_)
+  if (virtual_address == 0)
     return false;
 
+  if (virtual_address < ((pointer) first_) || virtual_address >= kernel_break_)
+  {
+    if (!pm_ready_)
+      return false;
+    lockKMM();
+    bool freed = slab_allocator_.free(virtual_address, called_by);
+    unlockKMM();
+    return freed;
+  }
+
   lockKMM();
 
   MallocSegment *m_segment = getSegmentFromAddress(virtual_address);
@@ -124,6 +151,22 @@ pointer KernelMemoryManager::reallocateMemory(pointer virtual_address, size_t ne
   // 16 byte alignment
   new_size = (new_size + 0xF) & ~0xF;
 
+  if (virtual_address < ((pointer) first_) || virtual_address >= kernel_break_)
+  {
+    lockKMM();
+    size_t old_size = slab_allocator_.getObjectSize(virtual_address);
+    unlockKMM();
+    assert(old_size && "reallocateMemory: address is neither a heap segment nor a slab object");
+    if (new_size <= old_size)
+      return virtual_address;
+    pointer new_address = allocateMemory(new_size, called_by);
+    if (new_address == 0)
+      return 0;
+    memcpy((void*) new_address, (void*) virtual_address, old_size);
+    freeMemory(virtual_address, called_by);
+    return new_address;
+  }
+
   lockKMM();
 
   MallocSegment *m_segment = getSegmentFromAddress(virtual_address);
@@ -510,6 +553,7 @@ SpinLock& KernelMemoryManager::getKMMLock()
 }
 
 size_t KernelMemoryManager::getUsedKernelMemory(bool show_allocs = false) {
+    size_t slab_size = slab_allocator_.getUsedMemory(show_allocs);
     MallocSegment *current = first_;
     size_t size = 0, blocks = 0, unused = 0;
     if(show_allocs) kprintfd("Kernel Memory Usage\n\n");
@@ -533,7 +577,8 @@ size_t KernelMemoryManager::getUsedKernelMemory(bool show_allocs = false) {
       current = current->next_;
     }
     if(show_allocs) kprintfd("\n%zu bytes in %zu blocks are in use (%zu%%)\n", size, blocks, 100 * size / (size + unused));
-    return size;
+    if(show_allocs) kprintfd("%zu bytes are in use in slab objects\n", slab_size);
+    return size + slab_size;
 }
 
 void KernelMemoryManager::startTracing() {
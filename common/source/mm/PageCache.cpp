@@ -0,0 +1,210 @@
+#include "PageCache.h"
+#include "PageManager.h"
+#include "Inode.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "ArchInterrupts.h"
+#include "kstring.h"
+#include "kprintf.h"
+#include "assert.h"
+#include "debug.h"
+#include "fs/devicefs/DeviceFSInfoInode.h"
+
+PageCache* PageCache::instance_ = 0;
+
+PageCache* PageCache::instance()
+{
+  if (unlikely(!instance_))
+    instance_ = new PageCache();
+  return instance_;
+}
+
+PageCache::PageCache() :
+    lock_("PageCache::lock_"), lru_head_(0), lru_tail_(0), num_pages_(0), hits_(0), misses_(0), inserts_(0),
+    reclaimed_(0), invalidated_(0)
+{
+  memset(hash_buckets_, 0, sizeof(hash_buckets_));
+}
+
+size_t PageCache::hash(Inode* inode, size_t index)
+{
+  return (((size_t) inode / sizeof(void*)) * 31 + index) % NUM_HASH_BUCKETS;
+}
+
+void PageCache::lruRemove(PageCacheEntry* entry)
+{
+  if (entry->lru_prev_)
+    entry->lru_prev_->lru_next_ = entry->lru_next_;
+  else
+    lru_head_ = entry->lru_next_;
+  if (entry->lru_next_)
+    entry->lru_next_->lru_prev_ = entry->lru_prev_;
+  else
+    lru_tail_ = entry->lru_prev_;
+  entry->lru_prev_ = 0;
+  entry->lru_next_ = 0;
+}
+
+void PageCache::lruPushFront(PageCacheEntry* entry)
+{
+  entry->lru_prev_ = 0;
+  entry->lru_next_ = lru_head_;
+  if (lru_head_)
+    lru_head_->lru_prev_ = entry;
+  else
+    lru_tail_ = entry;
+  lru_head_ = entry;
+}
+
+void PageCache::hashRemove(PageCacheEntry* entry)
+{
+  PageCacheEntry** link = &hash_buckets_[hash(entry->inode_, entry->index_)];
+  while (*link != entry)
+  {
+    assert(*link && "page cache entry is missing in the hash index");
+    link = &(*link)->hash_next_;
+  }
+  *link = entry->hash_next_;
+  entry->hash_next_ = 0;
+}
+
+PageCacheEntry* PageCache::lookup(Inode* inode, size_t index)
+{
+  for (PageCacheEntry* entry = hash_buckets_[hash(inode, index)]; entry; entry = entry->hash_next_)
+  {
+    if (entry->inode_ == inode && entry->index_ == index)
+      return entry;
+  }
+  return 0;
+}
+
+void PageCache::remove(PageCacheEntry* entry)
+{
+  assert(lock_.isHeldBy(currentThread) || system_state != RUNNING);
+  hashRemove(entry);
+  lruRemove(entry);
+  --entry->inode_->i_cached_pages_;
+  --num_pages_;
+  // a process may still map the frame, it does not hold the contents of the file any more once the file changes
+  PageManager::instance()->clearFlags(entry->ppn_, PageFrame::FILE_BACKED);
+  PageManager::instance()->freePPN(entry->ppn_);
+  delete entry;
+}
+
+size_t PageCache::get(Inode* inode, size_t index)
+{
+  ScopeLock lock(lock_);
+  PageCacheEntry* entry = lookup(inode, index);
+  if (!entry)
+  {
+    ++misses_;
+    return 0;
+  }
+  ++hits_;
+  lruRemove(entry);
+  lruPushFront(entry);
+  PageManager::instance()->addReference(entry->ppn_);
+  return entry->ppn_;
+}
+
+bool PageCache::contains(Inode* inode, size_t index)
+{
+  ScopeLock lock(lock_);
+  return lookup(inode, index) != 0;
+}
+
+size_t PageCache::insert(Inode* inode, size_t index, size_t ppn)
+{
+  ScopeLock lock(lock_);
+  PageCacheEntry* entry = lookup(inode, index);
+  if (entry)
+  {
+    debug(PM, "PageCache::insert: page %zu of inode %p has been cached in the meantime\n", index, inode);
+    PageManager::instance()->freePPN(ppn);
+    PageManager::instance()->addReference(entry->ppn_);
+    return entry->ppn_;
+  }
+
+  entry = new PageCacheEntry();
+  entry->inode_ = inode;
+  entry->index_ = index;
+  entry->ppn_ = ppn;
+  size_t bucket = hash(inode, index);
+  entry->hash_next_ = hash_buckets_[bucket];
+  hash_buckets_[bucket] = entry;
+  lruPushFront(entry);
+  ++inode->i_cached_pages_;
+  ++num_pages_;
+  ++inserts_;
+  PageManager::instance()->addReference(ppn);
+  PageManager::instance()->setFlags(ppn, PageFrame::FILE_BACKED);
+  return ppn;
+}
+
+void PageCache::invalidate(Inode* inode)
+{
+  // most inodes never had a page cached, they do not need the lock
+  if (!inode->i_cached_pages_)
+    return;
+
+  ScopeLock lock(lock_);
+  for (size_t bucket = 0; bucket < NUM_HASH_BUCKETS && inode->i_cached_pages_; ++bucket)
+  {
+    PageCacheEntry* entry = hash_buckets_[bucket];
+    while (entry)
+    {
+      PageCacheEntry* next = entry->hash_next_;
+      if (entry->inode_ == inode)
+      {
+        remove(entry);
+        ++invalidated_;
+      }
+      entry = next;
+    }
+  }
+  assert(inode->i_cached_pages_ == 0);
+}
+
+size_t PageCache::reclaim(size_t num)
+{
+  assert(canReclaim());
+  ScopeLock lock(lock_);
+  size_t freed = 0;
+  PageCacheEntry* entry = lru_tail_;
+  while (entry && freed < num)
+  {
+    PageCacheEntry* prev = entry->lru_prev_;
+    // only the cache's own reference is left, the page is not mapped by any process
+    if (PageManager::instance()->getReferenceCount(entry->ppn_) == 1)
+    {
+      remove(entry);
+      ++freed;
+    }
+    entry = prev;
+  }
+  reclaimed_ += freed;
+  debug(PM, "PageCache::reclaim: freed %zu of %zu requested pages\n", freed, num);
+  return freed;
+}
+
+bool PageCache::canReclaim()
+{
+  return system_state == RUNNING && currentThread && ArchInterrupts::testIFSet() && !lock_.isHeldBy(currentThread);
+}
+
+void PageCache::printStatistics()
+{
+  kprintfd("PageCache: %zu pages cached, %zu hits, %zu misses, %zu inserts, %zu reclaimed, %zu invalidated\n",
+           num_pages_, hits_, misses_, inserts_, reclaimed_, invalidated_);
+}
+
+size_t PageCache::writeStatistics(char* buffer, size_t size)
+{
+  PageCache* cache = instance();
+  char* position = buffer;
+  size_t remaining = size;
+  DeviceFSInfoInode::append(position, remaining, "pages %zu\nhits %zu\nmisses %zu\ninserts %zu\n"
+                            "reclaimed %zu\ninvalidated %zu\n", cache->num_pages_, cache->hits_, cache->misses_,
+                            cache->inserts_, cache->reclaimed_, cache->invalidated_);
+  return position - buffer;
+}
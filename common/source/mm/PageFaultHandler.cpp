@@ -7,6 +7,7 @@
 #include "Loader.h"
 #include "Syscall.h"
 #include "ArchThreads.h"
+#include "PageReclaim.h"
 extern "C" void arch_contextSwitch();
 
 const size_t PageFaultHandler::null_reference_check_border_ = PAGE_SIZE;
@@ -59,9 +60,17 @@ inline void PageFaultHandler::handlePageFault(size_t address, bool user,
 
   ArchThreads::printThreadRegisters(currentThread, false);
 
-  if (checkPageFaultIsValid(address, user, present, switch_to_us))
+  if (present && writing && address < USER_BREAK && currentThread->loader_ &&
+      currentThread->loader_->arch_memory_.copyOnWrite(address / PAGE_SIZE))
   {
-    currentThread->loader_->loadPage(address);
+    debug(PAGEFAULT, "The page was copy-on-write, it is writeable now.\n");
+  }
+  else if (checkPageFaultIsValid(address, user, present, switch_to_us))
+  {
+    if (PageReclaim::instance()->swapIn(currentThread->loader_->arch_memory_, address / PAGE_SIZE))
+      debug(PAGEFAULT, "The page has been read back from the swap partition.\n");
+    else
+      currentThread->loader_->loadPage(address);
   }
   else
   {
@@ -11,9 +11,22 @@
 #include "KernelMemoryManager.h"
 #include "assert.h"
 #include "Bitmap.h"
+#include "PageReclaim.h"
 
 PageManager pm;
 
+/**
+ * Stored at the start of the first page of every free block
+ */
+class FreePageBlock
+{
+  public:
+    FreePageBlock* next_;
+    FreePageBlock* prev_;
+    uint32 ppn_;
+    uint32 order_;
+};
+
 PageManager* PageManager::instance_ = 0;
 
 PageManager* PageManager::instance()
@@ -29,7 +42,16 @@ PageManager::PageManager() : lock_("PageManager::lock_")
   instance_ = this;
   assert(KernelMemoryManager::instance_ == 0);
   number_of_pages_ = 0;
-  lowest_unreserved_page_ = 0;
+  num_free_pages_ = 0;
+  lru_head_ = 0;
+  lru_tail_ = 0;
+  num_lru_frames_ = 0;
+  for (uint32 o = 0; o <= MAX_ORDER; ++o)
+  {
+    free_lists_[o] = 0;
+    num_free_blocks_[o] = 0;
+  }
+  memset(magazines_, 0, sizeof(magazines_));
 
   size_t num_mmaps = ArchCommon::getNumUseableMemoryRegions();
 
@@ -65,7 +87,7 @@ PageManager::PageManager() : lock_("PageManager::lock_")
     size_t end_page = end_address / PAGE_SIZE;
     debug(PM, "Ctor: usable memory region: start_page: %zx, end_page: %zx, type: %zd\n", start_page, end_page, type);
 
-    for (size_t k = Max(start_page, lowest_unreserved_page_); k < Min(end_page, number_of_pages_); ++k)
+    for (size_t k = start_page; k < Min(end_page, number_of_pages_); ++k)
     {
       Bitmap::unsetBit(page_usage_table, used_pages, k);
     }
@@ -132,36 +154,29 @@ PageManager::PageManager() : lock_("PageManager::lock_")
 
   extern KernelMemoryManager kmm;
   new (&kmm) KernelMemoryManager(num_reserved_heap_pages,HEAP_PAGES);
-  page_usage_table_ = new Bitmap(number_of_pages_);
-
-  for (size_t i = 0; i < boot_bitmap_size; ++i)
+  free_block_heads_ = new Bitmap(number_of_pages_);
+  frames_ = new PageFrame[number_of_pages_];
+  memset(frames_, 0, number_of_pages_ * sizeof(PageFrame));
+
+  debug(PM, "Ctor: Building buddy free lists\n");
+  // ppn 0 is never handed out, 0 is the error value of allocPPN
+  size_t run_start = 0;
+  for (size_t p = 1; p <= number_of_pages_; ++p)
   {
-    if (Bitmap::getBit(page_usage_table,i))
-      page_usage_table_->setBit(i);
-  }
-
-  debug(PM, "Ctor: find lowest unreserved page\n");
-  for (size_t p = 0; p < number_of_pages_; ++p)
-  {
-    if (!page_usage_table_->getBit(p))
+    bool free = (p < number_of_pages_) && (p >= boot_bitmap_size || !Bitmap::getBit(page_usage_table, p));
+    if (free && !run_start)
+      run_start = p;
+    else if (!free && run_start)
     {
-      lowest_unreserved_page_ = p;
-      break;
-    }
-  }
-  debug(PM, "Ctor: Physical pages - free: %zu used: %zu total: %u\n", page_usage_table_->getNumFreeBits(),
-        page_usage_table_->getNumBitsSet(), number_of_pages_);
-  assert(lowest_unreserved_page_ < number_of_pages_);
-
-
-  debug(PM, "Clearing free pages\n");
-  for(size_t p = lowest_unreserved_page_; p < number_of_pages_; ++p)
-  {
-    if(!page_usage_table_->getBit(p))
-    {
-      memset((void*)ArchMemory::getIdentAddressOfPPN(p), 0xFF, PAGE_SIZE);
+#if PAGE_POISONING
+      memset((void*)ArchMemory::getIdentAddressOfPPN(run_start), 0xFF, (p - run_start) * PAGE_SIZE);
+#endif
+      freeRange(run_start, p - run_start);
+      run_start = 0;
     }
   }
+  debug(PM, "Ctor: Physical pages - free: %zu total: %u\n", num_free_pages_, number_of_pages_);
+  assert(num_free_pages_ > 0);
 
   KernelMemoryManager::pm_ready_ = 1;
 }
@@ -173,74 +188,437 @@ uint32 PageManager::getTotalNumPages() const
 
 size_t PageManager::getNumFreePages() const
 {
-  return page_usage_table_->getNumFreeBits();
+  size_t num_free = num_free_pages_;
+  for (const PageMagazine& magazine : magazines_)
+    num_free += magazine.count_;
+  return num_free;
 }
 
-bool PageManager::reservePages(uint32 ppn, uint32 num)
+void PageManager::addFreeBlock(uint32 ppn, uint32 order)
 {
-  assert(lock_.heldBy() == currentThread);
-  if (ppn < number_of_pages_ && !page_usage_table_->getBit(ppn))
+  FreePageBlock* block = (FreePageBlock*)ArchMemory::getIdentAddressOfPPN(ppn);
+  block->ppn_ = ppn;
+  block->order_ = order;
+  block->prev_ = 0;
+  block->next_ = free_lists_[order];
+  if (block->next_)
+    block->next_->prev_ = block;
+  free_lists_[order] = block;
+  free_block_heads_->setBit(ppn);
+  ++num_free_blocks_[order];
+}
+
+void PageManager::removeFreeBlock(FreePageBlock* block)
+{
+  if (block->prev_)
+    block->prev_->next_ = block->next_;
+  else
+    free_lists_[block->order_] = block->next_;
+  if (block->next_)
+    block->next_->prev_ = block->prev_;
+  free_block_heads_->unsetBit(block->ppn_);
+  --num_free_blocks_[block->order_];
+}
+
+uint32 PageManager::allocBlock(uint32 order)
+{
+  uint32 o = order;
+  while (o <= MAX_ORDER && !free_lists_[o])
+    ++o;
+  if (o > MAX_ORDER)
+    return 0;
+
+  FreePageBlock* block = free_lists_[o];
+  uint32 ppn = block->ppn_;
+  removeFreeBlock(block);
+  // hand the upper halves back until the block has the requested size
+  while (o > order)
   {
-    if (num == 1 || reservePages(ppn + 1, num - 1))
-    {
-      page_usage_table_->setBit(ppn);
-      return true;
-    }
+    --o;
+    addFreeBlock(ppn + (1 << o), o);
   }
-  return false;
+  num_free_pages_ -= (1 << order);
+  return ppn;
 }
 
-uint32 PageManager::allocPPN(uint32 page_size)
+void PageManager::freeBlock(uint32 ppn, uint32 order)
 {
-  uint32 p;
-  uint32 found = 0;
+  assert((ppn & ((1 << order) - 1)) == 0 && "buddy block is not naturally aligned");
+  num_free_pages_ += (1 << order);
+  while (order < MAX_ORDER)
+  {
+    uint32 buddy = ppn ^ (1 << order);
+    if (buddy == 0 || buddy >= number_of_pages_ || !free_block_heads_->getBit(buddy))
+      break;
+    FreePageBlock* buddy_block = (FreePageBlock*)ArchMemory::getIdentAddressOfPPN(buddy);
+    if (buddy_block->order_ != order)
+      break;
+    removeFreeBlock(buddy_block);
+    ppn = Min(ppn, buddy);
+    ++order;
+  }
+  addFreeBlock(ppn, order);
+}
 
-  assert((page_size % PAGE_SIZE) == 0);
+void PageManager::freeRange(uint32 ppn, uint32 num)
+{
+  while (num > 0)
+  {
+    uint32 order = 0;
+    while (order < MAX_ORDER && (ppn & (1 << order)) == 0 && (2U << order) <= num)
+      ++order;
+    freeBlock(ppn, order);
+    ppn += (1 << order);
+    num -= (1 << order);
+  }
+}
 
-  lock_.acquire();
+uint32 PageManager::allocPPN(uint32 page_size, bool may_fail)
+{
+  assert((page_size % PAGE_SIZE) == 0);
+  uint32 num = page_size / PAGE_SIZE;
+  uint32 order = 0;
+  while ((1U << order) < num)
+    ++order;
+  assert(order <= MAX_ORDER && "PageManager::allocPPN: block size not supported by the buddy allocator");
 
-  for (p = lowest_unreserved_page_; !found && (p < number_of_pages_); ++p)
+  uint32 found = 0;
+  if (num == 1)
   {
-    if ((p % (page_size / PAGE_SIZE)) != 0)
-      continue;
-    if (reservePages(p, page_size / PAGE_SIZE))
-      found = p;
+    bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+    PageMagazine& magazine = currentMagazine();
+    if (magazine.count_)
+    {
+      found = magazine.ppns_[--magazine.count_];
+      ++magazine.hits_;
+    }
+    if (interrupts_enabled)
+      ArchInterrupts::enableInterrupts();
+    if (!found)
+      found = refillMagazine();
+  }
+  else
+  {
+    lock_.acquire();
+    found = allocBlock(order);
+    if (found && (1U << order) > num)
+      freeRange(found + num, (1 << order) - num);
+    lock_.release();
   }
-  while ((lowest_unreserved_page_ < number_of_pages_) && page_usage_table_->getBit(lowest_unreserved_page_))
-    ++lowest_unreserved_page_;
 
-  lock_.release();
+  // a block which may fail is not worth evicting pages, the caller can do with single pages
+  if (found == 0 && (num == 1 || !may_fail) && PageReclaim::instance()->canReclaim() &&
+      PageReclaim::instance()->reclaim(num) > 0)
+  {
+    // the reclaimed pages are single ones, they may not make up a block of the requested size
+    return allocPPN(page_size, may_fail);
+  }
 
   if (found == 0)
   {
+    if (may_fail)
+      return 0;
     assert(false && "PageManager::allocPPN: Out of memory / No more free physical pages");
   }
 
-  const char* page_ident_addr = (const char*)ArchMemory::getIdentAddressOfPPN(found);
-  const char* page_modified = (const char*)memnotchr(page_ident_addr, 0xFF, page_size);
-  if(page_modified)
+#if PAGE_POISONING
+  for (uint32 p = found; p < found + num; ++p)
+  {
+    // the start of every page may have been used for the free list links
+    const char* page_ident_addr = (const char*)ArchMemory::getIdentAddressOfPPN(p);
+    const char* page_modified = (const char*)memnotchr(page_ident_addr + sizeof(FreePageBlock), 0xFF,
+                                                       PAGE_SIZE - sizeof(FreePageBlock));
+    if(page_modified)
+    {
+      debug(PM, "Detected use-after-free for PPN %x at offset %zx\n", p, page_modified - page_ident_addr);
+      assert(!page_modified && "Page modified after free");
+    }
+  }
+#endif
+
+  for (uint32 p = found; p < found + num; ++p)
   {
-    debug(PM, "Detected use-after-free for PPN %x at offset %zx\n", found, page_modified - page_ident_addr);
-    assert(!page_modified && "Page modified after free");
+    assert(frames_[p].ref_count_ == 0 && "PageManager::allocPPN: free page is still referenced");
+    assert(frames_[p].flags_ == 0 && frames_[p].rmap_ == 0);
+    frames_[p].ref_count_ = 1;
   }
 
   memset((void*)ArchMemory::getIdentAddressOfPPN(found), 0, page_size);
   return found;
 }
 
+void PageManager::addReference(uint32 page_number)
+{
+  assert(page_number != 0 && page_number < number_of_pages_);
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  PageFrame& frame = frames_[page_number];
+  assert(frame.ref_count_ > 0 && "PageManager::addReference: page is not allocated");
+  assert(frame.ref_count_ < (uint16)-1 && "PageManager::addReference: too many references");
+  ++frame.ref_count_;
+  frame.rmap_ = 0;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+uint32 PageManager::getReferenceCount(uint32 page_number) const
+{
+  assert(page_number < number_of_pages_);
+  return frames_[page_number].ref_count_;
+}
+
+void PageManager::addMapping(uint32 page_number, uint32 pt_ppn, pointer pte, bool user)
+{
+  assert(page_number != 0 && page_number < number_of_pages_);
+  assert(pt_ppn != 0 && pt_ppn < number_of_pages_);
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  PageFrame& frame = frames_[page_number];
+  assert(frame.ref_count_ > 0 && "PageManager::addMapping: page is not allocated");
+  // other references, e.g. of the page cache or another mapping, do not tell which entries they belong to
+  frame.rmap_ = (frame.ref_count_ == 1) ? pt_ppn * PAGE_SIZE + pte % PAGE_SIZE : 0;
+  if (user)
+  {
+    frame.flags_ |= PageFrame::USER;
+    if (!(frame.flags_ & PageFrame::LRU))
+      lruPushFront(page_number);
+  }
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+pointer PageManager::getMapping(uint32 page_number) const
+{
+  assert(page_number < number_of_pages_);
+  uint32 rmap = frames_[page_number].rmap_;
+  if (!rmap)
+    return 0;
+  return ArchMemory::getIdentAddressOfPPN(rmap / PAGE_SIZE) + rmap % PAGE_SIZE;
+}
+
+void PageManager::setFlags(uint32 page_number, uint16 flags)
+{
+  assert(page_number != 0 && page_number < number_of_pages_);
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  assert(frames_[page_number].ref_count_ > 0 && "PageManager::setFlags: page is not allocated");
+  assert(!(flags & PageFrame::LRU) && "PageManager::setFlags: the LRU list is managed by the PageManager");
+  frames_[page_number].flags_ |= flags;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void PageManager::clearFlags(uint32 page_number, uint16 flags)
+{
+  assert(page_number != 0 && page_number < number_of_pages_);
+  assert(!(flags & PageFrame::LRU) && "PageManager::clearFlags: the LRU list is managed by the PageManager");
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  frames_[page_number].flags_ &= ~flags;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+uint16 PageManager::getFlags(uint32 page_number) const
+{
+  assert(page_number < number_of_pages_);
+  return frames_[page_number].flags_;
+}
+
+uint32 PageManager::getPPNOfIdentAddress(pointer address) const
+{
+  pointer ident_start = ArchMemory::getIdentAddressOfPPN(0);
+  if (address < ident_start || (address - ident_start) / PAGE_SIZE >= number_of_pages_)
+    return 0;
+  return (address - ident_start) / PAGE_SIZE;
+}
+
+uint32 PageManager::rotateLRU()
+{
+  assert(!ArchInterrupts::testIFSet());
+  uint32 ppn = lru_tail_;
+  if (ppn && ppn != lru_head_)
+  {
+    lruRemove(ppn);
+    lruPushFront(ppn);
+  }
+  return ppn;
+}
+
+void PageManager::lruPushFront(uint32 ppn)
+{
+  assert(!ArchInterrupts::testIFSet());
+  PageFrame& frame = frames_[ppn];
+  frame.lru_prev_ = 0;
+  frame.lru_next_ = lru_head_;
+  if (lru_head_)
+    frames_[lru_head_].lru_prev_ = ppn;
+  else
+    lru_tail_ = ppn;
+  lru_head_ = ppn;
+  frame.flags_ |= PageFrame::LRU;
+  ++num_lru_frames_;
+}
+
+void PageManager::lruRemove(uint32 ppn)
+{
+  assert(!ArchInterrupts::testIFSet());
+  PageFrame& frame = frames_[ppn];
+  if (frame.lru_prev_)
+    frames_[frame.lru_prev_].lru_next_ = frame.lru_next_;
+  else
+    lru_head_ = frame.lru_next_;
+  if (frame.lru_next_)
+    frames_[frame.lru_next_].lru_prev_ = frame.lru_prev_;
+  else
+    lru_tail_ = frame.lru_prev_;
+  frame.lru_prev_ = 0;
+  frame.lru_next_ = 0;
+  frame.flags_ &= ~PageFrame::LRU;
+  --num_lru_frames_;
+}
+
 void PageManager::freePPN(uint32 page_number, uint32 page_size)
 {
   assert((page_size % PAGE_SIZE) == 0);
+  assert(page_number != 0 && page_number + page_size / PAGE_SIZE <= number_of_pages_);
+
+  if (page_size == PAGE_SIZE)
+  {
+    bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+    PageFrame& frame = frames_[page_number];
+    assert(frame.ref_count_ > 0 && "Double free PPN");
+    uint16 references = --frame.ref_count_;
+    // it is unknown which mapping the reference belonged to, the entry may be gone
+    frame.rmap_ = 0;
+    if (!references)
+    {
+      if (frame.flags_ & PageFrame::LRU)
+        lruRemove(page_number);
+      frame.flags_ = 0;
+    }
+    if (interrupts_enabled)
+      ArchInterrupts::enableInterrupts();
+    if (references > 0)
+      return;
+  }
+  else
+  {
+    for (uint32 p = page_number; p < page_number + page_size / PAGE_SIZE; ++p)
+    {
+      assert(frames_[p].ref_count_ == 1 && "PageManager::freePPN: page of the block is shared or already free");
+      assert(!(frames_[p].flags_ & PageFrame::LRU) && "PageManager::freePPN: block is mapped into user space");
+      frames_[p].ref_count_ = 0;
+      frames_[p].flags_ = 0;
+      frames_[p].rmap_ = 0;
+    }
+  }
 
+#if PAGE_POISONING
   memset((void*)ArchMemory::getIdentAddressOfPPN(page_number), 0xFF, page_size);
+#endif
 
-  lock_.acquire();
-  if (page_number < lowest_unreserved_page_)
-    lowest_unreserved_page_ = page_number;
-  for (uint32 p = page_number; p < (page_number + page_size / PAGE_SIZE); ++p)
+  if (page_size == PAGE_SIZE)
   {
-    assert(page_usage_table_->getBit(p) && "Double free PPN");
-    page_usage_table_->unsetBit(p);
+    putIntoMagazine(page_number);
+    return;
   }
+
+  lock_.acquire();
+  assert(!free_block_heads_->getBit(page_number) && "Double free PPN");
+  freeRange(page_number, page_size / PAGE_SIZE);
+  lock_.release();
+}
+
+PageMagazine& PageManager::currentMagazine()
+{
+  assert(!ArchInterrupts::testIFSet());
+  return magazines_[0];
+}
+
+uint32 PageManager::refillMagazine()
+{
+  uint32 batch[PageMagazine::BATCH];
+  size_t num = 0;
+
+  lock_.acquire();
+  while (num < PageMagazine::BATCH && (batch[num] = allocBlock(0)))
+    ++num;
   lock_.release();
+
+  if (num == 0)
+    return 0;
+
+  uint32 ppn = batch[--num];
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  PageMagazine& magazine = currentMagazine();
+  ++magazine.refills_;
+  // another thread on this cpu may have refilled the magazine in the meantime
+  while (num > 0 && magazine.count_ < PageMagazine::SIZE)
+    magazine.ppns_[magazine.count_++] = batch[--num];
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+
+  if (num > 0)
+  {
+    lock_.acquire();
+    while (num > 0)
+      freeBlock(batch[--num], 0);
+    lock_.release();
+  }
+  return ppn;
+}
+
+void PageManager::putIntoMagazine(uint32 ppn)
+{
+  uint32 batch[PageMagazine::BATCH];
+  size_t num = 0;
+
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  PageMagazine& magazine = currentMagazine();
+  if (magazine.count_ == PageMagazine::SIZE)
+  {
+    // give back the pages which have been in the magazine for the longest time
+    num = PageMagazine::BATCH;
+    memcpy(batch, magazine.ppns_, sizeof(batch));
+    memmove(magazine.ppns_, magazine.ppns_ + num, (magazine.count_ - num) * sizeof(uint32));
+    magazine.count_ -= num;
+    ++magazine.drains_;
+  }
+  magazine.ppns_[magazine.count_++] = ppn;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+
+  if (num > 0)
+  {
+    lock_.acquire();
+    for (size_t i = 0; i < num; ++i)
+    {
+      assert(!free_block_heads_->getBit(batch[i]) && "Double free PPN");
+      freeBlock(batch[i], 0);
+    }
+    lock_.release();
+  }
+}
+
+void PageManager::printFreeLists()
+{
+  kprintfd("PageManager: %zu of %u pages free\n", getNumFreePages(), number_of_pages_);
+  for (uint32 o = 0; o <= MAX_ORDER; ++o)
+    kprintfd("  order %2u (%5u KiB): %zu free blocks\n", o, (PAGE_SIZE << o) / 1024, num_free_blocks_[o]);
+  for (size_t c = 0; c < sizeof(magazines_) / sizeof(magazines_[0]); ++c)
+    kprintfd("  cpu %zu magazine: %zu pages, %zu hits, %zu refills, %zu drains\n", c, magazines_[c].count_,
+             magazines_[c].hits_, magazines_[c].refills_, magazines_[c].drains_);
+
+  size_t num_file_backed = 0, num_dirty = 0, num_reverse_mapped = 0;
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  for (uint32 p = lru_head_; p; p = frames_[p].lru_next_)
+  {
+    num_file_backed += (frames_[p].flags_ & PageFrame::FILE_BACKED) ? 1 : 0;
+    num_dirty += (frames_[p].flags_ & PageFrame::DIRTY) ? 1 : 0;
+    num_reverse_mapped += frames_[p].rmap_ ? 1 : 0;
+  }
+  size_t num_user = num_lru_frames_;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+  kprintfd("  frame descriptors: %zu KiB (%zu bytes per frame)\n", number_of_pages_ * sizeof(PageFrame) / 1024,
+           sizeof(PageFrame));
+  kprintfd("  user frames: %zu, %zu reverse mapped, %zu file-backed, %zu dirty\n", num_user, num_reverse_mapped,
+           num_file_backed, num_dirty);
 }
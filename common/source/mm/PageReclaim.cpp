@@ -0,0 +1,229 @@
+#include "PageReclaim.h"
+#include "PageManager.h"
+#include "PageCache.h"
+#include "KernelMemoryManager.h"
+#include "ArchMemory.h"
+#include "ArchInterrupts.h"
+#include "BDManager.h"
+#include "BDVirtualDevice.h"
+#include "Thread.h"
+#include "Scheduler.h"
+#include "kstring.h"
+#include "kprintf.h"
+#include "assert.h"
+#include "debug.h"
+#include "fs/devicefs/DeviceFSInfoInode.h"
+
+PageReclaim* PageReclaim::instance_ = 0;
+
+PageReclaim* PageReclaim::instance()
+{
+  if (unlikely(!instance_))
+    instance_ = new PageReclaim();
+  return instance_;
+}
+
+PageReclaim::PageReclaim() :
+    lock_("PageReclaim::lock_"), device_(0), slot_references_(0), num_slots_(0), num_used_slots_(0), next_slot_(1),
+    scans_(0), pages_scanned_(0), pages_dropped_(0), swap_outs_(0), swap_ins_(0)
+{
+}
+
+void PageReclaim::initialise()
+{
+  assert(!device_);
+  for (BDVirtualDevice* device : BDManager::getInstance()->device_list_)
+  {
+    if (device->getPartitionType() == SWAP_PARTITION_TYPE)
+    {
+      device_ = device;
+      break;
+    }
+  }
+  if (!device_)
+  {
+    debug(PM, "PageReclaim: there is no swap partition, only clean pages can be reclaimed\n");
+    return;
+  }
+  assert(PAGE_SIZE % device_->getBlockSize() == 0);
+  num_slots_ = (size_t) device_->getNumBlocks() * device_->getBlockSize() / PAGE_SIZE;
+  slot_references_ = new uint16[num_slots_];
+  memset(slot_references_, 0, num_slots_ * sizeof(uint16));
+  debug(PM, "PageReclaim: swapping to %s, %zu slots\n", device_->getName(), num_slots_);
+}
+
+size_t PageReclaim::reclaim(size_t num)
+{
+  assert(canReclaim());
+  size_t target = num;
+  if (target < BATCH)
+    target = BATCH;
+  size_t freed = PageCache::instance()->reclaim(target);
+  if (freed < target)
+  {
+    ScopeLock lock(lock_);
+    freed += scan(target - freed);
+  }
+  debug(PM, "PageReclaim::reclaim: freed %zu pages, %zu requested\n", freed, num);
+  return freed;
+}
+
+bool PageReclaim::canReclaim()
+{
+  // the heap of the kernel is needed for the requests to the swap partition
+  return PageCache::instance()->canReclaim() && !lock_.isHeldBy(currentThread) &&
+         KernelMemoryManager::instance()->KMMLockHeldBy() != currentThread;
+}
+
+size_t PageReclaim::scan(size_t num)
+{
+  assert(lock_.isHeldBy(currentThread));
+  PageManager* pm = PageManager::instance();
+  uint32 written[BATCH];
+  BDRequest* requests[BATCH];
+  size_t num_written = 0;
+  size_t freed = 0;
+  size_t max_visits = 2 * pm->getNumLRUFrames();
+  ++scans_;
+  for (size_t visits = 0; visits < max_visits && freed + num_written < num; ++visits)
+  {
+    uint32 dropped = 0;
+    size_t slot = 0;
+    bool dirty = false;
+    ArchInterrupts::disableInterrupts();
+    uint32 ppn = pm->rotateLRU();
+    pointer pte = ppn ? pm->getMapping(ppn) : 0;
+    if (pte && pm->getReferenceCount(ppn) == 1 && ArchMemory::ageEntry(pte, ppn, dirty))
+    {
+      uint16 flags = pm->getFlags(ppn);
+      if ((flags & PageFrame::FILE_BACKED) && !(flags & PageFrame::DIRTY) && !dirty)
+      {
+        ArchMemory::evictEntry(pte, 0);
+        dropped = ppn;
+      }
+      else if ((slot = allocSlot()))
+      {
+        ArchMemory::evictEntry(pte, slot);
+      }
+    }
+    ArchInterrupts::enableInterrupts();
+    ++pages_scanned_;
+
+    if (dropped)
+    {
+      pm->freePPN(dropped);
+      ++pages_dropped_;
+      ++freed;
+    }
+    else if (slot)
+    {
+      // the entry refers to the slot already, a fault on the page waits for lock_ until the write is done
+      written[num_written] = ppn;
+      requests[num_written++] = device_->submitWrite(slot * PAGE_SIZE, PAGE_SIZE,
+                                                     (char*) ArchMemory::getIdentAddressOfPPN(ppn));
+      if (num_written == BATCH)
+      {
+        freed += completeWrites(written, requests, num_written);
+        num_written = 0;
+      }
+    }
+  }
+  freed += completeWrites(written, requests, num_written);
+  return freed;
+}
+
+size_t PageReclaim::completeWrites(uint32* ppns, BDRequest** requests, size_t num)
+{
+  for (size_t i = 0; i < num; ++i)
+  {
+    int32 result = device_->waitForRequest(requests[i]);
+    assert(result == PAGE_SIZE && "PageReclaim: writing to the swap partition failed");
+    PageManager::instance()->freePPN(ppns[i]);
+  }
+  swap_outs_ += num;
+  return num;
+}
+
+bool PageReclaim::swapIn(ArchMemory& arch_memory, size_t virtual_page)
+{
+  size_t slot = arch_memory.getSwapSlot(virtual_page);
+  if (!slot)
+    return false;
+
+  // allocated before taking the lock, the allocation may have to reclaim pages itself
+  uint32 ppn = PageManager::instance()->allocPPN();
+  ScopeLock lock(lock_);
+  // another thread of the process may have faulted on the page in the meantime
+  if (arch_memory.getSwapSlot(virtual_page) != slot)
+  {
+    PageManager::instance()->freePPN(ppn);
+    return true;
+  }
+  int32 result = device_->readData(slot * PAGE_SIZE, PAGE_SIZE, (char*) ArchMemory::getIdentAddressOfPPN(ppn));
+  assert(result == PAGE_SIZE && "PageReclaim::swapIn: reading from the swap partition failed");
+  if (arch_memory.mapSwappedPage(virtual_page, ppn, slot))
+  {
+    freeSlot(slot);
+    ++swap_ins_;
+  }
+  else
+  {
+    PageManager::instance()->freePPN(ppn);
+  }
+  debug(PM, "PageReclaim::swapIn: page %zx read from slot %zu\n", virtual_page, slot);
+  return true;
+}
+
+size_t PageReclaim::allocSlot()
+{
+  assert(!ArchInterrupts::testIFSet());
+  if (num_used_slots_ + 1 >= num_slots_)
+    return 0;
+  while (slot_references_[next_slot_])
+    next_slot_ = (next_slot_ + 1 < num_slots_) ? next_slot_ + 1 : 1;
+  size_t slot = next_slot_;
+  slot_references_[slot] = 1;
+  ++num_used_slots_;
+  return slot;
+}
+
+void PageReclaim::addSlotReference(size_t slot)
+{
+  assert(slot != 0 && slot < num_slots_);
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  assert(slot_references_[slot] > 0 && "PageReclaim::addSlotReference: slot is not used");
+  assert(slot_references_[slot] < (uint16)-1 && "PageReclaim::addSlotReference: too many references");
+  ++slot_references_[slot];
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void PageReclaim::freeSlot(size_t slot)
+{
+  assert(slot != 0 && slot < num_slots_);
+  bool interrupts_enabled = ArchInterrupts::disableInterrupts();
+  assert(slot_references_[slot] > 0 && "PageReclaim::freeSlot: slot is already free");
+  if (--slot_references_[slot] == 0)
+    --num_used_slots_;
+  if (interrupts_enabled)
+    ArchInterrupts::enableInterrupts();
+}
+
+void PageReclaim::printStatistics()
+{
+  kprintfd("PageReclaim: swap partition %s, %zu of %zu slots used, %zu scans, %zu pages scanned, %zu dropped, "
+           "%zu swapped out, %zu swapped in\n", device_ ? device_->getName() : "-", num_used_slots_, num_slots_,
+           scans_, pages_scanned_, pages_dropped_, swap_outs_, swap_ins_);
+}
+
+size_t PageReclaim::writeStatistics(char* buffer, size_t size)
+{
+  PageReclaim* reclaim = instance();
+  char* position = buffer;
+  size_t remaining = size;
+  DeviceFSInfoInode::append(position, remaining, "slots %zu\nused_slots %zu\nscans %zu\nscanned %zu\n"
+                            "dropped %zu\nswap_outs %zu\nswap_ins %zu\n", reclaim->num_slots_,
+                            reclaim->num_used_slots_, reclaim->scans_, reclaim->pages_scanned_,
+                            reclaim->pages_dropped_, reclaim->swap_outs_, reclaim->swap_ins_);
+  return position - buffer;
+}
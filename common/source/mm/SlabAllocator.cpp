@@ -0,0 +1,303 @@
+#include "SlabAllocator.h"
+#include "new.h"
+#include "PageManager.h"
+#include "ArchMemory.h"
+#include "paging-definitions.h"
+#include "Thread.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "assert.h"
+#include "debug.h"
+#include "Stabs2DebugInfo.h"
+extern Stabs2DebugInfo const* kernel_debug_info;
+
+static const size_t SLAB_PAGE_HEADER_SIZE = (sizeof(SlabPage) + 0xF) & ~0xF;
+
+static const size_t size_classes[SlabAllocator::NUM_SIZE_CLASSES] = { 16, 32, 64, 128, 256, 512, 1008, 2016 };
+
+#ifdef DEBUG
+static const size_t SLAB_DEBUG_INFO_SIZE = (sizeof(SlabObjectDebugInfo) + 0xF) & ~0xF;
+#else
+static const size_t SLAB_DEBUG_INFO_SIZE = 0;
+#endif
+
+/**
+ * free object slots are chained through their first word, or through the debug information in a debug build
+ */
+static pointer& nextFreeSlot(pointer slot)
+{
+#ifdef DEBUG
+  return ((SlabObjectDebugInfo*) slot)->next_free_;
+#else
+  return *(pointer*) slot;
+#endif
+}
+
+SlabPage::SlabPage(SlabCache* cache, uint32 ppn) :
+    marker_(0x51AB51AB00000000ull | (uint32) (size_t) this), cache_(cache), next_(0), prev_(0), free_list_(0),
+    objects_used_(0), ppn_(ppn)
+{
+}
+
+pointer SlabPage::firstObject()
+{
+  return ((pointer) this) + SLAB_PAGE_HEADER_SIZE;
+}
+
+void SlabCache::init(size_t object_size)
+{
+  assert((object_size & 0xF) == 0);
+  object_size_ = object_size;
+  objects_per_page_ = (PAGE_SIZE - SLAB_PAGE_HEADER_SIZE) / object_size;
+  assert(objects_per_page_ > 0);
+  num_pages_ = 0;
+  objects_used_ = 0;
+  partial_pages_ = 0;
+  full_pages_ = 0;
+  empty_page_ = 0;
+}
+
+void SlabCache::listAdd(SlabPage*& list, SlabPage* page)
+{
+  page->prev_ = 0;
+  page->next_ = list;
+  if (list)
+    list->prev_ = page;
+  list = page;
+}
+
+void SlabCache::listRemove(SlabPage*& list, SlabPage* page)
+{
+  if (page->prev_)
+    page->prev_->next_ = page->next_;
+  else
+    list = page->next_;
+  if (page->next_)
+    page->next_->prev_ = page->prev_;
+  page->next_ = 0;
+  page->prev_ = 0;
+}
+
+SlabPage* SlabCache::createPage()
+{
+  // the KMM lock is held, so the PageManager cannot reclaim pages here, the KernelMemoryManager does that
+  uint32 ppn = PageManager::instance()->allocPPN(PAGE_SIZE, true);
+  if (ppn == 0)
+    return 0;
+  PageManager::instance()->setFlags(ppn, PageFrame::SLAB);
+  SlabPage* page = new ((void*) ArchMemory::getIdentAddressOfPPN(ppn)) SlabPage(this, ppn);
+  pointer slot = page->firstObject() + (objects_per_page_ - 1) * object_size_;
+  for (size_t i = 0; i < objects_per_page_; ++i, slot -= object_size_)
+  {
+    nextFreeSlot(slot) = page->free_list_;
+    page->free_list_ = slot;
+  }
+  ++num_pages_;
+  debug(KMM, "SlabCache(%zu)::createPage: new slab page at %p (ppn %x)\n", object_size_, page, ppn);
+  return page;
+}
+
+void SlabCache::releasePage(SlabPage* page)
+{
+  assert(page->objects_used_ == 0);
+  debug(KMM, "SlabCache(%zu)::releasePage: releasing slab page at %p (ppn %x)\n", object_size_, page, page->ppn_);
+  uint32 ppn = page->ppn_;
+  memset((void*) page, 0, PAGE_SIZE);
+  --num_pages_;
+  PageManager::instance()->freePPN(ppn);
+}
+
+pointer SlabCache::allocate()
+{
+  SlabPage* page = partial_pages_;
+  if (!page)
+  {
+    if (empty_page_)
+    {
+      page = empty_page_;
+      empty_page_ = 0;
+    }
+    else if (!(page = createPage()))
+    {
+      return 0;
+    }
+    listAdd(partial_pages_, page);
+  }
+
+  assert(page->markerOk() && page->free_list_ && "slab page corrupted");
+  pointer slot = page->free_list_;
+  page->free_list_ = nextFreeSlot(slot);
+  nextFreeSlot(slot) = 0;
+  ++page->objects_used_;
+  ++objects_used_;
+
+  if (page->objects_used_ == objects_per_page_)
+  {
+    listRemove(partial_pages_, page);
+    listAdd(full_pages_, page);
+  }
+  return slot;
+}
+
+void SlabCache::free(SlabPage* page, pointer slot)
+{
+  assert(page->objects_used_ > 0);
+  if (page->objects_used_ == objects_per_page_)
+  {
+    listRemove(full_pages_, page);
+    listAdd(partial_pages_, page);
+  }
+  nextFreeSlot(slot) = page->free_list_;
+  page->free_list_ = slot;
+  --page->objects_used_;
+  --objects_used_;
+
+  if (page->objects_used_ == 0)
+  {
+    listRemove(partial_pages_, page);
+    // keep one empty page around so alternating new/delete does not hit the PageManager every time
+    if (empty_page_)
+      releasePage(page);
+    else
+      empty_page_ = page;
+  }
+}
+
+SlabAllocator::SlabAllocator()
+{
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+    caches_[i].init(size_classes[i]);
+}
+
+pointer SlabAllocator::allocate(size_t requested_size, pointer called_by)
+{
+  size_t slot_size = requested_size + SLAB_DEBUG_INFO_SIZE;
+  size_t c = 0;
+  while (c < NUM_SIZE_CLASSES && size_classes[c] < slot_size)
+    ++c;
+  if (c == NUM_SIZE_CLASSES)
+    return 0;
+
+  pointer slot = caches_[c].allocate();
+  if (!slot)
+    return 0;
+
+  pointer object = slot + SLAB_DEBUG_INFO_SIZE;
+  size_t object_size = size_classes[c] - SLAB_DEBUG_INFO_SIZE;
+#ifdef DEBUG
+  SlabObjectDebugInfo* info = (SlabObjectDebugInfo*) slot;
+  const uint32* mem = (const uint32*) object;
+  for (size_t i = 0; i < object_size / 4; ++i)
+  {
+    if (unlikely(mem[i] != 0))
+    {
+      kprintfd("SlabAllocator::allocate: WARNING: Memory not zero at %p (value=%x)\n", mem + i, mem[i]);
+      if (info->freed_at_ && kernel_debug_info)
+      {
+        kprintfd("SlabAllocator::allocate: The object may previously be freed at: ");
+        kernel_debug_info->printCallInformation(info->freed_at_);
+      }
+      assert(false && "memory corruption - probably 'write after delete'");
+    }
+  }
+  info->marker_ = 0xdeadbeef00000000ull | (uint32) (size_t) info;
+  info->freed_at_ = 0;
+  info->alloc_at_ = called_by;
+  info->alloc_by_ = (pointer) currentThread;
+#else
+  (void) called_by;
+  memset((void*) object, 0, object_size);
+#endif
+  return object;
+}
+
+SlabPage* SlabAllocator::getPageFromAddress(pointer virtual_address)
+{
+  // a stray delete of a stack, static or user address must not touch the page it points to
+  uint32 ppn = PageManager::instance()->getPPNOfIdentAddress(virtual_address - SLAB_DEBUG_INFO_SIZE);
+  if (ppn == 0 || !(PageManager::instance()->getFlags(ppn) & PageFrame::SLAB))
+    return 0;
+  SlabPage* page = (SlabPage*) ((virtual_address - SLAB_DEBUG_INFO_SIZE) & ~((pointer) PAGE_SIZE - 1));
+  if (!page->markerOk())
+    return 0;
+  pointer offset = virtual_address - SLAB_DEBUG_INFO_SIZE - page->firstObject();
+  assert(offset < page->cache_->objects_per_page_ * page->cache_->object_size_ &&
+         (offset % page->cache_->object_size_) == 0 && "address does not point to the start of a slab object");
+  return page;
+}
+
+bool SlabAllocator::free(pointer virtual_address, pointer called_by)
+{
+  SlabPage* page = getPageFromAddress(virtual_address);
+  if (!page)
+    return false;
+  pointer slot = virtual_address - SLAB_DEBUG_INFO_SIZE;
+#ifdef DEBUG
+  SlabObjectDebugInfo* info = (SlabObjectDebugInfo*) slot;
+  if (!info->markerOk())
+  {
+    kprintfd("SlabAllocator::free: FATAL ERROR\n");
+    kprintfd("SlabAllocator::free: tried freeing not used memory block %zx\n", virtual_address);
+    if (info->freed_at_ && kernel_debug_info)
+    {
+      kprintfd("SlabAllocator::free: The object may previously be freed at: ");
+      kernel_debug_info->printCallInformation(info->freed_at_);
+    }
+    assert(false);
+  }
+  info->marker_ = 0;
+  info->freed_at_ = called_by;
+  memset((void*) virtual_address, 0, page->cache_->object_size_ - SLAB_DEBUG_INFO_SIZE); // ease debugging
+#else
+  (void) called_by;
+#endif
+  page->cache_->free(page, slot);
+  return true;
+}
+
+size_t SlabAllocator::getObjectSize(pointer virtual_address)
+{
+  SlabPage* page = getPageFromAddress(virtual_address);
+  return page ? page->cache_->object_size_ - SLAB_DEBUG_INFO_SIZE : 0;
+}
+
+size_t SlabAllocator::getUsedMemory(bool show_stats)
+{
+  size_t used = 0;
+  if (show_stats)
+    kprintfd("Slab caches:\n  size   pages    used objects    fragmentation\n");
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+  {
+    SlabCache& cache = caches_[i];
+    size_t used_bytes = cache.objects_used_ * cache.object_size_;
+    used += used_bytes;
+    if (show_stats && cache.num_pages_)
+    {
+      size_t capacity = cache.num_pages_ * cache.objects_per_page_;
+      kprintfd("  %4zu %7zu %8zu/%-8zu %7zu%%\n", cache.object_size_, cache.num_pages_, cache.objects_used_, capacity,
+               100 - (100 * used_bytes) / (cache.num_pages_ * PAGE_SIZE));
+    }
+#ifdef DEBUG
+    if (show_stats && kernel_debug_info)
+    {
+      SlabPage* lists[] = { cache.partial_pages_, cache.full_pages_ };
+      for (SlabPage* list : lists)
+      {
+        for (SlabPage* page = list; page; page = page->next_)
+        {
+          for (size_t o = 0; o < cache.objects_per_page_; ++o)
+          {
+            SlabObjectDebugInfo* info = (SlabObjectDebugInfo*) (page->firstObject() + o * cache.object_size_);
+            if (info->markerOk() && info->alloc_at_)
+            {
+              kprintfd("%8zu bytes (by %p) at: ", cache.object_size_ - SLAB_DEBUG_INFO_SIZE, (void*) info->alloc_by_);
+              kernel_debug_info->printCallInformation(info->alloc_at_);
+            }
+          }
+        }
+      }
+    }
+#endif
+  }
+  return used;
+}
@@ -0,0 +1,74 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "fcntl.h"
+
+/*
+ * Touches twice as much memory as the machine has (run it with the default 8 MB) and then allocates kernel
+ * objects while the memory is still full: open files and the processes created by fork.
+ * The kernel heap has to get its pages from the swap partition then, the test passes if the kernel survives
+ * and every page of the array still holds what was written to it.
+ */
+#define MEMORY_SIZE (16 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define NUM_PAGES (MEMORY_SIZE / PAGE_SIZE)
+#define NUM_FILES 128
+#define NUM_CHILDREN 8
+
+char memory[MEMORY_SIZE] __attribute__((aligned(4096)));
+int fds[NUM_FILES];
+
+void fill(int pass)
+{
+  for (int page = 0; page < NUM_PAGES; ++page)
+    *(int*) (memory + page * PAGE_SIZE) = page + pass;
+}
+
+int check(int pass)
+{
+  int errors = 0;
+  for (int page = 0; page < NUM_PAGES; ++page)
+  {
+    if (*(int*) (memory + page * PAGE_SIZE) != page + pass)
+      ++errors;
+  }
+  return errors;
+}
+
+int main()
+{
+  printf("reclaim: touching %d pages\n", NUM_PAGES);
+  fill(0);
+
+  int num_open = 0;
+  for (; num_open < NUM_FILES; ++num_open)
+  {
+    fds[num_open] = open("/usr/reclaim.sweb", O_RDONLY);
+    if (fds[num_open] < 0)
+      break;
+  }
+  printf("reclaim: opened %d files\n", num_open);
+
+  for (int child = 0; child < NUM_CHILDREN; ++child)
+  {
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      // the copy on write faults of the child need frames as well
+      fill(child + 1);
+      exit(check(child + 1) ? 1 : 0);
+    }
+    if (pid < 0)
+      printf("reclaim: fork %d failed\n", child);
+  }
+
+  for (int i = 0; i < num_open; ++i)
+    close(fds[i]);
+
+  int errors = check(0);
+  if (errors)
+    printf("reclaim: FAILED, %d pages lost their content\n", errors);
+  else
+    printf("reclaim: passed\n");
+  return errors ? 1 : 0;
+}